@@ -0,0 +1,98 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "instance.h"
+
+static char* readline(struct instance_reader *reader)
+{
+	size_t len;
+
+	if(fgets(reader->line,(int)reader->max_line_len,reader->input) == NULL)
+		return NULL;
+
+	while(strrchr(reader->line,'\n') == NULL)
+	{
+		reader->max_line_len *= 2;
+		reader->line = (char *) realloc(reader->line,reader->max_line_len);
+		len = strlen(reader->line);
+		if(fgets(reader->line+len,(int)(reader->max_line_len-len),reader->input) == NULL)
+			break;
+	}
+	return reader->line;
+}
+
+static void exit_input_error(int line_num)
+{
+	fprintf(stderr,"Wrong input format at line %d\n", line_num);
+	exit(1);
+}
+
+void instance_reader_init(struct instance_reader *reader, FILE *input)
+{
+	reader->input = input;
+	reader->max_line_len = 1024;
+	reader->line = (char *) malloc(reader->max_line_len*sizeof(char));
+	reader->max_nr_attr = 64;
+	reader->x = (struct svm_node *) malloc(reader->max_nr_attr*sizeof(struct svm_node));
+	reader->line_num = 0;
+}
+
+int instance_reader_next(struct instance_reader *reader, double *target_label)
+{
+	size_t i = 0;
+	char *idx, *val, *label, *endptr;
+	int inst_max_index = -1; // strtol gives 0 if wrong format, and precomputed kernel has <index> start from 0
+	struct svm_node *x;
+
+	if(readline(reader) == NULL)
+		return 0;
+	++reader->line_num;
+
+	label = strtok(reader->line," \t\n");
+	if(label == NULL) // empty line
+		exit_input_error(reader->line_num);
+
+	*target_label = strtod(label,&endptr);
+	if(endptr == label || *endptr != '\0')
+		exit_input_error(reader->line_num);
+
+	while(1)
+	{
+		if(i>=reader->max_nr_attr-1)	// need one more for index = -1
+		{
+			reader->max_nr_attr *= 2;
+			reader->x = (struct svm_node *) realloc(reader->x,reader->max_nr_attr*sizeof(struct svm_node));
+		}
+		x = reader->x;
+
+		idx = strtok(NULL,":");
+		val = strtok(NULL," \t");
+
+		if(val == NULL)
+			break;
+		errno = 0;
+		x[i].index = (int) strtol(idx,&endptr,10);
+		if(endptr == idx || errno != 0 || *endptr != '\0' || x[i].index <= inst_max_index)
+			exit_input_error(reader->line_num);
+		else
+			inst_max_index = x[i].index;
+
+		errno = 0;
+		x[i].value = strtod(val,&endptr);
+		if(endptr == val || errno != 0 || (*endptr != '\0' && !isspace(*endptr)))
+			exit_input_error(reader->line_num);
+
+		++i;
+	}
+	reader->x[i].index = -1;
+	return 1;
+}
+
+void instance_reader_free(struct instance_reader *reader)
+{
+	free(reader->line);
+	free(reader->x);
+	reader->line = NULL;
+	reader->x = NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef _INSTANCE_H
+#define _INSTANCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "svm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// reads instances "<label> <index>:<value> ..." one line at a time
+struct instance_reader
+{
+	FILE *input;
+	char *line;
+	size_t max_line_len;
+	struct svm_node *x;	// the last instance read, terminated by index -1
+	size_t max_nr_attr;
+	int line_num;
+};
+
+void instance_reader_init(struct instance_reader *reader, FILE *input);
+// reads the next instance into reader->x and its label into *target_label;
+// returns 0 at the end of input and exits on a wrong format
+int instance_reader_next(struct instance_reader *reader, double *target_label);
+void instance_reader_free(struct instance_reader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INSTANCE_H */
@@ -1,47 +1,16 @@
 #include <stdio.h>
-#include <ctype.h>
 #include <stdlib.h>
-#include <string.h>
-#include <errno.h>
 #include "svm.h"
+#include "instance.h"
 
 int print_null(const char *s,...) {return 0;}
 
 static int (*info)(const char *fmt,...) = &printf;
 
-struct svm_node *x;
-int max_nr_attr = 64;
-
 struct svm_model* model;
+struct svm_ensemble* ensemble;	// model is its first member
 int predict_probability=0;
 
-static char *line = NULL;
-static int max_line_len;
-
-static char* readline(FILE *input)
-{
-	int len;
-
-	if(fgets(line,max_line_len,input) == NULL)
-		return NULL;
-
-	while(strrchr(line,'\n') == NULL)
-	{
-		max_line_len *= 2;
-		line = (char *) realloc(line,max_line_len);
-		len = (int) strlen(line);
-		if(fgets(line+len,max_line_len-len,input) == NULL)
-			break;
-	}
-	return line;
-}
-
-void exit_input_error(int line_num)
-{
-	fprintf(stderr,"Wrong input format at line %d\n", line_num);
-	exit(1);
-}
-
 void predict(FILE *input, FILE *output)
 {
 	int correct = 0;
@@ -53,6 +22,8 @@ void predict(FILE *input, FILE *output)
 	int nr_class=svm_get_nr_class(model);
 	double *prob_estimates=NULL;
 	int j;
+	struct instance_reader reader;
+	double target_label;
 
 	if(predict_probability)
 	{
@@ -77,51 +48,11 @@ void predict(FILE *input, FILE *output)
 		}
 	}
 
-	max_line_len = 1024;
-	line = (char *)malloc(max_line_len*sizeof(char));
-	while(readline(input) != NULL)
+	instance_reader_init(&reader,input);
+	while(instance_reader_next(&reader,&target_label))
 	{
-		int i = 0;
-		double target_label, predict_label;
-		char *idx, *val, *label, *endptr;
-		int inst_max_index = -1; // strtol gives 0 if wrong format, and precomputed kernel has <index> start from 0
-
-		label = strtok(line," \t\n");
-		if(label == NULL) // empty line
-			exit_input_error(total+1);
-
-		target_label = strtod(label,&endptr);
-		if(endptr == label || *endptr != '\0')
-			exit_input_error(total+1);
-
-		while(1)
-		{
-			if(i>=max_nr_attr-1)	// need one more for index = -1
-			{
-				max_nr_attr *= 2;
-				x = (struct svm_node *) realloc(x,max_nr_attr*sizeof(struct svm_node));
-			}
-
-			idx = strtok(NULL,":");
-			val = strtok(NULL," \t");
-
-			if(val == NULL)
-				break;
-			errno = 0;
-			x[i].index = (int) strtol(idx,&endptr,10);
-			if(endptr == idx || errno != 0 || *endptr != '\0' || x[i].index <= inst_max_index)
-				exit_input_error(total+1);
-			else
-				inst_max_index = x[i].index;
-
-			errno = 0;
-			x[i].value = strtod(val,&endptr);
-			if(endptr == val || errno != 0 || (*endptr != '\0' && !isspace(*endptr)))
-				exit_input_error(total+1);
-
-			++i;
-		}
-		x[i].index = -1;
+		struct svm_node *x = reader.x;
+		double predict_label;
 
 		if (predict_probability && (svm_type==C_SVC || svm_type==NU_SVC || svm_type==ONE_CLASS))
 		{
@@ -133,7 +64,7 @@ void predict(FILE *input, FILE *output)
 		}
 		else
 		{
-			predict_label = svm_predict(model,x);
+			predict_label = ensemble ? svm_predict_ensemble(ensemble,x) : svm_predict(model,x);
 			fprintf(output,"%.17g\n",predict_label);
 		}
 
@@ -160,6 +91,7 @@ void predict(FILE *input, FILE *output)
 			(double)correct/total*100,correct,total);
 	if(predict_probability)
 		free(prob_estimates);
+	instance_reader_free(&reader);
 }
 
 void exit_with_help()
@@ -214,15 +146,21 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
-	if((model=svm_load_model(argv[i+1]))==0)
+	if((ensemble=svm_load_ensemble(argv[i+1]))!=0)
+		model = ensemble->model[0];
+	else if((model=svm_load_model(argv[i+1]))==0)
 	{
 		fprintf(stderr,"can't open model file %s\n",argv[i+1]);
 		exit(1);
 	}
 
-	x = (struct svm_node *) malloc(max_nr_attr*sizeof(struct svm_node));
 	if(predict_probability)
 	{
+		if(ensemble)
+		{
+			fprintf(stderr,"Ensembles do not support probability estimates\n");
+			exit(1);
+		}
 		if(svm_check_probability_model(model)==0)
 		{
 			fprintf(stderr,"Model does not support probabiliy estimates\n");
@@ -236,9 +174,10 @@ int main(int argc, char **argv)
 	}
 
 	predict(input,output);
-	svm_free_and_destroy_model(&model);
-	free(x);
-	free(line);
+	if(ensemble)
+		svm_free_and_destroy_ensemble(&ensemble);
+	else
+		svm_free_and_destroy_model(&model);
 	fclose(input);
 	fclose(output);
 	return 0;
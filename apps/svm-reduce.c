@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "svm.h"
+#include "instance.h"
+
+int print_null(const char *s,...) {return 0;}
+void print_string_null(const char *s) {}
+
+static int (*info)(const char *fmt,...) = &printf;
+
+struct svm_model *model, *reduced;
+
+// predict every instance of input with both models
+void validate(FILE *input)
+{
+	int correct[2] = {0,0};
+	double error[2] = {0,0};
+	double seconds[2] = {0,0};
+	int total = 0;
+	int svm_type = svm_get_svm_type(model);
+	struct instance_reader reader;
+	double target_label;
+
+	instance_reader_init(&reader,input);
+	while(instance_reader_next(&reader,&target_label))
+	{
+		int k;
+
+		for(k=0;k<2;k++)
+		{
+			clock_t start = clock();
+			double predict_label = svm_predict(k == 0 ? model : reduced,reader.x);
+			seconds[k] += (double)(clock()-start)/CLOCKS_PER_SEC;
+			if(predict_label == target_label)
+				++correct[k];
+			error[k] += (predict_label-target_label)*(predict_label-target_label);
+		}
+		++total;
+	}
+	instance_reader_free(&reader);
+	if(total == 0)
+		return;
+
+	if (svm_type==NU_SVR || svm_type==EPSILON_SVR)
+		info("Mean squared error = %g -> %g (regression)\n",error[0]/total,error[1]/total);
+	else
+		info("Accuracy = %g%% -> %g%% (%d/%d -> %d/%d) (classification)\n",
+			(double)correct[0]/total*100,(double)correct[1]/total*100,
+			correct[0],total,correct[1],total);
+	info("Prediction time = %gs -> %gs\n",seconds[0],seconds[1]);
+}
+
+void exit_with_help()
+{
+	printf(
+	"Usage: svm-reduce [options] model_file [reduced_model_file]\n"
+	"options:\n"
+	"-n nr_sv : keep at most nr_sv SVs, 0 for no limit (default 1/10 of the SVs, 0 if -e is given)\n"
+	"	memory grows with nr_sv: up to 8*nr_sv*l bytes for a model of l SVs\n"
+	"-e tolerance : stop when the relative error |w-w'|/|w| of the decision functions falls below tolerance (default 0)\n"
+	"-v validation_file : compare the accuracy or mean squared error of both models on validation_file\n"
+	"-q : quiet mode (no outputs)\n"
+	);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char reduced_file_name[1024];
+	const char *validation_file_name = NULL;
+	int nr_sv = -1;
+	double tolerance = 0;
+	int i;
+	// parse options
+	for(i=1;i<argc;i++)
+	{
+		if(argv[i][0] != '-') break;
+		if(++i>=argc && argv[i-1][1] != 'q')
+			exit_with_help();
+		switch(argv[i-1][1])
+		{
+			case 'n':
+				nr_sv = atoi(argv[i]);
+				break;
+			case 'e':
+				tolerance = atof(argv[i]);
+				break;
+			case 'v':
+				validation_file_name = argv[i];
+				break;
+			case 'q':
+				info = &print_null;
+				svm_set_print_string_function(&print_string_null);
+				i--;
+				break;
+			default:
+				fprintf(stderr,"Unknown option: -%c\n", argv[i-1][1]);
+				exit_with_help();
+		}
+	}
+
+	if(i>=argc)
+		exit_with_help();
+
+	if(i<argc-1)
+		strcpy(reduced_file_name,argv[i+1]);
+	else
+		sprintf(reduced_file_name,"%s.reduced",argv[i]);
+
+	if((model=svm_load_model(argv[i]))==0)
+	{
+		fprintf(stderr,"can't open model file %s\n",argv[i]);
+		exit(1);
+	}
+
+	if(nr_sv < 0)
+		nr_sv = tolerance > 0 ? 0 : (svm_get_nr_sv(model)+9)/10;
+	reduced = svm_reduce_model(model,nr_sv,tolerance);
+	if(svm_save_model(reduced_file_name,reduced))
+	{
+		fprintf(stderr,"can't save model to file %s\n",reduced_file_name);
+		exit(1);
+	}
+
+	if(validation_file_name)
+	{
+		FILE *input = fopen(validation_file_name,"r");
+		if(input == NULL)
+		{
+			fprintf(stderr,"can't open validation file %s\n",validation_file_name);
+			exit(1);
+		}
+		validate(input);
+		fclose(input);
+	}
+
+	svm_free_and_destroy_model(&model);
+	svm_free_and_destroy_model(&reduced);
+	return 0;
+}
@@ -33,8 +33,24 @@ void exit_with_help()
 	"-p epsilon : set the epsilon in loss function of epsilon-SVR (default 0.1)\n"
 	"-m cachesize : set cache memory size in MB (default 100)\n"
 	"-e epsilon : set tolerance of termination criterion (default 0.001)\n"
-	"-h shrinking : whether to use the shrinking heuristics, 0 or 1 (default 1)\n"
+	"-h shrinking : whether to use the shrinking heuristics, 0, 1 or 2 to decide automatically (default 1)\n"
 	"-b probability_estimates : whether to train a SVC or SVR model for probability estimates, 0 or 1 (default 0)\n"
+	"-i max_iter : set the iteration limit of each optimization (default 0, meaning max(10000000,100*l))\n"
+	"-l max_time : set the wall-clock limit of training in seconds (default 0, no limit)\n"
+	"-a solver : set the solver for C-SVC and epsilon-SVR with the linear kernel or -y (default 0)\n"
+	"	0 -- SMO\n"
+	"	1 -- dual coordinate descent, O(nnz) per pass (bias is regularized)\n"
+	"-j working_set_size : set the number of variables optimized together by SMO, 0 or 2 for pairs, up to 1024 (default 0)\n"
+	"-u cache_slack : let SMO choose a variable with a cached kernel column if it gives at least 1-cache_slack of the best gain (default 0)\n"
+	"-x out_of_core : whether to read the rows from a memory-mapped file instead of memory, 0 or 1 (default 0)\n"
+	"	training_set_file is used in place if svm_convert_problem wrote it, else converted to model_file.rows first\n"
+	"-y nr_landmark : train on a Nystrom approximation of the kernel of rank nr_landmark, 0 for the exact kernel (default 0)\n"
+	"-z landmark_iter : set the k-means iterations that place the landmarks, 0 for a uniform sample of the data (default 0)\n"
+	"-S screening : whether to leave out likely non-SVs before training and add back those the result shows to be SVs, 0, 1 or 2 for more, for C-SVC and epsilon-SVR (default 0)\n"
+	"-o trace_file : write the progress of each optimization to trace_file\n"
+	"-k checkpoint_file : save the training state to checkpoint_file and resume from it\n"
+	"-f nr_model : train an ensemble of nr_model SVMs, each on 1/nr_model of the data, and save it as model_file (default 1)\n"
+	"-B bootstrap : whether the members of -f draw their instances with replacement instead of splitting the data, 0 or 1 (default 0)\n"
 	"-wi weight : set the parameter C of class i to weight*C, for C-SVC (default 1)\n"
 	"-v n: n-fold cross validation mode\n"
 	"-q : quiet mode (no outputs)\n"
@@ -50,14 +66,37 @@ void exit_input_error(int line_num)
 
 void parse_command_line(int argc, char **argv, char *input_file_name, char *model_file_name);
 void read_problem(const char *filename);
+void map_problem(const char *filename, const char *model_file_name);
+void check_problem(int max_index);
 void do_cross_validation();
 
 struct svm_parameter param;		// set by parse_command_line
 struct svm_problem prob;		// set by read_problem
 struct svm_model *model;
 struct svm_node *x_space;
+struct svm_problem *mapped;	// set by map_problem
+char *rows_file_name;	// converted by map_problem, removed at the end
 int cross_validation;
 int nr_fold;
+FILE *trace;		// set by -o
+const char *checkpoint_file_name;	// set by -k
+int nr_model;	// set by -f
+int bootstrap;	// set by -B
+
+// one line per progress report, a header before each optimization
+int write_trace(const struct svm_progress *progress, void *user)
+{
+	FILE *fp = (FILE *)user;
+	if(progress->iter == 0)
+	{
+		if(ftell(fp) > 0)
+			fprintf(fp,"\n");
+		fprintf(fp,"# l iter violation active_size obj cache_hit_rate elapsed\n");
+	}
+	fprintf(fp,"%d %d %.10g %d %.17g %g %g\n",progress->l,progress->iter,progress->violation,
+		progress->active_size,progress->obj,progress->cache_hit_rate,progress->elapsed);
+	return 0;
+}
 
 static char *line = NULL;
 static int max_line_len;
@@ -87,7 +126,10 @@ int main(int argc, char **argv)
 	const char *error_msg;
 
 	parse_command_line(argc, argv, input_file_name, model_file_name);
-	read_problem(input_file_name);
+	if(param.out_of_core)
+		map_problem(input_file_name, model_file_name);
+	else
+		read_problem(input_file_name);
 	error_msg = svm_check_parameter(&prob,&param);
 
 	if(error_msg)
@@ -102,18 +144,46 @@ int main(int argc, char **argv)
 	}
 	else
 	{
-		model = svm_train(&prob,&param);
-		if(svm_save_model(model_file_name,model))
+		if(nr_model > 1)
 		{
-			fprintf(stderr, "can't save model to file %s\n", model_file_name);
-			exit(1);
+			struct svm_ensemble *ensemble = svm_train_ensemble(&prob,&param,nr_model,bootstrap);
+			if(svm_save_ensemble(model_file_name,ensemble))
+			{
+				fprintf(stderr, "can't save model to file %s\n", model_file_name);
+				exit(1);
+			}
+			svm_free_and_destroy_ensemble(&ensemble);
+		}
+		else
+		{
+			if(checkpoint_file_name)
+				model = svm_train_checkpoint(&prob,&param,checkpoint_file_name,600);
+			else
+				model = svm_train(&prob,&param);
+			if(svm_save_model(model_file_name,model))
+			{
+				fprintf(stderr, "can't save model to file %s\n", model_file_name);
+				exit(1);
+			}
+			svm_free_and_destroy_model(&model);
 		}
-		svm_free_and_destroy_model(&model);
 	}
+	if(trace)
+		fclose(trace);
 	svm_destroy_param(&param);
-	free(prob.y);
-	free(prob.x);
-	free(x_space);
+	if(mapped)
+	{
+		svm_unmap_problem(mapped);
+		if(rows_file_name)
+			remove(rows_file_name);
+		free(rows_file_name);
+	}
+	else
+	{
+		free(prob.y);
+		free(prob.x);
+		free(x_space);
+	}
 	free(line);
 
 	return 0;
@@ -176,10 +246,21 @@ void parse_command_line(int argc, char **argv, char *input_file_name, char *mode
 	param.p = 0.1;
 	param.shrinking = 1;
 	param.probability = 0;
+	param.max_iter = 0;
+	param.max_time = 0;
+	param.solver = SMO;
+	param.working_set_size = 0;
+	param.cache_slack = 0;
+	param.out_of_core = 0;
+	param.nr_landmark = 0;
+	param.landmark_iter = 0;
+	param.screening = 0;
 	param.nr_weight = 0;
 	param.weight_label = NULL;
 	param.weight = NULL;
 	cross_validation = 0;
+	nr_model = 1;
+	bootstrap = 0;
 
 	// parse options
 	for(i=1;i<argc;i++)
@@ -225,6 +306,56 @@ void parse_command_line(int argc, char **argv, char *input_file_name, char *mode
 			case 'b':
 				param.probability = atoi(argv[i]);
 				break;
+			case 'i':
+				param.max_iter = atoi(argv[i]);
+				break;
+			case 'l':
+				param.max_time = atof(argv[i]);
+				break;
+			case 'a':
+				param.solver = atoi(argv[i]);
+				break;
+			case 'j':
+				param.working_set_size = atoi(argv[i]);
+				break;
+			case 'u':
+				param.cache_slack = atof(argv[i]);
+				break;
+			case 'x':
+				param.out_of_core = atoi(argv[i]);
+				break;
+			case 'y':
+				param.nr_landmark = atoi(argv[i]);
+				break;
+			case 'z':
+				param.landmark_iter = atoi(argv[i]);
+				break;
+			case 'S':
+				param.screening = atoi(argv[i]);
+				break;
+			case 'o':
+				trace = fopen(argv[i],"w");
+				if(trace == NULL)
+				{
+					fprintf(stderr,"can't open trace file %s\n",argv[i]);
+					exit(1);
+				}
+				svm_set_progress_function(&write_trace,trace);
+				break;
+			case 'k':
+				checkpoint_file_name = argv[i];
+				break;
+			case 'f':
+				nr_model = atoi(argv[i]);
+				if(nr_model < 1)
+				{
+					fprintf(stderr,"ensemble: nr_model must >= 1\n");
+					exit_with_help();
+				}
+				break;
+			case 'B':
+				bootstrap = atoi(argv[i]);
+				break;
 			case 'q':
 				print_func = &print_null;
 				i--;
@@ -253,6 +384,27 @@ void parse_command_line(int argc, char **argv, char *input_file_name, char *mode
 
 	svm_set_print_string_function(print_func);
 
+	if(nr_model > 1 && checkpoint_file_name)
+	{
+		fprintf(stderr,"ensembles are trained without checkpoints\n");
+		exit_with_help();
+	}
+	if(param.screening && checkpoint_file_name)
+	{
+		fprintf(stderr,"screening is done without checkpoints\n");
+		exit_with_help();
+	}
+	if(nr_model > 1 && param.probability)
+	{
+		fprintf(stderr,"ensembles do not support probability estimates\n");
+		exit_with_help();
+	}
+	if(bootstrap && nr_model <= 1)
+	{
+		fprintf(stderr,"bootstrap is for ensembles (-f)\n");
+		exit_with_help();
+	}
+
 	// determine filenames
 
 	if(i>=argc)
@@ -358,6 +510,46 @@ void read_problem(const char *filename)
 		x_space[j++].index = -1;
 	}
 
+	check_problem(max_index);
+	fclose(fp);
+}
+
+// map a problem file written by svm_convert_problem, converting a text
+// file to one first; the rows stay on disk
+
+void map_problem(const char *filename, const char *model_file_name)
+{
+	int max_index, i;
+
+	mapped = svm_map_problem(filename);
+	if(mapped == NULL)
+	{
+		rows_file_name = Malloc(char,strlen(model_file_name)+6);
+		sprintf(rows_file_name,"%s.rows",model_file_name);
+		if(svm_convert_problem(filename,rows_file_name) != 0 ||
+		   (mapped = svm_map_problem(rows_file_name)) == NULL)
+		{
+			fprintf(stderr,"can't convert input file %s to %s\n",filename,rows_file_name);
+			exit(1);
+		}
+	}
+	prob = *mapped;
+
+	max_index = 0;
+	for(i=0;i<prob.l;i++)
+	{
+		const struct svm_node *p = prob.x[i];
+		for(;p->index != -1;p++)
+			if(p->index > max_index)
+				max_index = p->index;
+	}
+	check_problem(max_index);
+}
+
+void check_problem(int max_index)
+{
+	int i;
+
 	if(param.gamma == 0 && max_index > 0)
 		param.gamma = 1.0/max_index;
 
@@ -375,6 +567,4 @@ void read_problem(const char *filename)
 				exit(1);
 			}
 		}
-
-	fclose(fp);
 }
@@ -44,8 +44,19 @@ void exit_with_help()
 	"-p epsilon : set the epsilon in loss function of epsilon-SVR (default 0.1)\n"
 	"-m cachesize : set cache memory size in MB (default 100)\n"
 	"-e epsilon : set tolerance of termination criterion (default 0.001)\n"
-	"-h shrinking : whether to use the shrinking heuristics, 0 or 1 (default 1)\n"
+	"-h shrinking : whether to use the shrinking heuristics, 0, 1 or 2 to decide automatically (default 1)\n"
 	"-b probability_estimates : whether to train a SVC or SVR model for probability estimates, 0 or 1 (default 0)\n"
+	"-i max_iter : set the iteration limit of each optimization (default 0, meaning max(10000000,100*l))\n"
+	"-l max_time : set the wall-clock limit of training in seconds (default 0, no limit)\n"
+	"-a solver : set the solver for C-SVC and epsilon-SVR with the linear kernel or -y (default 0)\n"
+	"	0 -- SMO\n"
+	"	1 -- dual coordinate descent, O(nnz) per pass (bias is regularized)\n"
+	"-j working_set_size : set the number of variables optimized together by SMO, 0 or 2 for pairs, up to 1024 (default 0)\n"
+	"-u cache_slack : let SMO choose a variable with a cached kernel column if it gives at least 1-cache_slack of the best gain (default 0)\n"
+	"-x out_of_core : whether the rows are in a memory-mapped file, 0 or 1; 1 keeps no in-memory copies of them and computes kernel columns in storage order (default 0)\n"
+	"-y nr_landmark : train on a Nystrom approximation of the kernel of rank nr_landmark, 0 for the exact kernel (default 0)\n"
+	"-z landmark_iter : set the k-means iterations that place the landmarks, 0 for a uniform sample of the data (default 0)\n"
+	"-S screening : whether to leave out likely non-SVs before training and add back those the result shows to be SVs, 0, 1 or 2 for more, for C-SVC and epsilon-SVR (default 0)\n"
 	"-wi weight : set the parameter C of class i to weight*C, for C-SVC (default 1)\n"
 	"-v n: n-fold cross validation mode\n"
 	"-q : quiet mode (no outputs)\n"
@@ -125,6 +136,15 @@ int parse_command_line(int nrhs, const mxArray *prhs[], char *model_file_name)
 	param.p = 0.1;
 	param.shrinking = 1;
 	param.probability = 0;
+	param.max_iter = 0;
+	param.max_time = 0;
+	param.solver = SMO;
+	param.working_set_size = 0;
+	param.cache_slack = 0;
+	param.out_of_core = 0;
+	param.nr_landmark = 0;
+	param.landmark_iter = 0;
+	param.screening = 0;
 	param.nr_weight = 0;
 	param.weight_label = NULL;
 	param.weight = NULL;
@@ -187,6 +207,33 @@ int parse_command_line(int nrhs, const mxArray *prhs[], char *model_file_name)
 			case 'b':
 				param.probability = atoi(argv[i]);
 				break;
+			case 'i':
+				param.max_iter = atoi(argv[i]);
+				break;
+			case 'l':
+				param.max_time = atof(argv[i]);
+				break;
+			case 'a':
+				param.solver = atoi(argv[i]);
+				break;
+			case 'j':
+				param.working_set_size = atoi(argv[i]);
+				break;
+			case 'u':
+				param.cache_slack = atof(argv[i]);
+				break;
+			case 'x':
+				param.out_of_core = atoi(argv[i]);
+				break;
+			case 'y':
+				param.nr_landmark = atoi(argv[i]);
+				break;
+			case 'z':
+				param.landmark_iter = atoi(argv[i]);
+				break;
+			case 'S':
+				param.screening = atoi(argv[i]);
+				break;
 			case 'q':
 				print_func = &print_null;
 				i--;
@@ -19,7 +19,8 @@ if sys.version_info[0] < 3:
 
 __all__ = ['libsvm', 'svm_problem', 'svm_parameter',
            'toPyModel', 'gen_svm_nodearray', 'print_null', 'svm_node', 'svm_forms',
-            'PRINT_STRING_FUN', 'kernel_names', 'c_double', 'svm_model']
+            'PRINT_STRING_FUN', 'kernel_names', 'c_double', 'svm_model',
+            'svm_progress', 'PROGRESS_FUN', 'svm_ensemble', 'toPyEnsemble']
 
 def _load_libsvm():
     """Load the libsvm shared library."""
@@ -288,10 +289,12 @@ class svm_problem(Structure):
 class svm_parameter(Structure):
     _names = ["svm_type", "kernel_type", "degree", "gamma", "coef0",
             "cache_size", "eps", "C", "nr_weight", "weight_label", "weight",
-            "nu", "p", "shrinking", "probability"]
+            "nu", "p", "shrinking", "probability", "max_iter", "max_time", "solver",
+            "working_set_size", "cache_slack", "out_of_core", "nr_landmark", "landmark_iter", "screening"]
     _types = [c_int, c_int, c_int, c_double, c_double,
             c_double, c_double, c_double, c_int, POINTER(c_int), POINTER(c_double),
-            c_double, c_double, c_int, c_int]
+            c_double, c_double, c_int, c_int, c_int, c_double, c_int,
+            c_int, c_double, c_int, c_int, c_int, c_int]
     _fields_ = genFields(_names, _types)
 
     def __init__(self, options = None):
@@ -322,6 +325,15 @@ class svm_parameter(Structure):
         self.p = 0.1
         self.shrinking = 1
         self.probability = 0
+        self.max_iter = 0
+        self.max_time = 0
+        self.solver = 0
+        self.working_set_size = 0
+        self.cache_slack = 0
+        self.out_of_core = 0
+        self.nr_landmark = 0
+        self.landmark_iter = 0
+        self.screening = 0
         self.nr_weight = 0
         self.weight_label = None
         self.weight = None
@@ -379,6 +391,33 @@ class svm_parameter(Structure):
             elif argv[i] == "-b":
                 i = i + 1
                 self.probability = int(argv[i])
+            elif argv[i] == "-i":
+                i = i + 1
+                self.max_iter = int(argv[i])
+            elif argv[i] == "-l":
+                i = i + 1
+                self.max_time = float(argv[i])
+            elif argv[i] == "-a":
+                i = i + 1
+                self.solver = int(argv[i])
+            elif argv[i] == "-j":
+                i = i + 1
+                self.working_set_size = int(argv[i])
+            elif argv[i] == "-u":
+                i = i + 1
+                self.cache_slack = float(argv[i])
+            elif argv[i] == "-x":
+                i = i + 1
+                self.out_of_core = int(argv[i])
+            elif argv[i] == "-y":
+                i = i + 1
+                self.nr_landmark = int(argv[i])
+            elif argv[i] == "-z":
+                i = i + 1
+                self.landmark_iter = int(argv[i])
+            elif argv[i] == "-S":
+                i = i + 1
+                self.screening = int(argv[i])
             elif argv[i] == "-q":
                 self.print_func = ctypes_print_null
             elif argv[i] == "-v":
@@ -403,6 +442,17 @@ class svm_parameter(Structure):
             self.weight[i] = weight[i]
             self.weight_label[i] = weight_label[i]
 
+class svm_progress(Structure):
+    _names = ["l", "iter", "violation", "active_size", "obj",
+            "cache_hit_rate", "elapsed", "gap", "stopped"]
+    _types = [c_int, c_int, c_double, c_int, c_double,
+            c_double, c_double, c_double, c_int]
+    _fields_ = genFields(_names, _types)
+
+# return nonzero to stop training; keep a reference to the PROGRESS_FUN
+# object while it is set
+PROGRESS_FUN = CFUNCTYPE(c_int, POINTER(svm_progress), c_void_p)
+
 class svm_model(Structure):
     _names = ['param', 'nr_class', 'l', 'SV', 'sv_coef', 'rho',
             'probA', 'probB', 'prob_density_marks', 'sv_indices',
@@ -479,11 +529,52 @@ def toPyModel(model_ptr):
     m.__createfrom__ = 'C'
     return m
 
+class svm_ensemble(Structure):
+    _names = ['nr_model', 'model']
+    _types = [c_int, POINTER(POINTER(svm_model))]
+    _fields_ = genFields(_names, _types)
+
+    def __init__(self):
+        self.__createfrom__ = 'python'
+
+    def __del__(self):
+        # free memory created by C to avoid memory leak
+        if hasattr(self, '__createfrom__') and self.__createfrom__ == 'C':
+            libsvm.svm_free_and_destroy_ensemble(pointer(pointer(self)))
+
+def toPyEnsemble(ensemble_ptr):
+    """
+    toPyEnsemble(ensemble_ptr) -> svm_ensemble
+
+    Convert a ctypes POINTER(svm_ensemble) to a Python svm_ensemble
+    """
+    if bool(ensemble_ptr) == False:
+        raise ValueError("Null pointer")
+    e = ensemble_ptr.contents
+    e.__createfrom__ = 'C'
+    return e
+
 fillprototype(libsvm.svm_train, POINTER(svm_model), [POINTER(svm_problem), POINTER(svm_parameter)])
+fillprototype(libsvm.svm_train_warm, POINTER(svm_model), [POINTER(svm_problem), POINTER(svm_parameter), POINTER(svm_model)])
+fillprototype(libsvm.svm_train_path, None, [POINTER(svm_problem), POINTER(svm_parameter), c_int, POINTER(c_double), POINTER(POINTER(svm_model))])
+fillprototype(libsvm.svm_train_cascade, POINTER(svm_model), [POINTER(svm_problem), POINTER(svm_parameter), c_int, c_int])
+fillprototype(libsvm.svm_train_checkpoint, POINTER(svm_model), [POINTER(svm_problem), POINTER(svm_parameter), c_char_p, c_double])
 fillprototype(libsvm.svm_cross_validation, None, [POINTER(svm_problem), POINTER(svm_parameter), c_int, POINTER(c_double)])
+fillprototype(libsvm.svm_reduce_model, POINTER(svm_model), [POINTER(svm_model), c_int, c_double])
+fillprototype(libsvm.svm_train_ensemble, POINTER(svm_ensemble), [POINTER(svm_problem), POINTER(svm_parameter), c_int, c_int])
 
 fillprototype(libsvm.svm_save_model, c_int, [c_char_p, POINTER(svm_model)])
 fillprototype(libsvm.svm_load_model, POINTER(svm_model), [c_char_p])
+fillprototype(libsvm.svm_save_ensemble, c_int, [c_char_p, POINTER(svm_ensemble)])
+fillprototype(libsvm.svm_load_ensemble, POINTER(svm_ensemble), [c_char_p])
+fillprototype(libsvm.svm_convert_problem, c_int, [c_char_p, c_char_p])
+fillprototype(libsvm.svm_map_problem, POINTER(svm_problem), [c_char_p])
+fillprototype(libsvm.svm_unmap_problem, None, [POINTER(svm_problem)])
+fillprototype(libsvm.svm_incremental_create, c_void_p, [POINTER(svm_problem), POINTER(svm_parameter)])
+fillprototype(libsvm.svm_incremental_add, c_int, [c_void_p, POINTER(svm_node), c_double])
+fillprototype(libsvm.svm_incremental_remove, c_int, [c_void_p, c_int])
+fillprototype(libsvm.svm_incremental_model, POINTER(svm_model), [c_void_p])
+fillprototype(libsvm.svm_incremental_destroy, None, [c_void_p])
 
 fillprototype(libsvm.svm_get_svm_type, c_int, [POINTER(svm_model)])
 fillprototype(libsvm.svm_get_nr_class, c_int, [POINTER(svm_model)])
@@ -495,11 +586,15 @@ fillprototype(libsvm.svm_get_svr_probability, c_double, [POINTER(svm_model)])
 fillprototype(libsvm.svm_predict_values, c_double, [POINTER(svm_model), POINTER(svm_node), POINTER(c_double)])
 fillprototype(libsvm.svm_predict, c_double, [POINTER(svm_model), POINTER(svm_node)])
 fillprototype(libsvm.svm_predict_probability, c_double, [POINTER(svm_model), POINTER(svm_node), POINTER(c_double)])
+fillprototype(libsvm.svm_predict_ensemble_values, c_double, [POINTER(svm_ensemble), POINTER(svm_node), POINTER(c_double)])
+fillprototype(libsvm.svm_predict_ensemble, c_double, [POINTER(svm_ensemble), POINTER(svm_node)])
 
 fillprototype(libsvm.svm_free_model_content, None, [POINTER(svm_model)])
 fillprototype(libsvm.svm_free_and_destroy_model, None, [POINTER(POINTER(svm_model))])
+fillprototype(libsvm.svm_free_and_destroy_ensemble, None, [POINTER(POINTER(svm_ensemble))])
 fillprototype(libsvm.svm_destroy_param, None, [POINTER(svm_parameter)])
 
 fillprototype(libsvm.svm_check_parameter, c_char_p, [POINTER(svm_problem), POINTER(svm_parameter)])
 fillprototype(libsvm.svm_check_probability_model, c_int, [POINTER(svm_model)])
 fillprototype(libsvm.svm_set_print_string_function, None, [PRINT_STRING_FUN])
+fillprototype(libsvm.svm_set_progress_function, None, [PROGRESS_FUN, c_void_p])
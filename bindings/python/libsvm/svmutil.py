@@ -82,8 +82,19 @@ def svm_train(arg1, arg2=None, arg3=None):
         -p epsilon : set the epsilon in loss function of epsilon-SVR (default 0.1)
         -m cachesize : set cache memory size in MB (default 100)
         -e epsilon : set tolerance of termination criterion (default 0.001)
-        -h shrinking : whether to use the shrinking heuristics, 0 or 1 (default 1)
+        -h shrinking : whether to use the shrinking heuristics, 0, 1 or 2 to decide automatically (default 1)
         -b probability_estimates : whether to train a model for probability estimates, 0 or 1 (default 0)
+        -i max_iter : set the iteration limit of each optimization (default 0, meaning max(10000000,100*l))
+        -l max_time : set the wall-clock limit of training in seconds (default 0, no limit)
+        -a solver : set the solver for C-SVC and epsilon-SVR with the linear kernel or -y (default 0)
+            0 -- SMO
+            1 -- dual coordinate descent, O(nnz) per pass (bias is regularized)
+        -j working_set_size : set the number of variables optimized together by SMO, 0 or 2 for pairs, up to 1024 (default 0)
+        -u cache_slack : let SMO choose a variable with a cached kernel column if it gives at least 1-cache_slack of the best gain (default 0)
+        -x out_of_core : whether the rows are in a memory-mapped file, 0 or 1; 1 keeps no in-memory copies of them and computes kernel columns in storage order (default 0)
+        -y nr_landmark : train on a Nystrom approximation of the kernel of rank nr_landmark, 0 for the exact kernel (default 0)
+        -z landmark_iter : set the k-means iterations that place the landmarks, 0 for a uniform sample of the data (default 0)
+        -S screening : whether to leave out likely non-SVs before training and add back those the result shows to be SVs, 0, 1 or 2 for more, for C-SVC and epsilon-SVR (default 0)
         -wi weight : set the parameter C of class i to weight*C, for C-SVC (default 1)
         -v n: n-fold cross validation mode
         -q : quiet mode (no outputs)
@@ -133,6 +144,8 @@ def svm_train(arg1, arg2=None, arg3=None):
             return ACC
     else:
         m = libsvm.svm_train(prob, param)
+        if not m:
+            raise RuntimeError('Error: training cancelled by the progress function')
         m = toPyModel(m)
 
         # If prob is destroyed, data including SVs pointed by m can remain.
@@ -103,6 +103,15 @@ private slots:
 		param.p = 0.1;
 		param.shrinking = 1;
 		param.probability = 0;
+		param.max_iter = 0;
+		param.max_time = 0;
+		param.solver = SMO;
+		param.working_set_size = 0;
+		param.cache_slack = 0;
+		param.out_of_core = 0;
+		param.nr_landmark = 0;
+		param.landmark_iter = 0;
+		param.screening = 0;
 		param.nr_weight = 0;
 		param.weight_label = NULL;
 		param.weight = NULL;
@@ -79,6 +79,13 @@ for BUILD_TYPE in Release Debug; do
         "$ROOT_DIR/build/heart_scale.model" \
         "$ROOT_DIR/build/heart_scale.output"
 
+    # Test svm-reduce
+    info "Testing svm-reduce..."
+    "$ROOT_DIR/build/bin/svm-reduce" \
+        -v "$ROOT_DIR/examples/data/heart_scale" \
+        "$ROOT_DIR/build/heart_scale.model" \
+        "$ROOT_DIR/build/heart_scale.reduced.model"
+
     # Test svm-scale
     info "Testing svm-scale..."
     "$ROOT_DIR/build/bin/svm-scale" \
@@ -367,6 +374,7 @@ info "Verifying installation..."
 test -f "$ROOT_DIR/install/include/svm.h" || fail "svm.h not installed"
 test -f "$ROOT_DIR/install/bin/svm-train" || fail "svm-train not installed"
 test -f "$ROOT_DIR/install/bin/svm-predict" || fail "svm-predict not installed"
+test -f "$ROOT_DIR/install/bin/svm-reduce" || fail "svm-reduce not installed"
 test -f "$ROOT_DIR/install/bin/svm-scale" || fail "svm-scale not installed"
 
 info "Testing find_package..."
@@ -77,6 +77,13 @@ foreach ($BUILD_TYPE in @("Release", "Debug")) {
         "$ROOT_DIR/build/heart_scale.model" `
         "$ROOT_DIR/build/heart_scale.output"
 
+    # Test svm-reduce
+    Info "Testing svm-reduce..."
+    & "$ROOT_DIR/build/bin/$BUILD_TYPE/svm-reduce.exe" `
+        -v "$ROOT_DIR/examples/data/heart_scale" `
+        "$ROOT_DIR/build/heart_scale.model" `
+        "$ROOT_DIR/build/heart_scale.reduced.model"
+
     # Test svm-scale
     Info "Testing svm-scale..."
     & "$ROOT_DIR/build/bin/$BUILD_TYPE/svm-scale.exe" `
@@ -261,6 +268,7 @@ Info "Verifying installation..."
 if (!(Test-Path "$ROOT_DIR/install/include/svm.h")) { Fail "svm.h not installed" }
 if (!(Test-Path "$ROOT_DIR/install/bin/svm-train.exe")) { Fail "svm-train.exe not installed" }
 if (!(Test-Path "$ROOT_DIR/install/bin/svm-predict.exe")) { Fail "svm-predict.exe not installed" }
+if (!(Test-Path "$ROOT_DIR/install/bin/svm-reduce.exe")) { Fail "svm-reduce.exe not installed" }
 if (!(Test-Path "$ROOT_DIR/install/bin/svm-scale.exe")) { Fail "svm-scale.exe not installed" }
 
 Info "Testing find_package..."
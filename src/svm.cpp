@@ -7,12 +7,33 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#include <stdint.h>
+#include <errno.h>
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <vector>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <mutex>
 #include "svm.h"
 #ifdef _OPENMP
 #include <omp.h>
+#include <condition_variable>
+#include <exception>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SVM_SSE2
 #endif
 
 int libsvm_version = LIBSVM_VERSION;
@@ -44,6 +65,18 @@ static inline double powi(double base, int times)
 	return ret;
 }
 
+static inline int popcount64(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(v);
+#else
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
 #define INF HUGE_VAL
 #define TAU 1e-12
 // Legacy Malloc macro for compatibility (consider using auto_array or std::vector in new code)
@@ -55,6 +88,8 @@ static void print_string_stdout(const char *s)
 	fflush(stdout);
 }
 static void (*svm_print_string) (const char *) = &print_string_stdout;
+static int (*svm_progress_function) (const svm_progress *, void *) = NULL;
+static void *svm_progress_user = NULL;
 #if 1
 static void info(const char *fmt,...)
 {
@@ -69,6 +104,255 @@ static void info(const char *fmt,...)
 static void info(const char *fmt,...) {}
 #endif
 
+// seconds since an arbitrary fixed point, for training budgets
+static double wall_time()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// iterations of the optimizations run on this thread, for trainings made
+// of several that share one max_iter
+static thread_local long solver_iterations = 0;
+
+// a random integer in [0,n), from rng or, if NULL, from rand()
+static int random_below(std::minstd_rand *rng, int n)
+{
+	return rng != NULL ? (int)((*rng)()%(unsigned)n) : rand()%n;
+}
+
+//
+// Progress reports and cancellation
+//
+// svm_progress_function is shared by every thread, and cascade nodes and
+// ensemble members are trained concurrently, so it is called under a lock,
+// one report at a time. A nonzero return cancels the whole training call
+// it reports on: cancels are counted, each training call remembers the
+// count it started with (progress_scope, kept by nested calls and handed
+// to the threads working for it), and its optimizations stop as soon as
+// the count moves. The outermost call then returns NULL.
+//
+static std::mutex progress_mutex;
+static std::atomic<unsigned> progress_cancels(0);
+static thread_local unsigned progress_epoch = 0;
+static thread_local int progress_depth = 0;	// training calls running on this thread
+
+static bool training_cancelled()
+{
+	return progress_depth > 0 && progress_cancels.load(std::memory_order_relaxed) != progress_epoch;
+}
+
+// pass progress to svm_progress_function; return true if training is to stop
+static bool progress_report(const svm_progress *progress)
+{
+	std::lock_guard<std::mutex> lock(progress_mutex);
+	if(training_cancelled())
+		return true;
+	if(svm_progress_function != NULL && svm_progress_function(progress,svm_progress_user) != 0)
+	{
+		++progress_cancels;
+		return true;
+	}
+	return false;
+}
+
+class progress_scope
+{
+public:
+	// a training call; one inside another belongs to the outer one
+	progress_scope(): saved_epoch(progress_epoch), saved_depth(progress_depth)
+	{
+		if(progress_depth++ == 0)
+			progress_epoch = progress_cancels.load();
+	}
+	// a thread working for the training call that has epoch
+	explicit progress_scope(unsigned epoch): saved_epoch(progress_epoch), saved_depth(progress_depth)
+	{
+		progress_epoch = epoch;
+		++progress_depth;
+	}
+	~progress_scope()
+	{
+		progress_epoch = saved_epoch;
+		progress_depth = saved_depth;
+	}
+	unsigned epoch() const { return progress_epoch; }
+	// true if this is the outermost call and it was cancelled
+	bool cancelled() const { return saved_depth == 0 && training_cancelled(); }
+private:
+	unsigned saved_epoch;
+	int saved_depth;
+};
+
+#ifdef _OPENMP
+//
+// Parallel granularity
+//
+// Opening a parallel region costs a fork/join, measured once per
+// process. A loop is split over only as many threads as can each be
+// given several times that cost in work, so short loops run serially.
+//
+static double measure_parallel_overhead()
+{
+	const int rounds = 16;
+	double start = omp_get_wtime();
+	for(int r=0;r<rounds;r++)
+	{
+#pragma omp parallel
+		{
+		}
+	}
+	return (omp_get_wtime()-start)/rounds;
+}
+
+// work: estimated serial running time of the loop in seconds
+static int parallel_threads(double work)
+{
+	if(omp_in_parallel())
+		return 1;
+	int max_threads = omp_get_max_threads();
+	if(max_threads <= 1)
+		return 1;
+	static const double overhead = measure_parallel_overhead();
+	double chunk = 4*overhead;
+	if(work < 2*chunk)
+		return 1;
+	return (int)min((double)max_threads,work/chunk);
+}
+
+//
+// Persistent thread team
+//
+// Threads of one OpenMP region kept for a whole solve. Thread 0 runs the
+// solver and hands out short tasks with run(); the other threads wait in
+// work() between tasks, so each task costs a barrier rather than a
+// fork/join. A waiting thread spins for a few microseconds, enough to
+// catch the next pass of a busy solve, and then sleeps on a condition
+// variable. Every thread acknowledges every task, participating or not,
+// so the task description is never overwritten while being read. An
+// exception thrown by a task is rethrown by run() on thread 0.
+//
+class SolverTeam
+{
+public:
+	typedef void (*task_t)(void *ctx, int t, int nr);
+
+	SolverTeam(): nr_thread(1), task(NULL), ctx(NULL), nr_task(0), generation(0), pending(0), sleepers(0) {}
+	void init(int size) { nr_thread = size; generation = 0; }
+	int size() const { return nr_thread; }
+
+	// on thread 0: task(ctx,t,nr) on threads t < nr, return when all are done
+	void run(task_t task_, void *ctx_, int nr)
+	{
+		error = NULL;
+		publish(task_,ctx_,nr);
+		try
+		{
+			task(ctx,0,nr);
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(!error)
+				error = std::current_exception();
+		}
+		// the others may still be reading ctx, which lives on this stack
+		if(!spin_until([this] { return pending.load(std::memory_order_acquire) == 0; }))
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock,[this] { return pending.load(std::memory_order_acquire) == 0; });
+		}
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+	// on threads 1..size()-1: serve tasks until stop()
+	// (init() must have happened before any thread calls run or work)
+	void work(int t)
+	{
+		int seen = 0;
+		for(;;)
+		{
+			if(!spin_until([&] { return generation.load(std::memory_order_acquire) != seen; }))
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				++sleepers;
+				wake.wait(lock,[&] { return generation.load(std::memory_order_acquire) != seen; });
+				--sleepers;
+			}
+			seen = generation.load(std::memory_order_acquire);
+			if(task == NULL)
+				return;
+			if(t < nr_task)
+			{
+				try
+				{
+					task(ctx,t,nr_task);
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if(!error)
+						error = std::current_exception();
+				}
+			}
+			if(pending.fetch_sub(1,std::memory_order_acq_rel) == 1)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				done.notify_one();
+			}
+		}
+	}
+
+	// on thread 0
+	void stop()
+	{
+		publish(NULL,NULL,0);
+	}
+private:
+	int nr_thread;
+	task_t task;
+	void *ctx;
+	int nr_task;
+	std::atomic<int> generation;
+	std::atomic<int> pending;
+	int sleepers;	// threads waiting on wake, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	std::exception_ptr error;
+
+	void publish(task_t task_, void *ctx_, int nr)
+	{
+		bool sleeping;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = task_;
+			ctx = ctx_;
+			nr_task = nr;
+			pending.store(nr_thread-1,std::memory_order_relaxed);
+			generation.fetch_add(1,std::memory_order_release);
+			sleeping = sleepers > 0;
+		}
+		if(sleeping)
+			wake.notify_all();
+	}
+
+	// whether cond() held within the spinning period
+	template <class F>
+	static bool spin_until(F cond)
+	{
+		for(int spin=0;spin<4096;spin++)
+		{
+			if(cond())
+				return true;
+#ifdef SVM_SSE2
+			_mm_pause();
+#endif
+		}
+		return cond();
+	}
+};
+#endif
+
 //
 // Kernel Cache
 //
@@ -85,10 +369,20 @@ public:
 	// return some position p where [p,len) need to be filled
 	// (p >= len if nothing needs to be filled)
 	int get_data(const int index, Qfloat **data, int len);
+	// look at a column without touching the LRU order
+	// return the cached length (0 if not cached)
+	int peek(const int index, Qfloat **data) const;
 	void swap_index(int i, int j);
+	// room for columns [0,l_), l_ >= l, keeping the cached ones
+	void grow(int l_);
+	// drop columns [len,l) and the entries of the others from len on
+	void truncate(int len);
+	// fraction of get_data requests found fully cached
+	double hit_rate() const { return nr_request ? (double)nr_hit/(double)nr_request : 0; }
 private:
 	int l;
 	size_t size;
+	long long nr_request, nr_hit;
 	struct head_t
 	{
 		head_t *prev, *next;	// a circular list
@@ -102,7 +396,7 @@ private:
 	void lru_insert(head_t *h);
 };
 
-Cache::Cache(int l_,size_t size_):l(l_),size(size_)
+Cache::Cache(int l_,size_t size_):l(l_),size(size_),nr_request(0),nr_hit(0)
 {
 	head = (head_t *)calloc(l,sizeof(head_t));	// initialized to 0
 	size /= sizeof(Qfloat);
@@ -139,6 +433,9 @@ int Cache::get_data(const int index, Qfloat **data, int len)
 	head_t *h = &head[index];
 	if(h->len) lru_delete(h);
 	int more = len - h->len;
+	nr_request++;
+	if(more <= 0)
+		nr_hit++;
 
 	if(more > 0)
 	{
@@ -164,6 +461,12 @@ int Cache::get_data(const int index, Qfloat **data, int len)
 	return len;
 }
 
+int Cache::peek(const int index, Qfloat **data) const
+{
+	*data = head[index].data;
+	return head[index].len;
+}
+
 void Cache::swap_index(int i, int j)
 {
 	if(i==j) return;
@@ -195,6 +498,262 @@ void Cache::swap_index(int i, int j)
 	}
 }
 
+void Cache::grow(int l_)
+{
+	head_t *old = head;
+	head_t *h = lru_head.next;
+	head = (head_t *)calloc(l_,sizeof(head_t));
+	lru_head.next = lru_head.prev = &lru_head;
+	size_t used = 0;
+	while(h != &lru_head)
+	{
+		head_t *next = h->next;
+		head_t *n = &head[h-old];
+		n->data = h->data;
+		n->len = h->len;
+		used += (size_t)n->len;
+		lru_insert(n);
+		h = next;
+	}
+	free(old);
+
+	// the new headers come out of the budget, which must still hold two columns
+	size_t header_size = (size_t)(l_-l) * sizeof(head_t) / sizeof(Qfloat);
+	size = size > header_size ? size - header_size : 0;
+	if(size + used < 2 * (size_t) l_)
+		size = 2 * (size_t) l_ - used;
+	l = l_;
+}
+
+void Cache::truncate(int len)
+{
+	for(head_t *h = lru_head.next; h != &lru_head;)
+	{
+		head_t *next = h->next;
+		if(h - head >= len)
+		{
+			lru_delete(h);
+			free(h->data);
+			size += h->len;
+			h->data = 0;
+			h->len = 0;
+		}
+		else if(h->len > len)
+		{
+			h->data = (Qfloat *)realloc(h->data,sizeof(Qfloat)*len);
+			size += h->len - len;
+			h->len = len;
+		}
+		h = next;
+	}
+}
+
+//
+// Sorted-index intersection
+//
+// Rows are sorted by index. dot() picks a strategy from the two lengths:
+// galloping search for skewed pairs, 4x4 block comparison with SSE2
+// for balanced ones, and the plain merge for short rows. Matches are
+// always accumulated in increasing index order, so every strategy
+// returns exactly the same sum.
+//
+static inline int row_key(const svm_node *p) { return p->index; }
+static inline int row_key(const int *p) { return *p; }
+static inline double row_product(const svm_node *p, const svm_node *q) { return p->value * q->value; }
+static inline double row_product(const int *, const int *) { return 1; }
+
+// matches are added to sum, so a merge can finish a partial intersection
+template <class T>
+static double intersect_merge(const T *px, int nx, const T *py, int ny, double sum = 0)
+{
+	int i = 0, j = 0;
+	while(i < nx && j < ny)
+	{
+		int a = row_key(px+i), b = row_key(py+j);
+		if(a == b)
+		{
+			sum += row_product(px+i,py+j);
+			++i;
+			++j;
+		}
+		else if(a > b)
+			++j;
+		else
+			++i;
+	}
+	return sum;
+}
+
+// ps is the short row; every element is located in pl by doubling the
+// step from the previous match and then binary searching the bracket
+template <class T>
+static double intersect_gallop(const T *ps, int ns, const T *pl, int nl)
+{
+	double sum = 0;
+	int lo = 0;
+	for(int i=0;i<ns && lo<nl;i++)
+	{
+		int key = row_key(ps+i);
+		if(row_key(pl+lo) < key)
+		{
+			int step = 1;
+			while(lo+step < nl && row_key(pl+lo+step) < key)
+			{
+				lo += step;
+				step *= 2;
+			}
+			int hi = min(lo+step,nl);	// row_key(pl+lo) < key <= row_key(pl+hi)
+			while(hi-lo > 1)
+			{
+				int mid = lo+(hi-lo)/2;
+				if(row_key(pl+mid) < key)
+					lo = mid;
+				else
+					hi = mid;
+			}
+			lo = hi;
+			if(lo == nl)
+				break;
+		}
+		if(row_key(pl+lo) == key)
+		{
+			sum += row_product(ps+i,pl+lo);
+			++lo;
+		}
+	}
+	return sum;
+}
+
+#ifdef SVM_SSE2
+static inline __m128i load_keys(const int *p)
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline __m128i load_keys(const svm_node *p)
+{
+	// gather the index field of four consecutive 16-byte nodes
+	__m128i n0 = _mm_loadu_si128((const __m128i *)(p));
+	__m128i n1 = _mm_loadu_si128((const __m128i *)(p+1));
+	__m128i n2 = _mm_loadu_si128((const __m128i *)(p+2));
+	__m128i n3 = _mm_loadu_si128((const __m128i *)(p+3));
+	return _mm_unpacklo_epi64(_mm_unpacklo_epi32(n0,n1),_mm_unpacklo_epi32(n2,n3));
+}
+
+// adds the matches of pa[k] for the set bits k of mask, in index order
+static inline void block_matches(const svm_node *pa, const svm_node *pb, int mask, double& sum)
+{
+	for(int k=0;k<4;k++)
+		if(mask & (1<<k))
+			for(int m=0;m<4;m++)
+				if(pb[m].index == pa[k].index)
+				{
+					sum += pa[k].value * pb[m].value;
+					break;
+				}
+}
+
+static inline void block_matches(const int *, const int *, int mask, double& sum)
+{
+	sum += (double)popcount64((uint64_t)mask);
+}
+
+template <class T>
+static double intersect_simd(const T *px, int nx, const T *py, int ny)
+{
+	double sum = 0;
+	int i = 0, j = 0;
+	while(i+4 <= nx && j+4 <= ny)
+	{
+		__m128i a = load_keys(px+i);
+		__m128i b = load_keys(py+j);
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi32(a,b),
+				_mm_cmpeq_epi32(a,_mm_shuffle_epi32(b,_MM_SHUFFLE(0,3,2,1)))),
+			_mm_or_si128(_mm_cmpeq_epi32(a,_mm_shuffle_epi32(b,_MM_SHUFFLE(1,0,3,2))),
+				_mm_cmpeq_epi32(a,_mm_shuffle_epi32(b,_MM_SHUFFLE(2,1,0,3)))));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+		if(mask)
+			block_matches(px+i,py+j,mask,sum);
+		int a_last = row_key(px+i+3), b_last = row_key(py+j+3);
+		if(a_last <= b_last)
+			i += 4;
+		if(b_last <= a_last)
+			j += 4;
+	}
+	return intersect_merge(px+i,nx-i,py+j,ny-j,sum);
+}
+#endif
+
+static double dense_dot(const double *a, const double *b, int n)
+{
+	int k = 0;
+	double sum;
+#ifdef SVM_SSE2
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	for(;k+4<=n;k+=4)
+	{
+		s0 = _mm_add_pd(s0,_mm_mul_pd(_mm_loadu_pd(a+k),_mm_loadu_pd(b+k)));
+		s1 = _mm_add_pd(s1,_mm_mul_pd(_mm_loadu_pd(a+k+2),_mm_loadu_pd(b+k+2)));
+	}
+	double t[2];
+	_mm_storeu_pd(t,_mm_add_pd(s0,s1));
+	sum = t[0]+t[1];
+#else
+	double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for(;k+4<=n;k+=4)
+	{
+		s0 += a[k]*b[k];
+		s1 += a[k+1]*b[k+1];
+		s2 += a[k+2]*b[k+2];
+		s3 += a[k+3]*b[k+3];
+	}
+	sum = (s0+s1)+(s2+s3);
+#endif
+	for(;k<n;k++)
+		sum += a[k]*b[k];
+	return sum;
+}
+
+template <class T>
+static double intersect(const T *px, int nx, const T *py, int ny)
+{
+	if(nx > ny)
+	{
+		swap(px,py);
+		swap(nx,ny);
+	}
+	if(nx == 0)
+		return 0;
+	if(ny >= 16*nx)
+		return intersect_gallop(px,nx,py,ny);
+#ifdef SVM_SSE2
+	if(nx >= 8)
+		return intersect_simd(px,nx,py,ny);
+#endif
+	return intersect_merge(px,nx,py,ny);
+}
+
+// sort keys, distinct values in [0,universe): by comparison when they are
+// few, else by marking them in a bitmap, so either way the cost is about
+// that of keys.size() plus universe/64 words
+static void sort_distinct(vector<int>& keys, int universe)
+{
+	int n = (int)keys.size();
+	if(n <= universe/64)
+	{
+		std::sort(keys.begin(),keys.end());
+		return;
+	}
+	vector<uint64_t> bits((size_t)universe/64+1,0);
+	for(int key : keys)
+		bits[(size_t)key/64] |= (uint64_t)1 << (key%64);
+	int r = 0;
+	for(size_t w=0;w<bits.size();w++)
+		for(uint64_t b=bits[w];b!=0;b&=b-1)
+			keys[r++] = (int)(w*64)+popcount64((b & (~b+1))-1);	// lowest set bit
+}
+
 //
 // Kernel evaluation
 //
@@ -205,8 +764,31 @@ void Cache::swap_index(int i, int j)
 class QMatrix {
 public:
 	virtual Qfloat *get_Q(int column, int len) const = 0;
+	// get_Q in two steps for callers that spread the fill over threads:
+	// get_Q_lookup returns the cached column with [0,*start) valid and
+	// fill_Q computes [begin,end) of it; fill_Q calls may run concurrently
+	virtual Qfloat *get_Q_lookup(int column, int len, int *start) const = 0;
+	virtual void fill_Q(int column, Qfloat *data, int begin, int end) const = 0;
+	// fill_Q of [start,len) split into ranges, when entries depend on each
+	// other: fill_Q_pass(column,data,begin,end,start,len,pass) for every
+	// range and pass < fill_Q_passes(), each pass done before the next
+	virtual int fill_Q_passes() const { return 1; }
+	virtual void fill_Q_pass(int column, Qfloat *data, int begin, int end, int, int, int) const
+	{
+		fill_Q(column,data,begin,end);
+	}
+	// the cached part [0,returned length) of a column, without counting a
+	// request or touching the LRU order; may run concurrently with fill_Q
+	virtual int peek_Q(int column, const Qfloat **data) const = 0;
 	virtual double *get_QD() const = 0;
 	virtual void swap_index(int i, int j) const = 0;
+	virtual double get_cache_hit_rate() const = 0;
+	// multiply-adds of one kernel evaluation, roughly
+	virtual double get_kernel_cost() const = 0;
+#ifdef _OPENMP
+	// seconds of one kernel evaluation, sampled
+	virtual double get_eval_time() const = 0;
+#endif
 	virtual ~QMatrix() {}
 };
 
@@ -217,6 +799,7 @@ public:
 
 	static double k_function(const svm_node *x, const svm_node *y,
 				 const svm_parameter& param);
+	double get_kernel_cost() const { return kernel_cost; }
 	virtual Qfloat *get_Q(int column, int len) const = 0;
 	virtual double *get_QD() const = 0;
 	virtual void swap_index(int i, int j) const	// no so const...
@@ -224,14 +807,52 @@ public:
 		// Use std::swap on vector elements (requires mutable)
 		std::swap(const_cast<svm_node const*&>(x[i]), const_cast<svm_node const*&>(x[j]));
 		if(x_square) swap(x_square[i],x_square[j]);
+		swap(x_len[i],x_len[j]);
+		if(!row.empty()) swap(row[i],row[j]);
+		if(!head_nnz.empty()) swap(head_nnz[i],head_nnz[j]);
+		if(!stored_pos.empty())
+		{
+			swap(stored_pos[stored_rank[i]],stored_pos[stored_rank[j]]);
+			swap(stored_rank[i],stored_rank[j]);
+		}
 	}
 protected:
 
 	double (Kernel::*kernel_function)(int i, int j) const;
 
+#ifdef _OPENMP
+	double eval_cost;	// seconds per kernel evaluation, sampled at construction
+	double get_eval_time() const { return eval_cost; }
+	int fill_threads(int n) const
+	{
+		return parallel_threads(n*eval_cost);
+	}
+#endif
+
+	// Out-of-core rows live in a mapped file that may not fit in memory.
+	// Columns are then filled in the order the rows are stored, so each
+	// fill reads the file front to back instead of paging at random.
+	mutable vector<int> stored_pos;	// position of the r-th stored row
+	mutable vector<int> stored_rank;	// inverse of stored_pos
+	bool streaming() const { return !stored_pos.empty(); }
+
+	// the positions in [begin,end), in storage order; the cost is that of
+	// the range, not of l
+	void stored_order(int begin, int end, vector<int>& pos) const
+	{
+		pos.resize(end-begin);
+		for(int p=begin;p<end;p++)
+			pos[p-begin] = stored_rank[p];
+		sort_distinct(pos,(int)stored_rank.size());
+		for(int& p : pos)
+			p = stored_pos[p];
+	}
+
 private:
 	vector<svm_node const*> x;
 	double *x_square;
+	mutable vector<int> x_len;	// number of nonzeros of each row
+	double kernel_cost;
 
 	// svm_parameter
 	const int kernel_type;
@@ -239,22 +860,61 @@ private:
 	const double gamma;
 	const double coef0;
 
+	// When every feature value is 1 (one-hot, bag-of-words) a row is
+	// just a set of indices and the dot product is the size of the
+	// intersection. Such rows are kept as index lists, or as bitmaps
+	// when the feature range is small compared to the number of nonzeros.
+	//
+	// Mostly-dense leading features followed by a sparse tail: indices
+	// below head_dim are stored as a contiguous dense block per row and
+	// the remaining nonzeros stay in the original svm_node list.
+	//
+	// Whatever the format, the converted rows share one block, row_space,
+	// and row[i] points at row i in it: int indices, uint64_t[bit_words]
+	// or double[head_dim]. Rows with negative indices stay sparse.
+	enum { SPARSE_ROWS, BINARY_INDEX_ROWS, BINARY_BITMAP_ROWS, HYBRID_ROWS };
+	int row_format;
+	void *row_space;
+	mutable vector<const void *> row;
+	int bit_words;
+	int head_dim;
+	mutable vector<int> head_nnz;	// nonzeros of x[i] below head_dim
+
 	static double dot(const svm_node *px, const svm_node *py);
+	static double dot(const uint64_t *px, const uint64_t *py, int n);
+	double row_dot(int i, int j) const
+	{
+		switch(row_format)
+		{
+			case BINARY_INDEX_ROWS:
+				return intersect((const int *)row[i],x_len[i],(const int *)row[j],x_len[j]);
+			case BINARY_BITMAP_ROWS:
+				return dot((const uint64_t *)row[i],(const uint64_t *)row[j],bit_words);
+			case HYBRID_ROWS:
+				return dense_dot((const double *)row[i],(const double *)row[j],head_dim)
+					+ intersect(x[i]+head_nnz[i],x_len[i]-head_nnz[i],
+						x[j]+head_nnz[j],x_len[j]-head_nnz[j]);
+			default:
+				return intersect(x[i],x_len[i],x[j],x_len[j]);
+		}
+	}
+	void build_binary_rows(int l);
+	void build_hybrid_rows(int l);
 	double kernel_linear(int i, int j) const
 	{
-		return dot(x[i],x[j]);
+		return row_dot(i,j);
 	}
 	double kernel_poly(int i, int j) const
 	{
-		return powi(gamma*dot(x[i],x[j])+coef0,degree);
+		return powi(gamma*row_dot(i,j)+coef0,degree);
 	}
 	double kernel_rbf(int i, int j) const
 	{
-		return exp(-gamma*(x_square[i]+x_square[j]-2*dot(x[i],x[j])));
+		return exp(-gamma*(x_square[i]+x_square[j]-2*row_dot(i,j)));
 	}
 	double kernel_sigmoid(int i, int j) const
 	{
-		return tanh(gamma*dot(x[i],x[j])+coef0);
+		return tanh(gamma*row_dot(i,j)+coef0);
 	}
 	double kernel_precomputed(int i, int j) const
 	{
@@ -286,48 +946,196 @@ Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 	}
 
 	x = clone<svm_node* const, svm_node const*>(x_, l);
+	x_len.resize(l);
+	double nnz = 0;
+	bool negative = false;
+	for(int i=0;i<l;i++)
+	{
+		int n = 0;
+		if(kernel_type != PRECOMPUTED)
+			for(; x[i][n].index != -1; ++n)
+				if(x[i][n].index < 0)
+					negative = true;
+		x_len[i] = n;
+		nnz += n;
+	}
+	// a dot product, then exp, pow or tanh
+	kernel_cost = (l > 0 ? nnz/l : 0) + (kernel_type == LINEAR || kernel_type == PRECOMPUTED ? 1 : 20);
+
+	row_format = SPARSE_ROWS;
+	row_space = NULL;
+	bit_words = 0;
+	head_dim = 0;
+	// the other row formats copy every nonzero into memory
+	if(kernel_type != PRECOMPUTED && !param.out_of_core && !negative)
+	{
+		build_binary_rows(l);
+		if(row_format == SPARSE_ROWS)
+			build_hybrid_rows(l);
+	}
 
 	if(kernel_type == RBF)
 	{
 		x_square = new double[l];
 		for(int i=0;i<l;i++)
-			x_square[i] = dot(x[i],x[i]);
+			x_square[i] = row_dot(i,i);
 	}
 	else
 		x_square = 0;
+
+	if(param.out_of_core)
+	{
+		stored_pos.resize(l);
+		stored_rank.resize(l);
+		for(int i=0;i<l;i++)
+			stored_pos[i] = i;
+		// rows were stored in address order; the problem may list them in another
+		std::sort(stored_pos.begin(),stored_pos.end(),
+			[this](int a, int b) { return std::less<const svm_node *>()(x[a],x[b]); });
+		for(int r=0;r<l;r++)
+			stored_rank[stored_pos[r]] = r;
+	}
+
+#ifdef _OPENMP
+	{
+		int n = min(l,64);
+		double sink = 0, start = omp_get_wtime();
+		for(int k=0;k<n;k++)
+			sink += (this->*kernel_function)(k,(k*7+1)%l);
+		eval_cost = n > 0 ? (omp_get_wtime()-start)/n : 0;
+		if(sink != sink)	// keep the sampled evaluations
+			eval_cost = 0;
+	}
+#endif
 }
 
 Kernel::~Kernel()
 {
 	delete[] x_square;
+	free(row_space);
 }
 
-double Kernel::dot(const svm_node *px, const svm_node *py)
+void Kernel::build_binary_rows(int l)
 {
-	double sum = 0;
-	while(px->index != -1 && py->index != -1)
+	size_t nnz = 0;
+	int max_index = 0;
+	for(int i=0;i<l;i++)
+		for(const svm_node *px = x[i]; px->index != -1; ++px)
+		{
+			if(px->value != 1)
+				return;
+			max_index = max(max_index,px->index);
+			++nnz;
+		}
+	if(l == 0 || nnz == 0)
+		return;
+
+	int words = max_index/64+1;
+	if((size_t)words*(size_t)l <= nnz)
 	{
-		if(px->index == py->index)
+		// AND+popcount over the bitmaps is cheaper than merging index lists
+		row_format = BINARY_BITMAP_ROWS;
+		bit_words = words;
+		uint64_t *space = (uint64_t *)calloc((size_t)words*(size_t)l,sizeof(uint64_t));
+		row_space = space;
+		row.resize(l);
+		for(int i=0;i<l;i++)
 		{
-			sum += px->value * py->value;
-			++px;
-			++py;
+			uint64_t *bits = space+(size_t)i*(size_t)words;
+			for(const svm_node *px = x[i]; px->index != -1; ++px)
+				bits[px->index>>6] |= (uint64_t)1 << (px->index&63);
+			row[i] = bits;
 		}
-		else
+	}
+	else
+	{
+		row_format = BINARY_INDEX_ROWS;
+		int *space = Malloc(int,nnz);
+		row_space = space;
+		row.resize(l);
+		size_t k = 0;
+		for(int i=0;i<l;i++)
 		{
-			if(px->index > py->index)
-				++py;
-			else
-				++px;
+			row[i] = space+k;
+			for(const svm_node *px = x[i]; px->index != -1; ++px)
+				space[k++] = px->index;
 		}
 	}
-	return sum;
 }
 
-double Kernel::k_function(const svm_node *x, const svm_node *y,
-			  const svm_parameter& param)
+void Kernel::build_hybrid_rows(int l)
 {
-	switch(param.kernel_type)
+	// the head is the longest index prefix [0,d) in which at least half
+	// of the entries are nonzero, so the dense block never takes more
+	// memory than the svm_nodes it replaces
+	const int max_head = 4096;
+	vector<size_t> count(max_head,0);
+	for(int i=0;i<l;i++)
+		for(const svm_node *px = x[i]; px->index != -1 && px->index < max_head; ++px)
+			++count[px->index];
+
+	int d = 0;
+	size_t nnz = 0;
+	for(int k=0;k<max_head;k++)
+	{
+		nnz += count[k];
+		if(2*nnz >= (size_t)(k+1)*(size_t)l)
+			d = k+1;
+	}
+	if(d < 8)
+		return;
+
+	row_format = HYBRID_ROWS;
+	head_dim = d;
+	double *space = (double *)calloc((size_t)l*(size_t)d,sizeof(double));
+	row_space = space;
+	row.resize(l);
+	head_nnz.resize(l);
+	for(int i=0;i<l;i++)
+	{
+		double *head = space+(size_t)i*(size_t)d;
+		const svm_node *px = x[i];
+		for(; px->index != -1 && px->index < d; ++px)
+			head[px->index] = px->value;
+		row[i] = head;
+		head_nnz[i] = (int)(px - x[i]);
+	}
+}
+
+double Kernel::dot(const svm_node *px, const svm_node *py)
+{
+	double sum = 0;
+	while(px->index != -1 && py->index != -1)
+	{
+		if(px->index == py->index)
+		{
+			sum += px->value * py->value;
+			++px;
+			++py;
+		}
+		else
+		{
+			if(px->index > py->index)
+				++py;
+			else
+				++px;
+		}
+	}
+	return sum;
+}
+
+double Kernel::dot(const uint64_t *px, const uint64_t *py, int n)
+{
+	int count = 0;
+	for(int k=0;k<n;k++)
+		count += popcount64(px[k] & py[k]);
+	return count;
+}
+
+double Kernel::k_function(const svm_node *x, const svm_node *y,
+			  const svm_parameter& param)
+{
+	switch(param.kernel_type)
 	{
 		case LINEAR:
 			return dot(x,y);
@@ -383,6 +1191,527 @@ double Kernel::k_function(const svm_node *x, const svm_node *y,
 	}
 }
 
+//
+// Kernel evaluations of one test instance against many SVs
+//
+// The leading part of the instance, indices [0,head), is scattered once
+// into a bitmap if the instance is binary (all values 1) or into a
+// dense array otherwise. Each SV then costs one lookup per nonzero in
+// the head plus a merge with the remaining sparse tail of the instance.
+// The head is bounded by the work it saves over nr_sv evaluations.
+//
+// RBF sums squared differences as Kernel::k_function does; expanding
+// |x|^2+|sv|^2-2*dot(x,sv) cancels for nearby points. Only a binary
+// instance is scattered for RBF, where the unmatched part of the head
+// is an exact count.
+//
+// The scatter buffers are kept per thread and only grow; an instance
+// clears the entries it set when it goes away, so a prediction costs
+// O(nnz) rather than O(head). An instance created while another one is
+// alive on the same thread uses buffers of its own.
+//
+struct predict_scratch
+{
+	vector<uint64_t> bits;
+	vector<double> dense;
+	bool busy = false;
+};
+static thread_local predict_scratch predict_buffers;
+
+class PredictInstance {
+public:
+	PredictInstance(const svm_node *x, const svm_parameter& param, int nr_sv);
+	~PredictInstance();
+	PredictInstance(const PredictInstance&) = delete;
+	PredictInstance& operator=(const PredictInstance&) = delete;
+	double k_function(const svm_node *sv, const svm_parameter& param) const;
+	void k_values(const svm_model *model, double *kvalue) const;
+private:
+	const svm_node *x;
+	bool binary;
+	int head;	// 0 if x is not scattered
+	int head_nnz;	// nonzeros of x below head
+	predict_scratch *buf;
+	predict_scratch own;
+	const uint64_t *bits;
+	const double *dense;
+	const svm_node *tail;
+
+	double square_distance(const svm_node *sv) const;
+};
+
+PredictInstance::PredictInstance(const svm_node *x_, const svm_parameter& param, int nr_sv)
+:x(x_), binary(true), head(0), head_nnz(0), buf(NULL), bits(NULL), dense(NULL), tail(x_)
+{
+	if(param.kernel_type == PRECOMPUTED)
+		return;
+
+	int nnz = 0, top = -1;
+	for(const svm_node *px = x; px->index != -1; ++px)
+	{
+		if(px->index < 0)
+			return;
+		if(px->value != 1)
+			binary = false;
+		top = max(top,px->index);
+		++nnz;
+	}
+	if(top < 0 || (param.kernel_type == RBF && !binary))
+		return;
+
+	// merge steps saved, at most; the caps keep either buffer at 2MB
+	double budget = (double)nnz * nr_sv;
+	if(binary)
+		head = (int)min((double)min(top+1,1<<24),64*budget);
+	else
+		head = (int)min((double)min(top+1,1<<18),budget);
+
+	buf = predict_buffers.busy ? &own : &predict_buffers;
+	buf->busy = true;
+	if(binary)
+	{
+		if(buf->bits.size() < (size_t)(head/64+1))
+			buf->bits.resize(head/64+1,0);
+		uint64_t *b = buf->bits.data();
+		for(; tail->index != -1 && tail->index < head; ++tail)
+			b[tail->index>>6] |= (uint64_t)1 << (tail->index&63);
+		bits = b;
+	}
+	else
+	{
+		if(buf->dense.size() < (size_t)head)
+			buf->dense.resize(head,0);
+		double *d = buf->dense.data();
+		for(; tail->index != -1 && tail->index < head; ++tail)
+			d[tail->index] = tail->value;
+		dense = d;
+	}
+	head_nnz = (int)(tail - x);
+	if(tail == x)
+		head = 0;
+}
+
+PredictInstance::~PredictInstance()
+{
+	if(buf == NULL)
+		return;
+	for(const svm_node *px = x; px != tail; ++px)
+		if(binary)
+			buf->bits[px->index>>6] = 0;
+		else
+			buf->dense[px->index] = 0;
+	buf->busy = false;
+}
+
+// |x-sv|^2 for a scattered binary x
+double PredictInstance::square_distance(const svm_node *sv) const
+{
+	double sum = 0;
+	int matched = 0;
+	for(; sv->index != -1 && sv->index < head; ++sv)
+	{
+		int k = sv->index;
+		if(k >= 0 && ((bits[k>>6] >> (k&63)) & 1))
+		{
+			double d = 1 - sv->value;
+			sum += d*d;
+			++matched;
+		}
+		else
+			sum += sv->value * sv->value;
+	}
+	sum += head_nnz - matched;
+
+	const svm_node *px = tail;
+	for(; sv->index != -1; ++sv)
+	{
+		for(; px->index != -1 && px->index < sv->index; ++px)
+			sum += px->value * px->value;
+		if(px->index == sv->index)
+		{
+			double d = px->value - sv->value;
+			sum += d*d;
+			++px;
+		}
+		else
+			sum += sv->value * sv->value;
+	}
+	for(; px->index != -1; ++px)
+		sum += px->value * px->value;
+	return sum;
+}
+
+double PredictInstance::k_function(const svm_node *sv, const svm_parameter& param) const
+{
+	if(head == 0)
+		return Kernel::k_function(x,sv,param);
+	if(param.kernel_type == RBF)
+		return exp(-param.gamma*square_distance(sv));
+
+	double sum = 0;
+	if(binary)
+	{
+		for(; sv->index != -1 && sv->index < head; ++sv)
+		{
+			int k = sv->index;
+			if(k >= 0 && ((bits[k>>6] >> (k&63)) & 1))
+				sum += sv->value;
+		}
+	}
+	else
+	{
+		for(; sv->index != -1 && sv->index < head; ++sv)
+			if(sv->index >= 0)
+				sum += dense[sv->index] * sv->value;
+	}
+	for(const svm_node *px = tail; sv->index != -1; ++sv)
+	{
+		while(px->index != -1 && px->index < sv->index)
+			++px;
+		if(px->index == sv->index)
+			sum += px->value * sv->value;
+	}
+
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return sum;
+		case POLY:
+			return powi(param.gamma*sum+param.coef0,param.degree);
+		case SIGMOID:
+			return tanh(param.gamma*sum+param.coef0);
+		default:
+			return 0;  // Unreachable
+	}
+}
+
+// kvalue[i] = K(x,SV[i]) for all SVs of the model
+void PredictInstance::k_values(const svm_model *model, double *kvalue) const
+{
+	int i = 0, l = model->l;
+#ifdef _OPENMP
+	// time a few SVs serially to decide whether the rest is worth a team
+	int probe = min(l,8);
+	double start = omp_get_wtime();
+	for(;i<probe;i++)
+		kvalue[i] = k_function(model->SV[i],model->param);
+	int nr_thread = probe > 0 ? parallel_threads((l-probe)*(omp_get_wtime()-start)/probe) : 1;
+#pragma omp parallel for num_threads(nr_thread) if(nr_thread > 1) schedule(guided)
+	for(int k=probe;k<l;k++)
+		kvalue[k] = k_function(model->SV[k],model->param);
+#else
+	for(;i<l;i++)
+		kvalue[i] = k_function(model->SV[i],model->param);
+#endif
+}
+
+//
+// Working set selection kernels
+//
+// Branch-free passes over the solver state kept as arrays: y as doubles
+// and masks that are 0 for variables inside a set (I_up, I_low, or one
+// class) and -INF outside, so excluded variables never win a maximum.
+// Ties go to the later index as in a forward scan, so the selected pairs
+// are the same as with the plain loops.
+//
+
+static inline void select_better_max(double v, int t, double& best, int& idx)
+{
+	if(v > best || (v == best && t > idx))
+	{
+		best = v;
+		idx = t;
+	}
+}
+
+static inline void select_better_min(double v, int t, double& best, int& idx)
+{
+	if(v < best || (v == best && t > idx))
+	{
+		best = v;
+		idx = t;
+	}
+}
+
+#ifdef SVM_SSE2
+static inline __m128d select_pd(__m128d mask, __m128d a, __m128d b)
+{
+	return _mm_or_pd(_mm_and_pd(mask,a),_mm_andnot_pd(mask,b));
+}
+
+static inline __m128d load_qfloat2(const Qfloat *q)
+{
+	return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)q)));
+}
+#endif
+
+// Gmax = max of -y_t*grad(f)_t + mask[t] (+ cls_mask[t] if by_class) over
+// t in [begin,end); idx = -1 if every t is masked out
+template <bool by_class>
+static void select_max(const double *yd, const double *G, const double *mask,
+	const double *cls_mask, int begin, int end, double& Gmax, int& idx)
+{
+	Gmax = -INF;
+	idx = -1;
+	int t = begin;
+#ifdef SVM_SSE2
+	if(end-begin >= 4)
+	{
+		const __m128d sign = _mm_set1_pd(-0.0), step = _mm_set1_pd(2);
+		__m128d best = _mm_set1_pd(-INF), best_pos = _mm_set1_pd(-1);
+		__m128d pos = _mm_set_pd(t+1,t);
+		for(;t+2<=end;t+=2,pos=_mm_add_pd(pos,step))
+		{
+			__m128d v = _mm_xor_pd(_mm_mul_pd(_mm_loadu_pd(yd+t),_mm_loadu_pd(G+t)),sign);
+			v = _mm_add_pd(v,_mm_loadu_pd(mask+t));
+			if(by_class)
+				v = _mm_add_pd(v,_mm_loadu_pd(cls_mask+t));
+			best_pos = select_pd(_mm_cmpge_pd(v,best),pos,best_pos);
+			best = _mm_max_pd(best,v);
+		}
+		double b[2], k[2];
+		_mm_storeu_pd(b,best);
+		_mm_storeu_pd(k,best_pos);
+		for(int r=0;r<2;r++)
+			select_better_max(b[r],(int)k[r],Gmax,idx);
+	}
+#endif
+	for(;t<end;t++)
+	{
+		double v = -(yd[t]*G[t]) + mask[t];
+		if(by_class)
+			v += cls_mask[t];
+		if(v >= Gmax)
+		{
+			Gmax = v;
+			idx = t;
+		}
+	}
+	if(Gmax == -INF)
+		idx = -1;
+}
+
+// the i chosen in the first pass, seen from the second
+struct select_target
+{
+	double Gmax;		// -y_i*grad(f)_i
+	double QD_i;
+	const Qfloat *Q_i;
+	double coef;		// quad_coef = QD_i + QD[j] - coef*y_j*Q_i[j]
+};
+
+// over j in [begin,end) not masked out: Gmax2 = max of y_j*grad(f)_j, and
+// the j with grad_diff = Gmax + y_j*grad(f)_j > 0 minimizing the second
+// order objective decrease obj_diff (Gmin_idx = -1 if there is none)
+template <bool by_class>
+static void select_min(const double *yd, const double *G, const double *mask,
+	const double *cls_mask, const double *QD, const select_target& ti,
+	int begin, int end, double& Gmax2, double& obj_diff_min, int& Gmin_idx)
+{
+	Gmax2 = -INF;
+	obj_diff_min = INF;
+	Gmin_idx = -1;
+	int j = begin;
+#ifdef SVM_SSE2
+	if(end-begin >= 4)
+	{
+		const __m128d zero = _mm_setzero_pd(), sign = _mm_set1_pd(-0.0);
+		const __m128d tau = _mm_set1_pd(TAU), step = _mm_set1_pd(2);
+		const __m128d Gmax = _mm_set1_pd(ti.Gmax), QD_i = _mm_set1_pd(ti.QD_i);
+		const __m128d coef = _mm_set1_pd(ti.coef);
+		__m128d g2 = _mm_set1_pd(-INF);
+		__m128d best = _mm_set1_pd(INF), best_pos = _mm_set1_pd(-1);
+		__m128d pos = _mm_set_pd(j+1,j);
+		for(;j+2<=end;j+=2,pos=_mm_add_pd(pos,step))
+		{
+			__m128d y2 = _mm_loadu_pd(yd+j);
+			__m128d v = _mm_add_pd(_mm_mul_pd(y2,_mm_loadu_pd(G+j)),_mm_loadu_pd(mask+j));
+			if(by_class)
+				v = _mm_add_pd(v,_mm_loadu_pd(cls_mask+j));
+			g2 = _mm_max_pd(g2,v);
+			__m128d grad_diff = _mm_add_pd(Gmax,v);
+			__m128d violating = _mm_cmpgt_pd(grad_diff,zero);
+			// most j do not violate the optimality condition; skip the division
+			if(_mm_movemask_pd(violating) == 0)
+				continue;
+
+			__m128d quad_coef = _mm_sub_pd(_mm_add_pd(QD_i,_mm_loadu_pd(QD+j)),
+				_mm_mul_pd(_mm_mul_pd(coef,y2),load_qfloat2(ti.Q_i+j)));
+			quad_coef = select_pd(_mm_cmpgt_pd(quad_coef,zero),quad_coef,tau);
+			__m128d obj_diff = _mm_div_pd(_mm_xor_pd(_mm_mul_pd(grad_diff,grad_diff),sign),quad_coef);
+			__m128d take = _mm_and_pd(violating,_mm_cmple_pd(obj_diff,best));
+			best = select_pd(take,obj_diff,best);
+			best_pos = select_pd(take,pos,best_pos);
+		}
+		double b[2], k[2];
+		_mm_storeu_pd(b,g2);
+		Gmax2 = max(b[0],b[1]);
+		_mm_storeu_pd(b,best);
+		_mm_storeu_pd(k,best_pos);
+		for(int r=0;r<2;r++)
+			if(k[r] >= 0)
+				select_better_min(b[r],(int)k[r],obj_diff_min,Gmin_idx);
+	}
+#endif
+	for(;j<end;j++)
+	{
+		double v = yd[j]*G[j] + mask[j];
+		if(by_class)
+			v += cls_mask[j];
+		Gmax2 = max(Gmax2,v);
+		double grad_diff = ti.Gmax+v;
+		if(grad_diff > 0)
+		{
+			double quad_coef = ti.QD_i+QD[j]-ti.coef*yd[j]*ti.Q_i[j];
+			if(quad_coef <= 0)
+				quad_coef = TAU;
+			double obj_diff = -(grad_diff*grad_diff)/quad_coef;
+			if(obj_diff <= obj_diff_min)
+			{
+				Gmin_idx = j;
+				obj_diff_min = obj_diff;
+			}
+		}
+	}
+}
+
+// G[k] += Q_i[k]*delta_alpha_i + Q_j[k]*delta_alpha_j for k in [begin,end)
+static void update_gradient(double *G, const Qfloat *Q_i, const Qfloat *Q_j,
+	double delta_alpha_i, double delta_alpha_j, int begin, int end)
+{
+	int k = begin;
+#ifdef SVM_SSE2
+	const __m128d di = _mm_set1_pd(delta_alpha_i), dj = _mm_set1_pd(delta_alpha_j);
+	for(;k+2<=end;k+=2)
+	{
+		__m128d g = _mm_loadu_pd(G+k);
+		__m128d d = _mm_add_pd(_mm_mul_pd(load_qfloat2(Q_i+k),di),_mm_mul_pd(load_qfloat2(Q_j+k),dj));
+		_mm_storeu_pd(G+k,_mm_add_pd(g,d));
+	}
+#endif
+	for(;k<end;k++)
+		G[k] += Q_i[k]*delta_alpha_i + Q_j[k]*delta_alpha_j;
+}
+
+// the SMO step: minimize over alpha_i and alpha_j along y_i alpha_i +
+// y_j alpha_j = const, clipped to [0,C_i] x [0,C_j]
+static void solve_pair(schar y_i, schar y_j, double G_i, double G_j,
+	double QD_i, double QD_j, double Q_ij, double C_i, double C_j,
+	double& alpha_i, double& alpha_j)
+{
+	if(y_i!=y_j)
+	{
+		double quad_coef = QD_i+QD_j+2*Q_ij;
+		if (quad_coef <= 0)
+			quad_coef = TAU;
+		double delta = (-G_i-G_j)/quad_coef;
+		double diff = alpha_i - alpha_j;
+		alpha_i += delta;
+		alpha_j += delta;
+
+		if(diff > 0)
+		{
+			if(alpha_j < 0)
+			{
+				alpha_j = 0;
+				alpha_i = diff;
+			}
+		}
+		else
+		{
+			if(alpha_i < 0)
+			{
+				alpha_i = 0;
+				alpha_j = -diff;
+			}
+		}
+		if(diff > C_i - C_j)
+		{
+			if(alpha_i > C_i)
+			{
+				alpha_i = C_i;
+				alpha_j = C_i - diff;
+			}
+		}
+		else
+		{
+			if(alpha_j > C_j)
+			{
+				alpha_j = C_j;
+				alpha_i = C_j + diff;
+			}
+		}
+	}
+	else
+	{
+		double quad_coef = QD_i+QD_j-2*Q_ij;
+		if (quad_coef <= 0)
+			quad_coef = TAU;
+		double delta = (G_i-G_j)/quad_coef;
+		double sum = alpha_i + alpha_j;
+		alpha_i -= delta;
+		alpha_j += delta;
+
+		if(sum > C_i)
+		{
+			if(alpha_i > C_i)
+			{
+				alpha_i = C_i;
+				alpha_j = sum - C_i;
+			}
+		}
+		else
+		{
+			if(alpha_j < 0)
+			{
+				alpha_j = 0;
+				alpha_i = sum;
+			}
+		}
+		if(sum > C_j)
+		{
+			if(alpha_j > C_j)
+			{
+				alpha_j = C_j;
+				alpha_i = sum - C_j;
+			}
+		}
+		else
+		{
+			if(alpha_i < 0)
+			{
+				alpha_i = 0;
+				alpha_j = sum;
+			}
+		}
+	}
+}
+
+// state of an SMO optimization in solver order, enough to continue it
+// exactly where it was saved
+struct solver_state
+{
+	int l;
+	int iter;
+	int counter;		// iterations to the next shrinking, plus one
+	int active_size;
+	int unshrink;
+	int shrink_period;
+	int shrink_round;
+	double shrink_saved;
+	double shrink_cost;
+	int *active_set;
+	double *alpha;
+	double *G;
+	double *G_bar;
+};
+
+// checkpoint of svm_train_checkpoint, defined with it below
+struct checkpoint;
+static bool checkpoint_due(const checkpoint *ck);
+static void checkpoint_save_state(checkpoint *ck, const solver_state *s, bool stopped);
+static const solver_state *checkpoint_state(checkpoint *ck, int l);
+
 // An SMO algorithm in Fan et al., JMLR 6(2005), p. 1889--1918
 // Solves:
 //
@@ -403,7 +1732,16 @@ double Kernel::k_function(const svm_node *x, const svm_node *y,
 //
 class Solver {
 public:
-	Solver() {};
+	Solver()
+	{
+		ck = NULL;
+		resume = NULL;
+		G_out = NULL;
+		G_bar_out = NULL;
+#ifdef _OPENMP
+		team = NULL;
+#endif
+	};
 	virtual ~Solver() {};
 
 	struct SolutionInfo {
@@ -412,11 +1750,33 @@ public:
 		double upper_bound_p;
 		double upper_bound_n;
 		double r;	// for Solver_NU
+		double gap;	// duality gap of the returned alpha
 	};
 
+	// Of param, only the budgets and the working set options are read:
+	// max_iter (0 for the default) and max_time (seconds, 0 for none)
+	// stop the optimization early with the current, feasible alpha;
+	// working_set_size q > 2 optimizes q variables per iteration instead
+	// of a pair; cache_slack > 0 lets j give up that fraction of its gain
+	// for a column already in the cache.
+	// perm, if not NULL, gives the instance at each row of Q (Q's rows may
+	// be left permuted by a previous solve); updated to the final order.
+	// ck, if not NULL, has the state saved now and then, and may have one
+	// to continue from
 	void Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		   double *alpha_, double Cp, double Cn, double eps,
-		   SolutionInfo* si, int shrinking);
+		   SolutionInfo* si, int shrinking, const svm_parameter& param,
+		   int *perm = NULL, checkpoint *ck = NULL);
+
+	// make the next Solve start from s, which must have alpha, G and
+	// G_bar of alpha_, and copy its final G and G_bar to G_out and
+	// G_bar_out in the order of the variables
+	void set_resume(const solver_state *s, double *G_out, double *G_bar_out)
+	{
+		resume = s;
+		this->G_out = G_out;
+		this->G_bar_out = G_bar_out;
+	}
 protected:
 	int active_size;
 	vector<schar> y;
@@ -431,8 +1791,77 @@ protected:
 	vector<double> p;
 	int *active_set;
 	double *G_bar;		// gradient, if we treat free variables as 0
+	vector<char> bar_upper;	// whether G_bar counts i as at the upper bound
 	int l;
 	bool unshrink;	// XXX
+	int shrinking;	// 0, 1, or 2 to decide as the solve goes
+
+	// for shrinking == 2: kernel entries that shrinking saved and that
+	// reconstruct_gradient cost since the gradient was last whole, and
+	// the rounds of counter from one shrinking to the next (0 for none)
+	double shrink_saved;
+	double shrink_cost;
+	int shrink_period;
+	int shrink_round;
+	// cache miss rate times kernel cost, sampled every min(l,1000) iterations
+	double shrink_miss_cost;
+	void adapt_shrinking();
+
+	// for working_set_size q > 2: the variables of the block, and the
+	// sub-problem over them laid out for the selection kernels
+	int working_set_size;
+	vector<int> ws;
+	vector<char> in_ws;		// whether i is in ws
+	vector<const Qfloat *> ws_col;	// Q_i[0,active_size) of each
+	vector<Qfloat> ws_Q;		// Q restricted to the block, row major
+	vector<double> ws_y, ws_G, ws_QD, ws_up, ws_low, ws_pos, ws_neg;
+	vector<std::pair<double,int> > ws_up_cand, ws_low_cand;
+	void select_block(int i, int j);
+	int solve_block(int i, int j);
+	virtual int select_block_pair(double eps, int &a, int &b);
+	void update_block_status(int a);
+
+	// for cache_slack > 0, and how often a cached j was taken instead
+	double cache_slack;
+	int nr_cache_pick;
+	bool column_cached(int j)
+	{
+		const Qfloat *data;
+		return Q->peek_Q(j,&data) >= active_size;
+	}
+	void select_cached(const select_target& ti, const double *cls_mask,
+			   double bound, double& obj_diff_min, int& Gmin_idx);
+
+	// state for the working set selection kernels
+	vector<double> yd;		// y as double
+	vector<double> up_mask;		// 0 if i in I_up(\alpha), -INF otherwise
+	vector<double> low_mask;	// 0 if i in I_low(\alpha), -INF otherwise
+	vector<double> pos_mask;	// 0 if y_i = +1, -INF otherwise
+	vector<double> neg_mask;	// 0 if y_i = -1, -INF otherwise
+
+	// results of one part of a range-split pass
+	struct alignas(64) part_result
+	{
+		double v[4];
+		double obj;
+		int idx[2];
+	};
+	vector<part_result> part;
+#ifdef _OPENMP
+	SolverTeam *team;	// threads sharing the passes over [0,l) of this solve
+#endif
+	checkpoint *ck;
+	const solver_state *resume;
+	double *G_out, *G_bar_out;
+
+	void save_state(int iter, int counter, bool stopped);
+	void restore_state(const solver_state *s);
+
+	// run f(t,begin_t,end_t) on nr consecutive parts of [begin,end), one
+	// per team thread, each at least grain long; return nr
+	template <class F> int for_range(int begin, int end, int grain, F& f);
+	// Q->get_Q, with the missing entries filled by the team
+	const Qfloat *column(int i, int len);
 
 	double get_C(int i)
 	{
@@ -445,14 +1874,24 @@ protected:
 		else if(alpha[i] <= 0)
 			alpha_status[i] = LOWER_BOUND;
 		else alpha_status[i] = FREE;
+		bool up = y[i] > 0 ? alpha_status[i] != UPPER_BOUND : alpha_status[i] != LOWER_BOUND;
+		bool low = y[i] > 0 ? alpha_status[i] != LOWER_BOUND : alpha_status[i] != UPPER_BOUND;
+		up_mask[i] = up ? 0 : -INF;
+		low_mask[i] = low ? 0 : -INF;
 	}
 	bool is_upper_bound(int i) { return alpha_status[i] == UPPER_BOUND; }
 	bool is_lower_bound(int i) { return alpha_status[i] == LOWER_BOUND; }
 	bool is_free(int i) { return alpha_status[i] == FREE; }
 	void swap_index(int i, int j);
+	double add_columns(const vector<int>& col, const vector<double>& coef,
+			   double *v, int begin, int end);
+	void update_G_bar();
 	void reconstruct_gradient();
 	virtual int select_working_set(int &i, int &j);
 	virtual double calculate_rho();
+	double calculate_gap(double rho, double r);
+	double violation;	// Gmax+Gmax2 of the last working set selection
+	bool report_progress(int iter, double start_time, double obj, double gap, int stopped);
 	// Helper methods for array access
 	schar* y_data() { return y.data(); }
 	double* alpha_data() { return alpha.data(); }
@@ -462,77 +1901,518 @@ private:
 	bool be_shrunk(int i, double Gmax1, double Gmax2);
 };
 
-void Solver::swap_index(int i, int j)
-{
-	Q->swap_index(i,j);
-	swap(y[i],y[j]);
-	swap(G[i],G[j]);
-	swap(alpha_status[i],alpha_status[j]);
-	swap(alpha[i],alpha[j]);
-	swap(p[i],p[j]);
-	swap(active_set[i],active_set[j]);
-	swap(G_bar[i],G_bar[j]);
-}
+// grain of the range-split passes, in variables and in kernel evaluations
+static const int SOLVER_GRAIN = 4096;
+static const int SOLVER_FILL_GRAIN = 64;
 
-void Solver::reconstruct_gradient()
+#ifdef _OPENMP
+template <class F>
+struct range_task
 {
-	// reconstruct inactive elements of G from G_bar and free variables
+	F *f;
+	int begin, end;
+
+	static void run(void *ctx, int t, int nr)
+	{
+		range_task *r = (range_task *)ctx;
+		long long n = r->end - r->begin;
+		(*r->f)(t,r->begin+(int)(n*t/nr),r->begin+(int)(n*(t+1)/nr));
+	}
+};
+#endif
+
+template <class F>
+int Solver::for_range(int begin, int end, int grain, F& f)
+{
+#ifdef _OPENMP
+	if(team != NULL)
+	{
+		int nr = min(team->size(),(end-begin)/grain);
+		if(nr > 1)
+		{
+			range_task<F> r = { &f, begin, end };
+			team->run(&range_task<F>::run,&r,nr);
+			return nr;
+		}
+	}
+#endif
+	f(0,begin,end);
+	return 1;
+}
+
+const Qfloat *Solver::column(int i, int len)
+{
+#ifdef _OPENMP
+	if(team != NULL)
+	{
+		int start;
+		Qfloat *data = Q->get_Q_lookup(i,len,&start);
+		int nr_pass = Q->fill_Q_passes();
+		for(int pass=0;pass<nr_pass && start<len;pass++)
+		{
+			auto fill = [&](int, int b, int e) { Q->fill_Q_pass(i,data,b,e,start,len,pass); };
+			for_range(start,len,SOLVER_FILL_GRAIN,fill);
+		}
+		return data;
+	}
+#endif
+	return Q->get_Q(i,len);
+}
+
+void Solver::swap_index(int i, int j)
+{
+	Q->swap_index(i,j);
+	swap(y[i],y[j]);
+	swap(G[i],G[j]);
+	swap(alpha_status[i],alpha_status[j]);
+	swap(alpha[i],alpha[j]);
+	swap(p[i],p[j]);
+	swap(active_set[i],active_set[j]);
+	swap(G_bar[i],G_bar[j]);
+	swap(bar_upper[i],bar_upper[j]);
+	swap(yd[i],yd[j]);
+	swap(up_mask[i],up_mask[j]);
+	swap(low_mask[i],low_mask[j]);
+	swap(pos_mask[i],pos_mask[j]);
+	swap(neg_mask[i],neg_mask[j]);
+}
+
+// v[k] += sum_c coef[c]*Q_col[c][k] for k in [begin,end), over threads.
+// An entry comes from the cached column, or from the cached row k as Q is
+// symmetric, and is evaluated otherwise; nothing is put into the cache, so
+// columns needed only here do not evict those of the working sets. The
+// entries are added in the order of col whatever their source. Return the
+// number of kernel evaluations.
+double Solver::add_columns(const vector<int>& col, const vector<double>& coef,
+			   double *v, int begin, int end)
+{
+	int n = (int)col.size();
+	if(n == 0 || begin >= end)
+		return 0;
+	vector<const Qfloat *> col_data(n);
+	vector<int> col_len(n);
+	for(int c=0;c<n;c++)
+		col_len[c] = Q->peek_Q(col[c],&col_data[c]);
+
+	int nr_part = 1;
+#ifdef _OPENMP
+	if(team != NULL)
+		nr_part = team->size();
+#endif
+	vector<double> nr_eval(nr_part,0.0);
+	auto add = [&](int t, int b, int e) {
+		vector<const Qfloat *> row_data(e-b);
+		vector<int> row_len(e-b);
+		vector<Qfloat> buf;
+		for(int k=b;k<e;k++)
+			row_len[k-b] = Q->peek_Q(k,&row_data[k-b]);
+		for(int c=0;c<n;c++)
+		{
+			int i = col[c];
+			double coef_i = coef[c];
+			const Qfloat *Q_i = col_data[c];
+			int k = b;
+			for(;k<min(e,col_len[c]);k++)
+				v[k] += coef_i * Q_i[k];
+			while(k < e)
+			{
+				if(i < row_len[k-b])
+				{
+					v[k] += coef_i * row_data[k-b][i];
+					k++;
+					continue;
+				}
+				int r = k+1;
+				while(r < e && i >= row_len[r-b])
+					r++;
+				if(buf.empty())
+					buf.resize(end);
+				Q->fill_Q(i,buf.data(),k,r);
+				nr_eval[t] += r-k;
+				for(;k<r;k++)
+					v[k] += coef_i * buf[k];
+			}
+		}
+	};
+	for_range(begin,end,SOLVER_FILL_GRAIN,add);
+
+	double sum = 0;
+	for(int t=0;t<nr_part;t++)
+		sum += nr_eval[t];
+	return sum;
+}
+
+// G_bar is only read when the gradient is reconstructed, so a variable
+// moving onto or off its upper bound is not charged a full column at the
+// time; here the columns of those whose bound changed since last call are
+// added once, and a variable that left the bound and came back costs none.
+// The sums come in another order than with a column per move, so G_bar,
+// and through the reconstructed gradient the model, can differ from that
+// in the last bits.
+void Solver::update_G_bar()
+{
+	vector<int> col;
+	vector<double> coef;
+	for(int i=0;i<l;i++)
+		if(bar_upper[i] != is_upper_bound(i))
+		{
+			col.push_back(i);
+			coef.push_back(bar_upper[i] ? -get_C(i) : get_C(i));
+			bar_upper[i] = is_upper_bound(i);
+		}
+	double nr_eval = add_columns(col,coef,G_bar,0,l);
+	if(shrinking == 2)
+		shrink_cost += (double)col.size()*l + nr_eval*Q->get_kernel_cost();
+}
+
+void Solver::reconstruct_gradient()
+{
+	// reconstruct inactive elements of G from G_bar and free variables
 
 	if(active_size == l) return;
 
-	int i,j;
-	int nr_free = 0;
+	update_G_bar();
 
-	for(j=active_size;j<l;j++)
-		G[j] = G_bar[j] + p[j];
+	auto inactive = [&](int, int b, int e) {
+		for(int k=b;k<e;k++)
+			G[k] = G_bar[k] + p[k];
+	};
+	for_range(active_size,l,SOLVER_GRAIN,inactive);
 
-	for(j=0;j<active_size;j++)
+	vector<int> free_set;
+	vector<double> free_alpha;
+	for(int j=0;j<active_size;j++)
 		if(is_free(j))
-			nr_free++;
+		{
+			free_set.push_back(j);
+			free_alpha.push_back(alpha[j]);
+		}
+	int nr_free = (int)free_set.size();
 
-	if(2*nr_free < active_size)
+	if(shrinking == 1 && 2*nr_free < active_size)
 		info("\nWARNING: using -h 0 may be faster\n");
 
-	if (nr_free*l > 2*active_size*(l-active_size))
+	double nr_eval = add_columns(free_set,free_alpha,G,active_size,l);
+	if(shrinking == 2)
+	{
+		shrink_cost += (double)(l-active_size)*(nr_free+1) + nr_eval*Q->get_kernel_cost();
+		adapt_shrinking();
+	}
+}
+
+// After each period of shrinking: shrink half as often if it cost more
+// than it saved, and not at all if it cost four times as much or even
+// every 16th round does not pay; twice as often again if it saved four
+// times its cost.
+void Solver::adapt_shrinking()
+{
+	if(shrink_cost > 4*shrink_saved)
+		shrink_period = 0;
+	else if(shrink_cost > shrink_saved)
+	{
+		shrink_period *= 2;
+		if(shrink_period > 16)
+			shrink_period = 0;
+	}
+	else if(shrink_saved > 4*shrink_cost && shrink_period > 1)
+		shrink_period /= 2;
+	shrink_saved = 0;
+	shrink_cost = 0;
+}
+
+// keep the k largest of the pairs offered in heap, a min-heap
+static inline void offer_top(vector<std::pair<double,int> >& heap, size_t k,
+			     double v, int t)
+{
+	std::greater<std::pair<double,int> > cmp;
+	if(heap.size() < k)
+	{
+		heap.push_back(std::make_pair(v,t));
+		std::push_heap(heap.begin(),heap.end(),cmp);
+	}
+	else if(k > 0 && v > heap.front().first)
+	{
+		std::pop_heap(heap.begin(),heap.end(),cmp);
+		heap.back() = std::make_pair(v,t);
+		std::push_heap(heap.begin(),heap.end(),cmp);
+	}
+}
+
+// Extend the pair (i,j) of select_working_set to a block of at most
+// working_set_size variables with the most violating ones left in I_up and
+// I_low, in equal parts, found in one pass
+void Solver::select_block(int i, int j)
+{
+	size_t need_up = (working_set_size-2)/2;
+	size_t need_low = working_set_size-2-need_up;
+	// a free variable may be among the best of both
+	ws_up_cand.clear();
+	ws_low_cand.clear();
+	for(int t=0;t<active_size;t++)
+	{
+		if(t == i || t == j)
+			continue;
+		if(up_mask[t] == 0)
+			offer_top(ws_up_cand,need_up,-yd[t]*G[t],t);
+		if(low_mask[t] == 0)
+			offer_top(ws_low_cand,need_up+need_low,yd[t]*G[t],t);
+	}
+
+	ws.clear();
+	ws.push_back(i);
+	ws.push_back(j);
+	for(size_t k=0;k<ws_up_cand.size();k++)
+	{
+		ws.push_back(ws_up_cand[k].second);
+		in_ws[ws_up_cand[k].second] = 1;
+	}
+	std::sort_heap(ws_low_cand.begin(),ws_low_cand.end(),
+		       std::greater<std::pair<double,int> >());
+	for(size_t k=0;k<ws_low_cand.size() && (int)ws.size()<working_set_size;k++)
+		if(!in_ws[ws_low_cand[k].second])
+			ws.push_back(ws_low_cand[k].second);
+	for(size_t k=0;k<ws_up_cand.size();k++)
+		in_ws[ws_up_cand[k].second] = 0;
+}
+
+void Solver::update_block_status(int a)
+{
+	update_alpha_status(ws[a]);
+	ws_up[a] = up_mask[ws[a]];
+	ws_low[a] = low_mask[ws[a]];
+}
+
+// the pair of the block to move next, chosen as select_working_set does
+// over the active set; return 1 if the block is optimal within eps
+int Solver::select_block_pair(double eps, int &out_a, int &out_b)
+{
+	int n = (int)ws.size();
+	double Gmax, Gmax2, obj_diff_min;
+	int a, b;
+	select_max<false>(ws_y.data(),ws_G.data(),ws_up.data(),NULL,0,n,Gmax,a);
+	if(a == -1)
+		return 1;
+	select_target ta = { Gmax, ws_QD[a], &ws_Q[a*n], 2.0*ws_y[a] };
+	select_min<false>(ws_y.data(),ws_G.data(),ws_low.data(),NULL,ws_QD.data(),ta,0,n,
+		Gmax2,obj_diff_min,b);
+	if(Gmax+Gmax2 < eps || b == -1)
+		return 1;
+	out_a = a;
+	out_b = b;
+	return 0;
+}
+
+// One iteration over a block of q > 2 variables: solve the sub-problem
+// with the other variables fixed by SMO steps on the q x q part of Q,
+// to a tolerance relative to the current violation, and then update G
+// with the changed columns in one pass. Return the columns fetched.
+int Solver::solve_block(int i, int j)
+{
+	select_block(i,j);
+	int n = (int)ws.size();
+	ws_col.resize(n);
+	ws_Q.resize(n*n);
+	ws_y.resize(n);
+	ws_G.resize(n);
+	ws_QD.resize(n);
+	ws_up.resize(n);
+	ws_low.resize(n);
+	ws_pos.resize(n);
+	ws_neg.resize(n);
+	vector<double> old_alpha(n);
+	for(int a=0;a<n;a++)
+	{
+		int v = ws[a];
+		const Qfloat *Q_v = column(v,active_size);
+		ws_col[a] = Q_v;
+		for(int b=0;b<n;b++)
+			ws_Q[a*n+b] = Q_v[ws[b]];
+		ws_y[a] = yd[v];
+		ws_G[a] = G[v];
+		ws_QD[a] = QD[v];
+		ws_up[a] = up_mask[v];
+		ws_low[a] = low_mask[v];
+		ws_pos[a] = pos_mask[v];
+		ws_neg[a] = neg_mask[v];
+		old_alpha[a] = alpha[v];
+	}
+
+	// the first step is that of (i,j), so the block never does less
+	// than SMO would
+	double eps_block = max(eps,0.1*violation);
+	for(int iter=0;iter<10*n;iter++)
 	{
-		for(i=active_size;i<l;i++)
+		int a = 0, b = 1;
+		if(iter > 0 && select_block_pair(eps_block,a,b) != 0)
+			break;
+		int u = ws[a], v = ws[b];
+		double old_u = alpha[u], old_v = alpha[v];
+		solve_pair(y[u],y[v],ws_G[a],ws_G[b],QD[u],QD[v],ws_Q[a*n+b],
+			   get_C(u),get_C(v),alpha[u],alpha[v]);
+		double delta_u = alpha[u]-old_u, delta_v = alpha[v]-old_v;
+		const Qfloat *Q_a = &ws_Q[a*n], *Q_b = &ws_Q[b*n];
+		for(int t=0;t<n;t++)
+			ws_G[t] += Q_a[t]*delta_u + Q_b[t]*delta_v;
+		update_block_status(a);
+		update_block_status(b);
+	}
+
+	// the changed columns; if some of those fetched above have left the
+	// cache since, take them one at a time
+	vector<int> changed;
+	vector<const Qfloat *> col;
+	vector<double> delta;
+	bool cached = true;
+	for(int a=0;a<n;a++)
+		if(alpha[ws[a]] != old_alpha[a])
 		{
-			const Qfloat *Q_i = Q->get_Q(i,active_size);
-			for(j=0;j<active_size;j++)
-				if(is_free(j))
-					G[i] += alpha[j] * Q_i[j];
+			const Qfloat *data;
+			if(Q->peek_Q(ws[a],&data) < active_size || data != ws_col[a])
+				cached = false;
+			changed.push_back(ws[a]);
+			col.push_back(ws_col[a]);
+			delta.push_back(alpha[ws[a]]-old_alpha[a]);
 		}
-	}
-	else
+	int nr_col = (int)col.size();
+	if(!cached)
 	{
-		for(i=0;i<active_size;i++)
-			if(is_free(i))
-			{
-				const Qfloat *Q_i = Q->get_Q(i,l);
-				double alpha_i = alpha[i];
-				for(j=active_size;j<l;j++)
-					G[j] += alpha_i * Q_i[j];
-			}
+		for(int c=0;c<nr_col;c++)
+		{
+			const Qfloat *Q_v = column(changed[c],active_size);
+			double delta_v = delta[c];
+			auto update = [&](int, int b, int e) {
+				update_gradient(G,Q_v,Q_v,delta_v,0,b,e);
+			};
+			for_range(0,active_size,SOLVER_GRAIN,update);
+		}
+		return n+nr_col;
 	}
+
+	// two columns at a time over pieces of G small enough to stay in cache
+	auto update = [&](int, int b, int e) {
+		for(int k=b;k<e;k+=1024)
+		{
+			int end = min(e,k+1024);
+			int c = 0;
+			for(;c+1<nr_col;c+=2)
+				update_gradient(G,col[c],col[c+1],delta[c],delta[c+1],k,end);
+			if(c < nr_col)
+				update_gradient(G,col[c],col[c],delta[c],0,k,end);
+		}
+	};
+	for_range(0,active_size,SOLVER_GRAIN,update);
+	return n;
 }
 
+#ifdef _OPENMP
+// seconds per variable of a gradient update pass, measured once per process
+static double measure_pass_cost()
+{
+	const int n = 1<<16, rounds = 8;
+	vector<double> G(n,0);
+	vector<Qfloat> Q_i(n,1), Q_j(n,-1);
+	double start = omp_get_wtime();
+	for(int r=0;r<rounds;r++)
+		update_gradient(G.data(),Q_i.data(),Q_j.data(),1e-3,1e-3,0,n);
+	double cost = (omp_get_wtime()-start)/rounds/n;
+	return G[n/2] == G[n/2] ? cost : 0;	// keep the passes
+}
+#endif
+
 void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		   double *alpha_, double Cp, double Cn, double eps,
-		   SolutionInfo* si, int shrinking)
+		   SolutionInfo* si, int shrinking, const svm_parameter& param,
+		   int *perm, checkpoint *ck)
 {
+#ifdef _OPENMP
+	// a problem large enough that one iteration outweighs waking the
+	// threads keeps a team for the whole solve; thread 0 runs the solver
+	// and hands the other threads their part of each pass. An iteration
+	// makes about three passes over the variables and, until the cache
+	// warms up, fills a column.
+	if(team == NULL)
+	{
+		static const double pass_cost = measure_pass_cost();
+		int nr_thread = parallel_threads(l*(3*pass_cost+Q.get_eval_time()));
+		if(nr_thread > 1)
+		{
+			SolverTeam solver_team;
+			std::exception_ptr error;
+#pragma omp parallel num_threads(nr_thread)
+			{
+#pragma omp single
+				solver_team.init(omp_get_num_threads());
+				if(omp_get_thread_num() == 0)
+				{
+					team = &solver_team;
+					try
+					{
+						Solve(l,Q,p_,y_,alpha_,Cp,Cn,eps,si,shrinking,param,perm,ck);
+					}
+					catch(...)
+					{
+						error = std::current_exception();
+					}
+					team = NULL;
+					solver_team.stop();
+				}
+				else
+					solver_team.work(omp_get_thread_num());
+			}
+			if(error)
+				std::rethrow_exception(error);
+			return;
+		}
+	}
+	part.resize(team != NULL ? team->size() : 1);
+#else
+	part.resize(1);
+#endif
+	double start_time = wall_time();
 	this->l = l;
 	this->Q = &Q;
 	QD=Q.get_QD();
 	p = clone<const double, double>(p_, l);
 	y = clone<const schar, schar>(y_, l);
 	alpha = clone<const double, double>(alpha_, l);
+	if(perm)
+		for(int i=0;i<l;i++)
+		{
+			p[i] = p_[perm[i]];
+			y[i] = y_[perm[i]];
+			alpha[i] = alpha_[perm[i]];
+		}
 	this->Cp = Cp;
 	this->Cn = Cn;
 	this->eps = eps;
+	this->ck = ck;
+	this->shrinking = shrinking;
+	this->working_set_size = min(param.working_set_size,l);
+	if(this->working_set_size > 2)
+		in_ws.assign(l,0);
+	this->cache_slack = param.cache_slack;
+	nr_cache_pick = 0;
 	unshrink = false;
+	shrink_saved = 0;
+	shrink_cost = 0;
+	shrink_period = 1;
+	shrink_round = 0;
+	shrink_miss_cost = (1-Q.get_cache_hit_rate())*Q.get_kernel_cost();
+	violation = INF;
 
 	// initialize alpha_status
 	{
+		yd.resize(l);
+		up_mask.resize(l);
+		low_mask.resize(l);
+		pos_mask.resize(l);
+		neg_mask.resize(l);
+		for(int i=0;i<l;i++)
+		{
+			yd[i] = y[i];
+			pos_mask[i] = y[i] > 0 ? 0 : -INF;
+			neg_mask[i] = y[i] > 0 ? -INF : 0;
+		}
 		alpha_status = new char[l];
 		for(int i=0;i<l;i++)
 			update_alpha_status(i);
@@ -542,14 +2422,19 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 	{
 		active_set = new int[l];
 		for(int i=0;i<l;i++)
-			active_set[i] = i;
+			active_set[i] = perm ? perm[i] : i;
 		active_size = l;
 	}
 
-	// initialize gradient
+	// initialize gradient, or take it with alpha from the checkpoint
+	G = new double[l];
+	G_bar = new double[l];
+	bar_upper.resize(l);
+	const solver_state *saved = ck != NULL ? checkpoint_state(ck,l) : resume;
+	if(saved != NULL)
+		restore_state(saved);
+	else
 	{
-		G = new double[l];
-		G_bar = new double[l];
 		int i;
 		for(i=0;i<l;i++)
 		{
@@ -559,22 +2444,36 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		for(i=0;i<l;i++)
 			if(!is_lower_bound(i))
 			{
-				const Qfloat *Q_i = Q.get_Q(i,l);
+				const Qfloat *Q_i = column(i,l);
 				double alpha_i = alpha[i];
-				int j;
-				for(j=0;j<l;j++)
-					G[j] += alpha_i*Q_i[j];
-				if(is_upper_bound(i))
-					for(j=0;j<l;j++)
-						G_bar[j] += get_C(i) * Q_i[j];
+				double C_i = get_C(i);
+				bool upper = is_upper_bound(i);
+				auto add = [&](int, int b, int e) {
+					int j;
+					for(j=b;j<e;j++)
+						G[j] += alpha_i*Q_i[j];
+					if(upper)
+						for(j=b;j<e;j++)
+							G_bar[j] += C_i * Q_i[j];
+				};
+				for_range(0,l,SOLVER_GRAIN,add);
 			}
 	}
+	for(int i=0;i<l;i++)
+		bar_upper[i] = is_upper_bound(i);
 
 	// optimization step
 
-	int iter = 0;
-	int max_iter = max(10000000, l>INT_MAX/100 ? INT_MAX : 100*l);
-	int counter = min(l,1000)+1;
+	int iter = saved != NULL ? saved->iter : 0;
+	int max_iter = param.max_iter;
+	if(max_iter <= 0)
+		max_iter = max(10000000, l>INT_MAX/100 ? INT_MAX : 100*l);
+	double max_time = param.max_time;
+	int counter = saved != NULL ? saved->counter : min(l,1000)+1;
+	// look at the clock about every 10^5 operations
+	int time_check = max(1,min(1000,100000/l));
+	int progress_interval = min(l,1000);
+	const char *stop = NULL;	// why the optimization stopped early
 
 	while(iter < max_iter)
 	{
@@ -583,8 +2482,19 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		if(--counter == 0)
 		{
 			counter = min(l,1000);
-			if(shrinking) do_shrinking();
+			if(shrinking == 2)
+				shrink_miss_cost = (1-Q.get_cache_hit_rate())*Q.get_kernel_cost();
+			if(shrinking == 1)
+				do_shrinking();
+			else if(shrinking == 2 && shrink_period > 0 && ++shrink_round >= shrink_period)
+			{
+				shrink_round = 0;
+				shrink_cost += 4.0*active_size;
+				do_shrinking();
+			}
 			info(".");
+			if(ck != NULL && checkpoint_due(ck))
+				save_state(iter,counter+1,false);
 		}
 
 		int i,j;
@@ -601,12 +2511,42 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 				counter = 1;	// do shrinking next iteration
 		}
 
+		if(max_time > 0 && iter%time_check == 0 && wall_time()-start_time > max_time)
+		{
+			stop = "reaching max training time";
+			break;
+		}
+		if(iter%time_check == 0 && training_cancelled())
+		{
+			stop = "training cancelled";
+			break;
+		}
+		if(svm_progress_function != NULL && iter%progress_interval == 0 &&
+		   report_progress(iter,start_time,NAN,NAN,0))
+		{
+			stop = "training cancelled";
+			break;
+		}
+
 		++iter;
+		if(working_set_size > 2)
+		{
+			int n = solve_block(i,j);
+			if(shrinking == 2)
+				shrink_saved += (l-active_size)*(1+n+n*shrink_miss_cost);
+			continue;
+		}
+		if(shrinking == 2)
+		{
+			// the inactive part of the selection, the gradient update
+			// and of Q_i and Q_j when they miss the cache
+			shrink_saved += (l-active_size)*(3+2*shrink_miss_cost);
+		}
 
 		// update alpha[i] and alpha[j], handle bounds carefully
 
-		const Qfloat *Q_i = Q.get_Q(i,active_size);
-		const Qfloat *Q_j = Q.get_Q(j,active_size);
+		const Qfloat *Q_i = column(i,active_size);
+		const Qfloat *Q_j = column(j,active_size);
 
 		double C_i = get_C(i);
 		double C_j = get_C(j);
@@ -614,137 +2554,31 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		double old_alpha_i = alpha[i];
 		double old_alpha_j = alpha[j];
 
-		if(y[i]!=y[j])
-		{
-			double quad_coef = QD[i]+QD[j]+2*Q_i[j];
-			if (quad_coef <= 0)
-				quad_coef = TAU;
-			double delta = (-G[i]-G[j])/quad_coef;
-			double diff = alpha[i] - alpha[j];
-			alpha[i] += delta;
-			alpha[j] += delta;
-
-			if(diff > 0)
-			{
-				if(alpha[j] < 0)
-				{
-					alpha[j] = 0;
-					alpha[i] = diff;
-				}
-			}
-			else
-			{
-				if(alpha[i] < 0)
-				{
-					alpha[i] = 0;
-					alpha[j] = -diff;
-				}
-			}
-			if(diff > C_i - C_j)
-			{
-				if(alpha[i] > C_i)
-				{
-					alpha[i] = C_i;
-					alpha[j] = C_i - diff;
-				}
-			}
-			else
-			{
-				if(alpha[j] > C_j)
-				{
-					alpha[j] = C_j;
-					alpha[i] = C_j + diff;
-				}
-			}
-		}
-		else
-		{
-			double quad_coef = QD[i]+QD[j]-2*Q_i[j];
-			if (quad_coef <= 0)
-				quad_coef = TAU;
-			double delta = (G[i]-G[j])/quad_coef;
-			double sum = alpha[i] + alpha[j];
-			alpha[i] -= delta;
-			alpha[j] += delta;
-
-			if(sum > C_i)
-			{
-				if(alpha[i] > C_i)
-				{
-					alpha[i] = C_i;
-					alpha[j] = sum - C_i;
-				}
-			}
-			else
-			{
-				if(alpha[j] < 0)
-				{
-					alpha[j] = 0;
-					alpha[i] = sum;
-				}
-			}
-			if(sum > C_j)
-			{
-				if(alpha[j] > C_j)
-				{
-					alpha[j] = C_j;
-					alpha[i] = sum - C_j;
-				}
-			}
-			else
-			{
-				if(alpha[i] < 0)
-				{
-					alpha[i] = 0;
-					alpha[j] = sum;
-				}
-			}
-		}
+		solve_pair(y[i],y[j],G[i],G[j],QD[i],QD[j],Q_i[j],C_i,C_j,alpha[i],alpha[j]);
 
 		// update G
 
 		double delta_alpha_i = alpha[i] - old_alpha_i;
 		double delta_alpha_j = alpha[j] - old_alpha_j;
 
-		for(int k=0;k<active_size;k++)
-		{
-			G[k] += Q_i[k]*delta_alpha_i + Q_j[k]*delta_alpha_j;
-		}
-
-		// update alpha_status and G_bar
+		auto update = [&](int, int b, int e) {
+			update_gradient(G,Q_i,Q_j,delta_alpha_i,delta_alpha_j,b,e);
+		};
+		for_range(0,active_size,SOLVER_GRAIN,update);
 
-		{
-			bool ui = is_upper_bound(i);
-			bool uj = is_upper_bound(j);
-			update_alpha_status(i);
-			update_alpha_status(j);
-			int k;
-			if(ui != is_upper_bound(i))
-			{
-				Q_i = Q.get_Q(i,l);
-				if(ui)
-					for(k=0;k<l;k++)
-						G_bar[k] -= C_i * Q_i[k];
-				else
-					for(k=0;k<l;k++)
-						G_bar[k] += C_i * Q_i[k];
-			}
+		// update alpha_status; G_bar follows in update_G_bar
 
-			if(uj != is_upper_bound(j))
-			{
-				Q_j = Q.get_Q(j,l);
-				if(uj)
-					for(k=0;k<l;k++)
-						G_bar[k] -= C_j * Q_j[k];
-				else
-					for(k=0;k<l;k++)
-						G_bar[k] += C_j * Q_j[k];
-			}
-		}
+		update_alpha_status(i);
+		update_alpha_status(j);
 	}
 
-	if(iter >= max_iter)
+	if(iter >= max_iter && stop == NULL)
+		stop = "reaching max number of iterations";
+	if(stop != NULL)
 	{
+		// a break came after --counter, the end of the loop before it
+		if(ck != NULL)
+			save_state(iter,iter < max_iter ? counter+1 : counter,true);
 		if(active_size < l)
 		{
 			// reconstruct the whole gradient to calculate objective value
@@ -752,12 +2586,15 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 			active_size = l;
 			info("*");
 		}
-		fprintf(stderr,"\nWARNING: reaching max number of iterations\n");
 	}
 
 	// calculate rho
 
+	si->r = 0;
 	si->rho = calculate_rho();
+	si->gap = calculate_gap(si->rho,si->r);
+	if(stop != NULL)
+		fprintf(stderr,"\nWARNING: %s, duality gap = %g\n",stop,si->gap);
 
 	// calculate objective value
 	{
@@ -773,6 +2610,18 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 	{
 		for(int i=0;i<l;i++)
 			alpha_[active_set[i]] = alpha[i];
+		if(perm)
+			for(int i=0;i<l;i++)
+				perm[i] = active_set[i];
+	}
+	if(G_out != NULL)
+	{
+		update_G_bar();
+		for(int i=0;i<l;i++)
+		{
+			G_out[active_set[i]] = G[i];
+			G_bar_out[active_set[i]] = G_bar[i];
+		}
 	}
 
 	// juggle everything back
@@ -786,7 +2635,12 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 	si->upper_bound_p = Cp;
 	si->upper_bound_n = Cn;
 
+	if(svm_progress_function != NULL && !training_cancelled())
+		report_progress(iter,start_time,si->obj,si->gap,stop != NULL);
 	info("\noptimization finished, #iter = %d\n",iter);
+	solver_iterations += iter;
+	if(cache_slack > 0)
+		info("cached j taken in %d of %d iterations\n",nr_cache_pick,iter);
 
 	delete[] alpha_status;
 	delete[] active_set;
@@ -794,6 +2648,59 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 	delete[] G_bar;
 }
 
+void Solver::save_state(int iter, int counter, bool stopped)
+{
+	solver_state s;
+	s.l = l;
+	s.iter = iter;
+	s.counter = counter;
+	s.active_size = active_size;
+	s.unshrink = unshrink;
+	s.shrink_period = shrink_period;
+	s.shrink_round = shrink_round;
+	s.shrink_saved = shrink_saved;
+	s.shrink_cost = shrink_cost;
+	s.active_set = active_set;
+	s.alpha = alpha.data();
+	s.G = G;
+	update_G_bar();
+	s.G_bar = G_bar;
+	checkpoint_save_state(ck,&s,stopped);
+}
+
+// continue from the saved state s of this optimization: bring Q and the
+// variables to its order by swaps, then take alpha and the gradient
+void Solver::restore_state(const solver_state *s)
+{
+	vector<int> pos(l);	// pos[k]: row of variable k
+	int i;
+	for(i=0;i<l;i++)
+		pos[active_set[i]] = i;
+	for(i=0;i<l;i++)
+	{
+		int k = pos[s->active_set[i]];
+		if(k != i)
+		{
+			pos[active_set[i]] = k;
+			pos[active_set[k]] = i;
+			swap_index(i,k);
+		}
+	}
+	for(i=0;i<l;i++)
+	{
+		alpha[i] = s->alpha[i];
+		G[i] = s->G[i];
+		G_bar[i] = s->G_bar[i];
+		update_alpha_status(i);
+	}
+	active_size = s->active_size;
+	unshrink = s->unshrink != 0;
+	shrink_period = s->shrink_period;
+	shrink_round = s->shrink_round;
+	shrink_saved = s->shrink_saved;
+	shrink_cost = s->shrink_cost;
+}
+
 // return 1 if already optimal, return 0 otherwise
 int Solver::select_working_set(int &out_i, int &out_j)
 {
@@ -804,96 +2711,92 @@ int Solver::select_working_set(int &out_i, int &out_j)
 	//    -y_j*grad(f)_j < -y_i*grad(f)_i, j in I_low(\alpha)
 
 	double Gmax = -INF;
-	double Gmax2 = -INF;
-	int Gmax_idx = -1;
+	int i = -1;
+	auto find_max = [&](int t, int b, int e) {
+		select_max<false>(yd.data(),G,up_mask.data(),NULL,b,e,part[t].v[0],part[t].idx[0]);
+	};
+	int nr = for_range(0,active_size,SOLVER_GRAIN,find_max);
+	for(int t=0;t<nr;t++)
+		select_better_max(part[t].v[0],part[t].idx[0],Gmax,i);
+	if(i == -1)
+	{
+		violation = -INF;
+		return 1;
+	}
+
+	const Qfloat *Q_i = column(i,active_size);
+	select_target ti = { Gmax, QD[i], Q_i, 2.0*y[i] };
+	auto find_min = [&](int t, int b, int e) {
+		select_min<false>(yd.data(),G,low_mask.data(),NULL,QD,ti,b,e,
+			part[t].v[0],part[t].obj,part[t].idx[0]);
+	};
+	nr = for_range(0,active_size,SOLVER_GRAIN,find_min);
+	double Gmax2 = -INF, obj_diff_min = INF;
 	int Gmin_idx = -1;
-	double obj_diff_min = INF;
+	for(int t=0;t<nr;t++)
+	{
+		Gmax2 = max(Gmax2,part[t].v[0]);
+		if(part[t].idx[0] != -1)
+			select_better_min(part[t].obj,part[t].idx[0],obj_diff_min,Gmin_idx);
+	}
 
-	for(int t=0;t<active_size;t++)
-		if(y[t]==+1)
-		{
-			if(!is_upper_bound(t))
-				if(-G[t] >= Gmax)
-				{
-					Gmax = -G[t];
-					Gmax_idx = t;
-				}
-		}
-		else
-		{
-			if(!is_lower_bound(t))
-				if(G[t] >= Gmax)
-				{
-					Gmax = G[t];
-					Gmax_idx = t;
-				}
-		}
-
-	int i = Gmax_idx;
-	const Qfloat *Q_i = NULL;
-	if(i != -1) // NULL Q_i not accessed: Gmax=-INF if i=-1
-		Q_i = Q->get_Q(i,active_size);
+	violation = Gmax+Gmax2;
+	if(Gmax+Gmax2 < eps || Gmin_idx == -1)
+		return 1;
 
-	for(int j=0;j<active_size;j++)
+	if(cache_slack > 0 && !column_cached(Gmin_idx))
 	{
-		if(y[j]==+1)
-		{
-			if (!is_lower_bound(j))
-			{
-				double grad_diff=Gmax+G[j];
-				if (G[j] >= Gmax2)
-					Gmax2 = G[j];
-				if (grad_diff > 0)
-				{
-					double obj_diff;
-					double quad_coef = QD[i]+QD[j]-2.0*y[i]*Q_i[j];
-					if (quad_coef > 0)
-						obj_diff = -(grad_diff*grad_diff)/quad_coef;
-					else
-						obj_diff = -(grad_diff*grad_diff)/TAU;
-
-					if (obj_diff <= obj_diff_min)
-					{
-						Gmin_idx=j;
-						obj_diff_min = obj_diff;
-					}
-				}
-			}
-		}
-		else
+		double obj = INF;
+		int k = -1;
+		select_cached(ti,NULL,(1-cache_slack)*obj_diff_min,obj,k);
+		if(k != -1)
 		{
-			if (!is_upper_bound(j))
-			{
-				double grad_diff= Gmax-G[j];
-				if (-G[j] >= Gmax2)
-					Gmax2 = -G[j];
-				if (grad_diff > 0)
-				{
-					double obj_diff;
-					double quad_coef = QD[i]+QD[j]+2.0*y[i]*Q_i[j];
-					if (quad_coef > 0)
-						obj_diff = -(grad_diff*grad_diff)/quad_coef;
-					else
-						obj_diff = -(grad_diff*grad_diff)/TAU;
-
-					if (obj_diff <= obj_diff_min)
-					{
-						Gmin_idx=j;
-						obj_diff_min = obj_diff;
-					}
-				}
-			}
+			Gmin_idx = k;
+			nr_cache_pick++;
 		}
 	}
 
-	if(Gmax+Gmax2 < eps || Gmin_idx == -1)
-		return 1;
-
-	out_i = Gmax_idx;
+	out_i = i;
 	out_j = Gmin_idx;
 	return 0;
 }
 
+// Over j in I_low (and the class of cls_mask, if not NULL) with a cached
+// column and obj_diff <= bound: update obj_diff_min and Gmin_idx if one
+// decreases the objective more, as select_min
+void Solver::select_cached(const select_target& ti, const double *cls_mask,
+			   double bound, double& obj_diff_min, int& Gmin_idx)
+{
+	auto find = [&](int t, int b, int e) {
+		double best = INF;
+		int best_idx = -1;
+		for(int j=b;j<e;j++)
+		{
+			double v = yd[j]*G[j] + low_mask[j];
+			if(cls_mask)
+				v += cls_mask[j];
+			double grad_diff = ti.Gmax+v;
+			if(grad_diff <= 0)
+				continue;
+			double quad_coef = ti.QD_i+QD[j]-ti.coef*yd[j]*ti.Q_i[j];
+			if(quad_coef <= 0)
+				quad_coef = TAU;
+			double obj_diff = -(grad_diff*grad_diff)/quad_coef;
+			if(obj_diff <= bound && obj_diff <= best && column_cached(j))
+			{
+				best = obj_diff;
+				best_idx = j;
+			}
+		}
+		part[t].obj = best;
+		part[t].idx[0] = best_idx;
+	};
+	int nr = for_range(0,active_size,SOLVER_GRAIN,find);
+	for(int t=0;t<nr;t++)
+		if(part[t].idx[0] != -1)
+			select_better_min(part[t].obj,part[t].idx[0],obj_diff_min,Gmin_idx);
+}
+
 bool Solver::be_shrunk(int i, double Gmax1, double Gmax2)
 {
 	if(is_upper_bound(i))
@@ -921,34 +2824,45 @@ void Solver::do_shrinking()
 	double Gmax2 = -INF;		// max { y_i * grad(f)_i | i in I_low(\alpha) }
 
 	// find maximal violating pair first
-	for(i=0;i<active_size;i++)
-	{
-		if(y[i]==+1)
-		{
-			if(!is_upper_bound(i))
-			{
-				if(-G[i] >= Gmax1)
-					Gmax1 = -G[i];
-			}
-			if(!is_lower_bound(i))
-			{
-				if(G[i] >= Gmax2)
-					Gmax2 = G[i];
-			}
-		}
-		else
+	auto scan = [&](int t, int b, int e) {
+		double g1 = -INF, g2 = -INF;
+		for(int k=b;k<e;k++)
 		{
-			if(!is_upper_bound(i))
+			if(y[k]==+1)
 			{
-				if(-G[i] >= Gmax2)
-					Gmax2 = -G[i];
+				if(!is_upper_bound(k))
+				{
+					if(-G[k] >= g1)
+						g1 = -G[k];
+				}
+				if(!is_lower_bound(k))
+				{
+					if(G[k] >= g2)
+						g2 = G[k];
+				}
 			}
-			if(!is_lower_bound(i))
+			else
 			{
-				if(G[i] >= Gmax1)
-					Gmax1 = G[i];
+				if(!is_upper_bound(k))
+				{
+					if(-G[k] >= g2)
+						g2 = -G[k];
+				}
+				if(!is_lower_bound(k))
+				{
+					if(G[k] >= g1)
+						g1 = G[k];
+				}
 			}
 		}
+		part[t].v[0] = g1;
+		part[t].v[1] = g2;
+	};
+	int nr = for_range(0,active_size,SOLVER_GRAIN,scan);
+	for(int t=0;t<nr;t++)
+	{
+		Gmax1 = max(Gmax1,part[t].v[0]);
+		Gmax2 = max(Gmax2,part[t].v[1]);
 	}
 
 	if(unshrink == false && Gmax1 + Gmax2 <= eps*10)
@@ -1013,6 +2927,49 @@ double Solver::calculate_rho()
 	return r;
 }
 
+// pass the state of the optimization to svm_progress_function, with obj
+// computed here if NAN; gap and stopped are those of the final report.
+// Return true if training is to stop
+bool Solver::report_progress(int iter, double start_time, double obj, double gap, int stopped)
+{
+	svm_progress progress;
+	progress.l = l;
+	progress.iter = iter;
+	progress.violation = violation;
+	progress.active_size = active_size;
+	if(isnan(obj))
+	{
+		// exact once the gradient is whole; inactive G[i] may be stale before
+		obj = 0;
+		for(int i=0;i<l;i++)
+			obj += alpha[i] * (G[i] + p[i]);
+		obj /= 2;
+	}
+	progress.obj = obj;
+	progress.cache_hit_rate = Q->get_cache_hit_rate();
+	progress.elapsed = wall_time()-start_time;
+	progress.gap = gap;
+	progress.stopped = stopped;
+	return progress_report(&progress);
+}
+
+// Gap between the dual objective at alpha and the primal one at the
+// multipliers rho (and r in Solver_NU) of the equality constraints:
+//
+//	sum_i alpha_i (G_i - s_i) + C_i max(0, s_i - G_i),  s_i = r + y_i rho
+//
+// It is zero exactly when alpha is optimal. Needs the whole gradient.
+double Solver::calculate_gap(double rho, double r)
+{
+	double gap = 0;
+	for(int i=0;i<l;i++)
+	{
+		double d = G[i] - (r + y[i]*rho);
+		gap += alpha[i]*d + get_C(i)*max(0.0,-d);
+	}
+	return gap;
+}
+
 //
 // Solver for nu-svm classification and regression
 //
@@ -1024,14 +2981,16 @@ public:
 	Solver_NU() {}
 	void Solve(int l, const QMatrix& Q, const double *p, const schar *y,
 		   double *alpha, double Cp, double Cn, double eps,
-		   SolutionInfo* si, int shrinking)
+		   SolutionInfo* si, int shrinking, const svm_parameter& param,
+		   int *perm = NULL, checkpoint *ck = NULL)
 	{
 		this->si = si;
-		Solver::Solve(l,Q,p,y,alpha,Cp,Cn,eps,si,shrinking);
+		Solver::Solve(l,Q,p,y,alpha,Cp,Cn,eps,si,shrinking,param,perm,ck);
 	}
 private:
 	SolutionInfo *si;
 	int select_working_set(int &i, int &j);
+	int select_block_pair(double eps, int &a, int &b);
 	double calculate_rho();
 	bool be_shrunk(int i, double Gmax1, double Gmax2, double Gmax3, double Gmax4);
 	void do_shrinking();
@@ -1046,110 +3005,119 @@ int Solver_NU::select_working_set(int &out_i, int &out_j)
 	//    (if quadratic coefficeint <= 0, replace it with tau)
 	//    -y_j*grad(f)_j < -y_i*grad(f)_i, j in I_low(\alpha)
 
-	double Gmaxp = -INF;
-	double Gmaxp2 = -INF;
-	int Gmaxp_idx = -1;
-
-	double Gmaxn = -INF;
-	double Gmaxn2 = -INF;
-	int Gmaxn_idx = -1;
+	double Gmaxp = -INF, Gmaxn = -INF;
+	int ip = -1, in = -1;
+	auto find_max = [&](int t, int b, int e) {
+		select_max<true>(yd.data(),G,up_mask.data(),pos_mask.data(),b,e,part[t].v[0],part[t].idx[0]);
+		select_max<true>(yd.data(),G,up_mask.data(),neg_mask.data(),b,e,part[t].v[1],part[t].idx[1]);
+	};
+	int nr = for_range(0,active_size,SOLVER_GRAIN,find_max);
+	for(int t=0;t<nr;t++)
+	{
+		select_better_max(part[t].v[0],part[t].idx[0],Gmaxp,ip);
+		select_better_max(part[t].v[1],part[t].idx[1],Gmaxn,in);
+	}
 
-	int Gmin_idx = -1;
+	// j is paired with the i of its own class
+	double Gmaxp2 = -INF, Gmaxn2 = -INF;
 	double obj_diff_min = INF;
-
-	for(int t=0;t<active_size;t++)
-		if(y[t]==+1)
+	int Gmin_idx = -1;
+	if(ip != -1)
+	{
+		select_target tp = { Gmaxp, QD[ip], column(ip,active_size), 2 };
+		auto find_min = [&](int t, int b, int e) {
+			select_min<true>(yd.data(),G,low_mask.data(),pos_mask.data(),QD,tp,b,e,
+				part[t].v[0],part[t].obj,part[t].idx[0]);
+		};
+		nr = for_range(0,active_size,SOLVER_GRAIN,find_min);
+		for(int t=0;t<nr;t++)
 		{
-			if(!is_upper_bound(t))
-				if(-G[t] >= Gmaxp)
-				{
-					Gmaxp = -G[t];
-					Gmaxp_idx = t;
-				}
+			Gmaxp2 = max(Gmaxp2,part[t].v[0]);
+			if(part[t].idx[0] != -1)
+				select_better_min(part[t].obj,part[t].idx[0],obj_diff_min,Gmin_idx);
 		}
-		else
+	}
+	if(in != -1)
+	{
+		select_target tn = { Gmaxn, QD[in], column(in,active_size), -2 };
+		auto find_min = [&](int t, int b, int e) {
+			select_min<true>(yd.data(),G,low_mask.data(),neg_mask.data(),QD,tn,b,e,
+				part[t].v[0],part[t].obj,part[t].idx[0]);
+		};
+		nr = for_range(0,active_size,SOLVER_GRAIN,find_min);
+		for(int t=0;t<nr;t++)
 		{
-			if(!is_lower_bound(t))
-				if(G[t] >= Gmaxn)
-				{
-					Gmaxn = G[t];
-					Gmaxn_idx = t;
-				}
+			Gmaxn2 = max(Gmaxn2,part[t].v[0]);
+			if(part[t].idx[0] != -1)
+				select_better_min(part[t].obj,part[t].idx[0],obj_diff_min,Gmin_idx);
 		}
+	}
 
-	int ip = Gmaxp_idx;
-	int in = Gmaxn_idx;
-	const Qfloat *Q_ip = NULL;
-	const Qfloat *Q_in = NULL;
-	if(ip != -1) // NULL Q_ip not accessed: Gmaxp=-INF if ip=-1
-		Q_ip = Q->get_Q(ip,active_size);
-	if(in != -1)
-		Q_in = Q->get_Q(in,active_size);
+	violation = max(Gmaxp+Gmaxp2,Gmaxn+Gmaxn2);
+	if(violation < eps || Gmin_idx == -1)
+		return 1;
 
-	for(int j=0;j<active_size;j++)
+	if(cache_slack > 0 && !column_cached(Gmin_idx))
 	{
-		if(y[j]==+1)
+		double bound = (1-cache_slack)*obj_diff_min, obj = INF;
+		int k = -1;
+		if(ip != -1)
 		{
-			if (!is_lower_bound(j))
-			{
-				double grad_diff=Gmaxp+G[j];
-				if (G[j] >= Gmaxp2)
-					Gmaxp2 = G[j];
-				if (grad_diff > 0)
-				{
-					double obj_diff;
-					double quad_coef = QD[ip]+QD[j]-2*Q_ip[j];
-					if (quad_coef > 0)
-						obj_diff = -(grad_diff*grad_diff)/quad_coef;
-					else
-						obj_diff = -(grad_diff*grad_diff)/TAU;
-
-					if (obj_diff <= obj_diff_min)
-					{
-						Gmin_idx=j;
-						obj_diff_min = obj_diff;
-					}
-				}
-			}
+			select_target tp = { Gmaxp, QD[ip], column(ip,active_size), 2 };
+			select_cached(tp,pos_mask.data(),bound,obj,k);
 		}
-		else
+		if(in != -1)
 		{
-			if (!is_upper_bound(j))
-			{
-				double grad_diff=Gmaxn-G[j];
-				if (-G[j] >= Gmaxn2)
-					Gmaxn2 = -G[j];
-				if (grad_diff > 0)
-				{
-					double obj_diff;
-					double quad_coef = QD[in]+QD[j]-2*Q_in[j];
-					if (quad_coef > 0)
-						obj_diff = -(grad_diff*grad_diff)/quad_coef;
-					else
-						obj_diff = -(grad_diff*grad_diff)/TAU;
-
-					if (obj_diff <= obj_diff_min)
-					{
-						Gmin_idx=j;
-						obj_diff_min = obj_diff;
-					}
-				}
-			}
+			select_target tn = { Gmaxn, QD[in], column(in,active_size), -2 };
+			select_cached(tn,neg_mask.data(),bound,obj,k);
+		}
+		if(k != -1)
+		{
+			Gmin_idx = k;
+			nr_cache_pick++;
 		}
 	}
 
-	if(max(Gmaxp+Gmaxp2,Gmaxn+Gmaxn2) < eps || Gmin_idx == -1)
-		return 1;
-
 	if (y[Gmin_idx] == +1)
-		out_i = Gmaxp_idx;
+		out_i = ip;
 	else
-		out_i = Gmaxn_idx;
+		out_i = in;
 	out_j = Gmin_idx;
 
 	return 0;
 }
 
+// as select_working_set: a and b of the same class
+int Solver_NU::select_block_pair(double eps, int &out_a, int &out_b)
+{
+	int n = (int)ws.size();
+	double Gmaxp, Gmaxn, Gmaxp2 = -INF, Gmaxn2 = -INF, obj_diff_min = INF, obj;
+	int ap, an, b = -1, k;
+	select_max<true>(ws_y.data(),ws_G.data(),ws_up.data(),ws_pos.data(),0,n,Gmaxp,ap);
+	select_max<true>(ws_y.data(),ws_G.data(),ws_up.data(),ws_neg.data(),0,n,Gmaxn,an);
+	if(ap != -1)
+	{
+		select_target tp = { Gmaxp, ws_QD[ap], &ws_Q[ap*n], 2 };
+		select_min<true>(ws_y.data(),ws_G.data(),ws_low.data(),ws_pos.data(),ws_QD.data(),tp,0,n,
+			Gmaxp2,obj,k);
+		if(k != -1)
+			select_better_min(obj,k,obj_diff_min,b);
+	}
+	if(an != -1)
+	{
+		select_target tn = { Gmaxn, ws_QD[an], &ws_Q[an*n], -2 };
+		select_min<true>(ws_y.data(),ws_G.data(),ws_low.data(),ws_neg.data(),ws_QD.data(),tn,0,n,
+			Gmaxn2,obj,k);
+		if(k != -1)
+			select_better_min(obj,k,obj_diff_min,b);
+	}
+	if(max(Gmaxp+Gmaxp2,Gmaxn+Gmaxn2) < eps || b == -1)
+		return 1;
+	out_a = ws_y[b] > 0 ? ap : an;
+	out_b = b;
+	return 0;
+}
+
 bool Solver_NU::be_shrunk(int i, double Gmax1, double Gmax2, double Gmax3, double Gmax4)
 {
 	if(is_upper_bound(i))
@@ -1179,24 +3147,39 @@ void Solver_NU::do_shrinking()
 
 	// find maximal violating pair first
 	int i;
-	for(i=0;i<active_size;i++)
-	{
-		if(!is_upper_bound(i))
+	auto scan = [&](int t, int b, int e) {
+		double g1 = -INF, g2 = -INF, g3 = -INF, g4 = -INF;
+		for(int k=b;k<e;k++)
 		{
-			if(y[i]==+1)
+			if(!is_upper_bound(k))
 			{
-				if(-G[i] > Gmax1) Gmax1 = -G[i];
+				if(y[k]==+1)
+				{
+					if(-G[k] > g1) g1 = -G[k];
+				}
+				else	if(-G[k] > g4) g4 = -G[k];
 			}
-			else	if(-G[i] > Gmax4) Gmax4 = -G[i];
-		}
-		if(!is_lower_bound(i))
-		{
-			if(y[i]==+1)
+			if(!is_lower_bound(k))
 			{
-				if(G[i] > Gmax2) Gmax2 = G[i];
+				if(y[k]==+1)
+				{
+					if(G[k] > g2) g2 = G[k];
+				}
+				else	if(G[k] > g3) g3 = G[k];
 			}
-			else	if(G[i] > Gmax3) Gmax3 = G[i];
 		}
+		part[t].v[0] = g1;
+		part[t].v[1] = g2;
+		part[t].v[2] = g3;
+		part[t].v[3] = g4;
+	};
+	int nr = for_range(0,active_size,SOLVER_GRAIN,scan);
+	for(int t=0;t<nr;t++)
+	{
+		Gmax1 = max(Gmax1,part[t].v[0]);
+		Gmax2 = max(Gmax2,part[t].v[1]);
+		Gmax3 = max(Gmax3,part[t].v[2]);
+		Gmax4 = max(Gmax4,part[t].v[3]);
 	}
 
 	if(unshrink == false && max(Gmax1+Gmax2,Gmax3+Gmax4) <= eps*10)
@@ -1294,20 +3277,62 @@ public:
 		int start, j;
 		if((start = cache->get_data(i,&data,len)) < len)
 		{
+			// out of core, each thread takes a run of stored rows
+			vector<int> pos;
+			if(streaming())
+				stored_order(start,len,pos);
 #ifdef _OPENMP
-#pragma omp parallel for private(j) schedule(guided)
+			int nr_thread = fill_threads(len-start);
+#pragma omp parallel for private(j) num_threads(nr_thread) if(nr_thread > 1) schedule(guided)
 #endif
 			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(y[i]*y[j]*(this->*kernel_function)(i,j));
+			{
+				int c = pos.empty() ? j : pos[j-start];
+				data[c] = (Qfloat)(y[i]*y[c]*(this->*kernel_function)(i,c));
+			}
 		}
 		return data;
 	}
 
+	Qfloat *get_Q_lookup(int i, int len, int *start) const
+	{
+		Qfloat *data;
+		*start = cache->get_data(i,&data,len);
+		return data;
+	}
+
+	void fill_Q(int i, Qfloat *data, int begin, int end) const
+	{
+		if(streaming())
+		{
+			vector<int> pos;
+			stored_order(begin,end,pos);
+			for(int j : pos)
+				data[j] = (Qfloat)(y[i]*y[j]*(this->*kernel_function)(i,j));
+			return;
+		}
+		for(int j=begin;j<end;j++)
+			data[j] = (Qfloat)(y[i]*y[j]*(this->*kernel_function)(i,j));
+	}
+
 	double *get_QD() const
 	{
 		return QD;
 	}
 
+	int peek_Q(int i, const Qfloat **data) const
+	{
+		Qfloat *cached;
+		int len = cache->peek(i,&cached);
+		*data = cached;
+		return len;
+	}
+
+	double get_cache_hit_rate() const
+	{
+		return cache->hit_rate();
+	}
+
 	void swap_index(int i, int j) const
 	{
 		cache->swap_index(i,j);
@@ -1345,17 +3370,62 @@ public:
 		int start, j;
 		if((start = cache->get_data(i,&data,len)) < len)
 		{
+			// out of core, each thread takes a run of stored rows
+			vector<int> pos;
+			if(streaming())
+				stored_order(start,len,pos);
+#ifdef _OPENMP
+			int nr_thread = fill_threads(len-start);
+#pragma omp parallel for private(j) num_threads(nr_thread) if(nr_thread > 1) schedule(guided)
+#endif
 			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(i,j);
+			{
+				int c = pos.empty() ? j : pos[j-start];
+				data[c] = (Qfloat)(this->*kernel_function)(i,c);
+			}
 		}
 		return data;
 	}
 
+	Qfloat *get_Q_lookup(int i, int len, int *start) const
+	{
+		Qfloat *data;
+		*start = cache->get_data(i,&data,len);
+		return data;
+	}
+
+	void fill_Q(int i, Qfloat *data, int begin, int end) const
+	{
+		if(streaming())
+		{
+			vector<int> pos;
+			stored_order(begin,end,pos);
+			for(int j : pos)
+				data[j] = (Qfloat)(this->*kernel_function)(i,j);
+			return;
+		}
+		for(int j=begin;j<end;j++)
+			data[j] = (Qfloat)(this->*kernel_function)(i,j);
+	}
+
 	double *get_QD() const
 	{
 		return QD;
 	}
 
+	int peek_Q(int i, const Qfloat **data) const
+	{
+		Qfloat *cached;
+		int len = cache->peek(i,&cached);
+		*data = cached;
+		return len;
+	}
+
+	double get_cache_hit_rate() const
+	{
+		return cache->hit_rate();
+	}
+
 	void swap_index(int i, int j) const
 	{
 		cache->swap_index(i,j);
@@ -1380,51 +3450,131 @@ public:
 	:Kernel(prob.l, prob.x, param)
 	{
 		l = prob.l;
-		cache = new Cache(l,(size_t)(param.cache_size*(1<<20)));
+		// columns are cached signed and in solver order, so hits need no copy
+		cache = new Cache(2*l,(size_t)(param.cache_size*(1<<20)));
 		QD = new double[2*l];
 		sign = new schar[2*l];
 		index = new int[2*l];
+		twin = new int[2*l];
 		for(int k=0;k<l;k++)
 		{
 			sign[k] = 1;
 			sign[k+l] = -1;
 			index[k] = k;
 			index[k+l] = k;
+			twin[k] = k+l;
+			twin[k+l] = k;
 			QD[k] = (this->*kernel_function)(k,k);
 			QD[k+l] = QD[k];
 		}
-		buffer[0] = new Qfloat[2*l];
-		buffer[1] = new Qfloat[2*l];
-		next_buffer = 0;
+		if(streaming())
+		{
+			slot_pos.resize(2*l);
+			for(int k=0;k<2*l;k++)
+				slot_pos[k] = k;
+		}
 	}
 
 	void swap_index(int i, int j) const
 	{
+		if(i==j) return;
+		cache->swap_index(i,j);
 		swap(sign[i],sign[j]);
 		swap(index[i],index[j]);
 		swap(QD[i],QD[j]);
+		if(twin[i] != j)
+		{
+			swap(twin[i],twin[j]);
+			twin[twin[i]] = i;
+			twin[twin[j]] = j;
+		}
+		if(streaming())
+		{
+			slot_pos[sign[i] > 0 ? index[i] : index[i]+l] = i;
+			slot_pos[sign[j] > 0 ? index[j] : index[j]+l] = j;
+		}
 	}
 
 	Qfloat *get_Q(int i, int len) const
 	{
 		Qfloat *data;
-		int j, real_i = index[i];
-		if(cache->get_data(real_i,&data,l) < l)
+		int j, start;
+		if((start = cache->get_data(i,&data,len)) < len)
 		{
+			// the twin column holds the same kernel values with the sign of i flipped
+			Qfloat *twin_data;
+			int twin_len = min(cache->peek(twin[i],&twin_data),len);
+			for(j=start;j<twin_len;j++)
+				data[j] = -twin_data[j];
+			start = max(start,twin_len);
+
+			// so do positions j and twin[j]: evaluate the kernel once per pair
+			if(streaming())
+			{
+				vector<int> pos, unit;
+				stored_slots(start,len,pos,unit);
+				int nr_unit = (int)unit.size();
+#ifdef _OPENMP
+				int nr_thread = fill_threads(nr_unit);
+#pragma omp parallel for private(j) num_threads(nr_thread) if(nr_thread > 1) schedule(guided)
+#endif
+				for(j=0;j<nr_unit;j++)
+					fill_unit(i,data,pos,unit,j);
+				return data;
+			}
 #ifdef _OPENMP
-#pragma omp parallel for private(j) schedule(guided)
+			int nr_thread = fill_threads((len-start+1)/2);
+#pragma omp parallel for private(j) num_threads(nr_thread) if(nr_thread > 1) schedule(guided)
 #endif
-			for(j=0;j<l;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(real_i,j);
+			for(j=start;j<len;j++)
+				fill_pair(i,data,j,start,0);
+			for(j=start;j<len;j++)
+				fill_pair(i,data,j,start,1);
+		}
+		return data;
+	}
+
+	int fill_Q_passes() const { return streaming() ? 1 : 2; }
+
+	void fill_Q_pass(int i, Qfloat *data, int begin, int end, int start, int, int pass) const
+	{
+		if(streaming())
+			fill_Q(i,data,begin,end);
+		else
+			for(int j=begin;j<end;j++)
+				fill_pair(i,data,j,start,pass);
+	}
+
+	Qfloat *get_Q_lookup(int i, int len, int *start) const
+	{
+		Qfloat *data;
+		if((*start = cache->get_data(i,&data,len)) < len)
+		{
+			Qfloat *twin_data;
+			int twin_len = min(cache->peek(twin[i],&twin_data),len);
+			for(int j=*start;j<twin_len;j++)
+				data[j] = -twin_data[j];
+			*start = max(*start,twin_len);
 		}
+		return data;
+	}
 
-		// reorder and copy
-		Qfloat *buf = buffer[next_buffer];
-		next_buffer = 1 - next_buffer;
+	// evaluates the kernel for both positions of a pair, so ranges can be
+	// filled independently
+	void fill_Q(int i, Qfloat *data, int begin, int end) const
+	{
+		int real_i = index[i];
 		schar si = sign[i];
-		for(j=0;j<len;j++)
-			buf[j] = (Qfloat) si * (Qfloat) sign[j] * data[index[j]];
-		return buf;
+		if(streaming())
+		{
+			vector<int> pos, unit;
+			stored_slots(begin,end,pos,unit);
+			for(int u=0;u<(int)unit.size();u++)
+				fill_unit(i,data,pos,unit,u);
+			return;
+		}
+		for(int j=begin;j<end;j++)
+			data[j] = (Qfloat) si * (Qfloat) sign[j] * (Qfloat)(this->*kernel_function)(real_i,index[j]);
 	}
 
 	double *get_QD() const
@@ -1432,50 +3582,198 @@ public:
 		return QD;
 	}
 
+	int peek_Q(int i, const Qfloat **data) const
+	{
+		Qfloat *cached;
+		int len = cache->peek(i,&cached);
+		*data = cached;
+		return len;
+	}
+
+	double get_cache_hit_rate() const
+	{
+		return cache->hit_rate();
+	}
+
 	~SVR_Q()
 	{
 		delete cache;
 		delete[] sign;
 		delete[] index;
-		delete[] buffer[0];
-		delete[] buffer[1];
+		delete[] twin;
 		delete[] QD;
 	}
 private:
+	// entry j of column i when [0,start) is valid: pass 0 evaluates the
+	// first position of each pair and copies twins already valid, pass 1
+	// copies the second position
+	void fill_pair(int i, Qfloat *data, int j, int start, int pass) const
+	{
+		int t = twin[j];
+		if(pass == 0)
+		{
+			if(t < start)
+				data[j] = -data[t];
+			else if(t > j)
+				data[j] = (Qfloat) sign[i] * (Qfloat) sign[j] * (Qfloat)(this->*kernel_function)(index[i],index[j]);
+		}
+		else if(t >= start && t < j)
+			data[j] = -data[t];
+	}
+
+	// out of core: the positions in [begin,end) in the storage order of
+	// their rows, the two positions of a row next to each other; the run
+	// of the u-th row starts at pos[unit[u]]
+	void stored_slots(int begin, int end, vector<int>& pos, vector<int>& unit) const
+	{
+		int n = end-begin, r;
+		pos.resize(n);
+		for(int j=begin;j<end;j++)
+			pos[j-begin] = 2*stored_rank[index[j]] + (sign[j] > 0 ? 0 : 1);
+		sort_distinct(pos,2*l);
+		unit.clear();
+		for(r=0;r<n;r++)
+			if(r == 0 || pos[r]/2 != pos[r-1]/2)
+				unit.push_back(r);
+		for(r=0;r<n;r++)
+			pos[r] = slot_pos[stored_pos[pos[r]/2] + (pos[r]%2)*l];
+	}
+
+	// the entries of column i of the u-th run of stored_slots
+	void fill_unit(int i, Qfloat *data, const vector<int>& pos, const vector<int>& unit, int u) const
+	{
+		int r = unit[u];
+		int next = u+1 < (int)unit.size() ? unit[u+1] : (int)pos.size();
+		int j = pos[r];
+		data[j] = (Qfloat) sign[i] * (Qfloat) sign[j] * (Qfloat)(this->*kernel_function)(index[i],index[j]);
+		if(next > r+1)
+			data[pos[r+1]] = -data[j];
+	}
+
 	int l;
 	Cache *cache;
 	schar *sign;
 	int *index;
-	mutable int next_buffer;
-	Qfloat *buffer[2];
+	int *twin;	// position of the other variable sharing index[]
+	mutable vector<int> slot_pos;	// out-of-core: position of variable k (k<l) and k+l
 	double *QD;
 };
 
 //
 // construct and solve various formulations
 //
-static void solve_c_svc(
-	const svm_problem *prob, const svm_parameter* param,
-	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn)
-{
-	int l = prob->l;
-	vector<double> minus_ones(l, -1.0);
-	vector<schar> y(l);
+// init_alpha, when not NULL, is a previous solution in the form
+// svm_train_one returns (y_i alpha_i for classification). It is mapped
+// back to the solver's variables and made feasible before solving.
+//
 
-	int i;
+// The kernel matrix of one problem, kept by svm_train_path across the
+// solves for all values so the cache stays warm. A solve leaves Q's rows
+// permuted; perm[i] is the variable now at row i.
+struct path_matrix
+{
+	QMatrix *Q;
+	int *perm;
+};
 
-	for(i=0;i<l;i++)
-	{
-		alpha[i] = 0;
-		if(prob->y[i] > 0) y[i] = +1; else y[i] = -1;
-	}
+static void path_matrix_destroy(path_matrix *pm)
+{
+	delete pm->Q;
+	free(pm->perm);
+	pm->Q = NULL;
+	pm->perm = NULL;
+}
 
-	Solver s;
-	s.Solve(l, SVC_Q(*prob,*param,y.data()), minus_ones.data(), y.data(),
-		alpha, Cp, Cn, param->eps, si, param->shrinking);
+static void path_matrix_init(path_matrix *pm, QMatrix *Q, int l)
+{
+	pm->Q = Q;
+	pm->perm = Malloc(int,l);
+	for(int i=0;i<l;i++)
+		pm->perm[i] = i;
+}
 
-	double sum_alpha=0;
-	for(i=0;i<l;i++)
+// clip alpha[i] with y[i] == yc to [0,C], then move them in index order
+// until they sum to target
+static void adjust_sum(int l, double *alpha, const schar *y, schar yc, double C, double target)
+{
+	int i;
+	double sum = 0;
+	for(i=0;i<l;i++)
+		if(y[i] == yc)
+		{
+			alpha[i] = min(max(alpha[i],0.0),C);
+			sum += alpha[i];
+		}
+	for(i=0;i<l && sum != target;i++)
+		if(y[i] == yc)
+		{
+			double a = min(max(alpha[i]+target-sum,0.0),C);
+			sum += a-alpha[i];
+			alpha[i] = a;
+		}
+}
+
+// make sum_i y_i alpha_i = 0 by meeting both classes at the mean of their sums
+static void balance_classes(int l, double *alpha, const schar *y, double Cp, double Cn)
+{
+	double sum_p = 0, sum_n = 0;
+	int count_p = 0, count_n = 0;
+	for(int i=0;i<l;i++)
+		if(y[i] == +1)
+		{
+			sum_p += min(max(alpha[i],0.0),Cp);
+			++count_p;
+		}
+		else
+		{
+			sum_n += min(max(alpha[i],0.0),Cn);
+			++count_n;
+		}
+	double target = min((sum_p+sum_n)/2,min(count_p*Cp,count_n*Cn));
+	adjust_sum(l,alpha,y,+1,Cp,target);
+	adjust_sum(l,alpha,y,-1,Cn,target);
+}
+
+static void solve_c_svc(
+	const svm_problem *prob, const svm_parameter* param,
+	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn,
+	const double *init_alpha, path_matrix *path, checkpoint *ck)
+{
+	int l = prob->l;
+	vector<double> minus_ones(l, -1.0);
+	vector<schar> y(l);
+
+	int i;
+
+	for(i=0;i<l;i++)
+	{
+		alpha[i] = 0;
+		if(prob->y[i] > 0) y[i] = +1; else y[i] = -1;
+	}
+
+	if(init_alpha)
+	{
+		for(i=0;i<l;i++)
+			alpha[i] = init_alpha[i]*y[i];
+		balance_classes(l,alpha,y.data(),Cp,Cn);
+	}
+
+	Solver s;
+	if(path)
+	{
+		if(!path->Q)
+			path_matrix_init(path,new SVC_Q(*prob,*param,y.data()),l);
+		s.Solve(l, *path->Q, minus_ones.data(), y.data(),
+			alpha, Cp, Cn, param->eps, si, param->shrinking,
+			*param, path->perm, ck);
+	}
+	else
+		s.Solve(l, SVC_Q(*prob,*param,y.data()), minus_ones.data(), y.data(),
+			alpha, Cp, Cn, param->eps, si, param->shrinking,
+			*param, NULL, ck);
+
+	double sum_alpha=0;
+	for(i=0;i<l;i++)
 		sum_alpha += alpha[i];
 
 	if (Cp==Cn)
@@ -1487,7 +3785,8 @@ static void solve_c_svc(
 
 static void solve_nu_svc(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const double *init_alpha,
+	path_matrix *path, checkpoint *ck)
 {
 	int i;
 	int l = prob->l;
@@ -1516,11 +3815,41 @@ static void solve_nu_svc(
 			sum_neg -= alpha[i];
 		}
 
+	if(init_alpha)
+	{
+		// the previous solution is scaled by an unknown 1/r; rescale
+		// each class to its required sum before repairing the bounds
+		double init_pos = 0, init_neg = 0;
+		for(i=0;i<l;i++)
+			if(y[i] == +1)
+				init_pos += fabs(init_alpha[i]);
+			else
+				init_neg += fabs(init_alpha[i]);
+		for(i=0;i<l;i++)
+		{
+			double init_sum = y[i] == +1 ? init_pos : init_neg;
+			if(init_sum > 0)
+				alpha[i] = fabs(init_alpha[i])*(nu*l/2)/init_sum;
+		}
+		adjust_sum(l,alpha,y.data(),+1,1.0,nu*l/2);
+		adjust_sum(l,alpha,y.data(),-1,1.0,nu*l/2);
+	}
+
 	vector<double> zeros(l, 0.0);
 
 	Solver_NU s;
-	s.Solve(l, SVC_Q(*prob,*param,y.data()), zeros.data(), y.data(),
-		alpha, 1.0, 1.0, param->eps, si,  param->shrinking);
+	if(path)
+	{
+		if(!path->Q)
+			path_matrix_init(path,new SVC_Q(*prob,*param,y.data()),l);
+		s.Solve(l, *path->Q, zeros.data(), y.data(),
+			alpha, 1.0, 1.0, param->eps, si, param->shrinking,
+			*param, path->perm, ck);
+	}
+	else
+		s.Solve(l, SVC_Q(*prob,*param,y.data()), zeros.data(), y.data(),
+			alpha, 1.0, 1.0, param->eps, si,  param->shrinking,
+			*param, NULL, ck);
 	double r = si->r;
 
 	info("C = %f\n",1/r);
@@ -1536,7 +3865,8 @@ static void solve_nu_svc(
 
 static void solve_one_class(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const double *init_alpha,
+	path_matrix *path, checkpoint *ck)
 {
 	int l = prob->l;
 	vector<double> zeros(l, 0.0);
@@ -1552,14 +3882,32 @@ static void solve_one_class(
 	for(i=n+1;i<l;i++)
 		alpha[i] = 0;
 
+	if(init_alpha)
+	{
+		for(i=0;i<l;i++)
+			alpha[i] = init_alpha[i];
+		adjust_sum(l,alpha,ones.data(),1,1.0,param->nu*prob->l);
+	}
+
 	Solver s;
-	s.Solve(l, ONE_CLASS_Q(*prob,*param), zeros.data(), ones.data(),
-		alpha, 1.0, 1.0, param->eps, si, param->shrinking);
+	if(path)
+	{
+		if(!path->Q)
+			path_matrix_init(path,new ONE_CLASS_Q(*prob,*param),l);
+		s.Solve(l, *path->Q, zeros.data(), ones.data(),
+			alpha, 1.0, 1.0, param->eps, si, param->shrinking,
+			*param, path->perm, ck);
+	}
+	else
+		s.Solve(l, ONE_CLASS_Q(*prob,*param), zeros.data(), ones.data(),
+			alpha, 1.0, 1.0, param->eps, si, param->shrinking,
+			*param, NULL, ck);
 }
 
 static void solve_epsilon_svr(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const double *init_alpha,
+	path_matrix *path, checkpoint *ck)
 {
 	int l = prob->l;
 	vector<double> alpha2(2*l);
@@ -1578,9 +3926,29 @@ static void solve_epsilon_svr(
 		y[i+l] = -1;
 	}
 
+	if(init_alpha)
+	{
+		for(i=0;i<l;i++)
+		{
+			alpha2[i] = max(init_alpha[i],0.0);
+			alpha2[i+l] = max(-init_alpha[i],0.0);
+		}
+		balance_classes(2*l,alpha2.data(),y.data(),param->C,param->C);
+	}
+
 	Solver s;
-	s.Solve(2*l, SVR_Q(*prob,*param), linear_term.data(), y.data(),
-		alpha2.data(), param->C, param->C, param->eps, si, param->shrinking);
+	if(path)
+	{
+		if(!path->Q)
+			path_matrix_init(path,new SVR_Q(*prob,*param),2*l);
+		s.Solve(2*l, *path->Q, linear_term.data(), y.data(),
+			alpha2.data(), param->C, param->C, param->eps, si, param->shrinking,
+			*param, path->perm, ck);
+	}
+	else
+		s.Solve(2*l, SVR_Q(*prob,*param), linear_term.data(), y.data(),
+			alpha2.data(), param->C, param->C, param->eps, si, param->shrinking,
+			*param, NULL, ck);
 
 	double sum_alpha = 0;
 	for(i=0;i<l;i++)
@@ -1593,7 +3961,8 @@ static void solve_epsilon_svr(
 
 static void solve_nu_svr(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const double *init_alpha,
+	path_matrix *path, checkpoint *ck)
 {
 	int l = prob->l;
 	double C = param->C;
@@ -1615,9 +3984,30 @@ static void solve_nu_svr(
 		y[i+l] = -1;
 	}
 
+	if(init_alpha)
+	{
+		for(i=0;i<l;i++)
+		{
+			alpha2[i] = max(init_alpha[i],0.0);
+			alpha2[i+l] = max(-init_alpha[i],0.0);
+		}
+		adjust_sum(2*l,alpha2.data(),y.data(),+1,C,C*param->nu*l/2);
+		adjust_sum(2*l,alpha2.data(),y.data(),-1,C,C*param->nu*l/2);
+	}
+
 	Solver_NU s;
-	s.Solve(2*l, SVR_Q(*prob,*param), linear_term.data(), y.data(),
-		alpha2.data(), C, C, param->eps, si, param->shrinking);
+	if(path)
+	{
+		if(!path->Q)
+			path_matrix_init(path,new SVR_Q(*prob,*param),2*l);
+		s.Solve(2*l, *path->Q, linear_term.data(), y.data(),
+			alpha2.data(), C, C, param->eps, si, param->shrinking,
+			*param, path->perm, ck);
+	}
+	else
+		s.Solve(2*l, SVR_Q(*prob,*param), linear_term.data(), y.data(),
+			alpha2.data(), C, C, param->eps, si, param->shrinking,
+			*param, NULL, ck);
 
 	info("epsilon = %f\n",-si->r);
 
@@ -1625,6 +4015,404 @@ static void solve_nu_svr(
 		alpha[i] = alpha2[i] - alpha2[i+l];
 }
 
+//
+// Dual coordinate descent for the linear kernel (solver = DCD)
+//
+// Hsieh et al., ICML 2008. With w = sum_i alpha_i y_i x_i kept explicitly,
+// the gradient of one variable is a sparse dot product, so a pass over
+// all variables costs O(nnz) and Q is never formed. The bias is the
+// weight b of a constant feature 1; unlike in the SMO solvers it is
+// regularized and there is no equality constraint (LIBLINEAR's -B 1).
+//
+// C_SVC solves
+//
+//	min 0.5(\alpha^T Q \alpha) - e^T \alpha, 0 <= alpha_i <= Cp or Cn
+//
+// and EPSILON_SVR, with beta = alpha^+ - alpha^-,
+//
+//	min 0.5(\beta^T Q \beta) - y^T \beta + p |\beta|_1, -C <= beta_i <= C
+//
+// where Q_ij = y_i y_j (x_i^T x_j + 1) and x_i^T x_j + 1, respectively.
+// Variables are visited in a random order each pass; those staying at a
+// bound are shrunk as in LIBLINEAR. max_iter limits the passes.
+//
+static int max_feature_index(const svm_problem *prob)
+{
+	int n = 0;
+	for(int i=0;i<prob->l;i++)
+		for(const svm_node *x=prob->x[i];x->index!=-1;x++)
+			n = max(n,x->index);
+	return n;
+}
+
+static double linear_value(const double *w, double b, const svm_node *x)
+{
+	double v = b;
+	for(;x->index!=-1;x++)
+		v += w[x->index]*x->value;
+	return v;
+}
+
+static void linear_add(double *w, double& b, double a, const svm_node *x)
+{
+	b += a;
+	for(;x->index!=-1;x++)
+		w[x->index] += a*x->value;
+}
+
+// x_i^T x_i + 1
+static double linear_QD(const svm_node *x)
+{
+	double v = 1;
+	for(;x->index!=-1;x++)
+		v += x->value*x->value;
+	return v;
+}
+
+static bool linear_report(int l, int iter, double violation, int active_size,
+	double obj, double start_time, double gap, int stopped)
+{
+	svm_progress progress;
+	progress.l = l;
+	progress.iter = iter;
+	progress.violation = violation;
+	progress.active_size = active_size;
+	progress.obj = obj;
+	progress.cache_hit_rate = 0;
+	progress.elapsed = wall_time()-start_time;
+	progress.gap = gap;
+	progress.stopped = stopped;
+	return progress_report(&progress);
+}
+
+// a fixed seed keeps the result reproducible and independent of rand()
+static void linear_shuffle(std::minstd_rand& rng, int *index, int n)
+{
+	for(int i=0;i<n;i++)
+		swap(index[i],index[i+(int)(rng()%(unsigned)(n-i))]);
+}
+
+static void solve_dcd_c_svc(
+	const svm_problem *prob, const svm_parameter* param,
+	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn,
+	const double *init_alpha)
+{
+	int l = prob->l;
+	int n = max_feature_index(prob);
+	vector<double> w(n+1,0.0);
+	double b = 0;
+	vector<schar> y(l);
+	vector<double> QD(l);
+	vector<int> index(l);
+	int i, s;
+
+	for(i=0;i<l;i++)
+	{
+		y[i] = prob->y[i] > 0 ? +1 : -1;
+		double C_i = y[i] > 0 ? Cp : Cn;
+		alpha[i] = init_alpha ? min(max(init_alpha[i]*y[i],0.0),C_i) : 0;
+		if(alpha[i] != 0)
+			linear_add(w.data(),b,alpha[i]*y[i],prob->x[i]);
+		QD[i] = linear_QD(prob->x[i]);
+		index[i] = i;
+	}
+
+	auto objective = [&]() {
+		double v = b*b;
+		for(int k=0;k<=n;k++)
+			v += w[k]*w[k];
+		v /= 2;
+		for(int k=0;k<l;k++)
+			v -= alpha[k];
+		return v;
+	};
+
+	std::minstd_rand rng(1);
+	int max_iter = param->max_iter > 0 ? param->max_iter : 1000;
+	double start_time = wall_time();
+	const char *stop = NULL;
+	int iter = 0;
+	int active_size = l;
+	double PGmax_old = INF, PGmin_old = -INF;
+	double violation = INF;
+	while(true)
+	{
+		if(iter >= max_iter)
+		{
+			stop = "reaching max number of iterations";
+			break;
+		}
+		if(param->max_time > 0 && wall_time()-start_time > param->max_time)
+		{
+			stop = "reaching max training time";
+			break;
+		}
+		if(training_cancelled() || (svm_progress_function != NULL &&
+		   linear_report(l,iter,violation,active_size,objective(),start_time,NAN,0)))
+		{
+			stop = "training cancelled";
+			break;
+		}
+
+		double PGmax_new = -INF, PGmin_new = INF;
+		linear_shuffle(rng,index.data(),active_size);
+		for(s=0;s<active_size;s++)
+		{
+			i = index[s];
+			const svm_node *x = prob->x[i];
+			double G = y[i]*linear_value(w.data(),b,x) - 1;
+			double C_i = y[i] > 0 ? Cp : Cn;
+
+			// projected gradient; shrink a variable at a bound that
+			// violated nothing in the last pass either
+			double PG = 0;
+			if(alpha[i] == 0)
+			{
+				if(G > PGmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+				else if(G < 0)
+					PG = G;
+			}
+			else if(alpha[i] == C_i)
+			{
+				if(G < PGmin_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+				else if(G > 0)
+					PG = G;
+			}
+			else
+				PG = G;
+
+			PGmax_new = max(PGmax_new,PG);
+			PGmin_new = min(PGmin_new,PG);
+
+			if(fabs(PG) > 1.0e-12)
+			{
+				double alpha_old = alpha[i];
+				alpha[i] = min(max(alpha[i]-G/QD[i],0.0),C_i);
+				linear_add(w.data(),b,(alpha[i]-alpha_old)*y[i],x);
+			}
+		}
+
+		++iter;
+		if(iter%10 == 0)
+			info(".");
+		violation = PGmax_new-PGmin_new;
+		if(violation <= param->eps)
+		{
+			if(active_size == l)
+				break;
+			// check the shrunk variables too
+			active_size = l;
+			info("*");
+			PGmax_old = INF;
+			PGmin_old = -INF;
+			continue;
+		}
+		PGmax_old = PGmax_new > 0 ? PGmax_new : INF;
+		PGmin_old = PGmin_new < 0 ? PGmin_new : -INF;
+	}
+
+	si->obj = objective();
+	si->rho = -b;
+	si->r = 0;
+	si->upper_bound_p = Cp;
+	si->upper_bound_n = Cn;
+	// primal minus dual: 0.5 |w|^2 + sum_i C_i max(0,1-y_i f(x_i)) + obj
+	si->gap = 0;
+	for(i=0;i<l;i++)
+		si->gap += (y[i] > 0 ? Cp : Cn)*max(0.0,1-y[i]*linear_value(w.data(),b,prob->x[i]));
+	si->gap += 2*si->obj;
+	for(i=0;i<l;i++)
+		si->gap += alpha[i];
+	if(stop != NULL)
+		fprintf(stderr,"\nWARNING: %s, duality gap = %g\n",stop,si->gap);
+	if(svm_progress_function != NULL && !training_cancelled())
+		linear_report(l,iter,violation,active_size,si->obj,start_time,si->gap,stop != NULL);
+	info("\noptimization finished, #iter = %d\n",iter);
+	solver_iterations += iter;
+
+	double sum_alpha = 0;
+	for(i=0;i<l;i++)
+		sum_alpha += alpha[i];
+	if(Cp == Cn)
+		info("nu = %f\n", sum_alpha/(Cp*prob->l));
+
+	for(i=0;i<l;i++)
+		alpha[i] *= y[i];
+}
+
+static void solve_dcd_svr(
+	const svm_problem *prob, const svm_parameter *param,
+	double *alpha, Solver::SolutionInfo* si, const double *init_alpha)
+{
+	int l = prob->l;
+	int n = max_feature_index(prob);
+	double C = param->C;
+	double p = param->p;
+	vector<double> w(n+1,0.0);
+	double b = 0;
+	vector<double> QD(l);
+	vector<int> index(l);
+	int i, s;
+
+	for(i=0;i<l;i++)
+	{
+		alpha[i] = init_alpha ? min(max(init_alpha[i],-C),C) : 0;
+		if(alpha[i] != 0)
+			linear_add(w.data(),b,alpha[i],prob->x[i]);
+		QD[i] = linear_QD(prob->x[i]);
+		index[i] = i;
+	}
+
+	auto objective = [&]() {
+		double v = b*b;
+		for(int k=0;k<=n;k++)
+			v += w[k]*w[k];
+		v /= 2;
+		for(int k=0;k<l;k++)
+			v += p*fabs(alpha[k]) - prob->y[k]*alpha[k];
+		return v;
+	};
+
+	std::minstd_rand rng(1);
+	int max_iter = param->max_iter > 0 ? param->max_iter : 1000;
+	double start_time = wall_time();
+	const char *stop = NULL;
+	int iter = 0;
+	int active_size = l;
+	double Gmax_old = INF;
+	double violation = INF;
+	while(true)
+	{
+		if(iter >= max_iter)
+		{
+			stop = "reaching max number of iterations";
+			break;
+		}
+		if(param->max_time > 0 && wall_time()-start_time > param->max_time)
+		{
+			stop = "reaching max training time";
+			break;
+		}
+		if(training_cancelled() || (svm_progress_function != NULL &&
+		   linear_report(l,iter,violation,active_size,objective(),start_time,NAN,0)))
+		{
+			stop = "training cancelled";
+			break;
+		}
+
+		double Gmax_new = 0;
+		linear_shuffle(rng,index.data(),active_size);
+		for(s=0;s<active_size;s++)
+		{
+			i = index[s];
+			const svm_node *x = prob->x[i];
+			double G = linear_value(w.data(),b,x) - prob->y[i];
+			double Gp = G+p;	// gradient for beta_i > 0
+			double Gn = G-p;	// and for beta_i < 0
+			double H = QD[i];
+
+			double viol = 0;
+			if(alpha[i] == 0)
+			{
+				if(Gp < 0)
+					viol = -Gp;
+				else if(Gn > 0)
+					viol = Gn;
+				else if(Gp > Gmax_old && Gn < -Gmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+			}
+			else if(alpha[i] >= C)
+			{
+				if(Gp > 0)
+					viol = Gp;
+				else if(Gp < -Gmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+			}
+			else if(alpha[i] <= -C)
+			{
+				if(Gn < 0)
+					viol = -Gn;
+				else if(Gn > Gmax_old)
+				{
+					swap(index[s--],index[--active_size]);
+					continue;
+				}
+			}
+			else if(alpha[i] > 0)
+				viol = fabs(Gp);
+			else
+				viol = fabs(Gn);
+			Gmax_new = max(Gmax_new,viol);
+
+			// minimum of the piecewise quadratic in beta_i, then clip
+			double d;
+			if(Gp < H*alpha[i])
+				d = -Gp/H;
+			else if(Gn > H*alpha[i])
+				d = -Gn/H;
+			else
+				d = -alpha[i];
+			if(fabs(d) < 1.0e-12)
+				continue;
+			double alpha_old = alpha[i];
+			alpha[i] = min(max(alpha[i]+d,-C),C);
+			if(alpha[i] != alpha_old)
+				linear_add(w.data(),b,alpha[i]-alpha_old,x);
+		}
+
+		++iter;
+		if(iter%10 == 0)
+			info(".");
+		violation = Gmax_new;
+		if(violation <= param->eps)
+		{
+			if(active_size == l)
+				break;
+			active_size = l;
+			info("*");
+			Gmax_old = INF;
+			continue;
+		}
+		Gmax_old = Gmax_new;
+	}
+
+	si->obj = objective();
+	si->rho = -b;
+	si->r = 0;
+	si->upper_bound_p = C;
+	si->upper_bound_n = C;
+	// primal minus dual: 0.5 |w|^2 + C sum_i max(0,|f(x_i)-y_i|-p) + obj
+	si->gap = 2*si->obj;
+	for(i=0;i<l;i++)
+		si->gap += C*max(0.0,fabs(linear_value(w.data(),b,prob->x[i])-prob->y[i])-p)
+			+ prob->y[i]*alpha[i] - p*fabs(alpha[i]);
+	if(stop != NULL)
+		fprintf(stderr,"\nWARNING: %s, duality gap = %g\n",stop,si->gap);
+	if(svm_progress_function != NULL && !training_cancelled())
+		linear_report(l,iter,violation,active_size,si->obj,start_time,si->gap,stop != NULL);
+	info("\noptimization finished, #iter = %d\n",iter);
+	solver_iterations += iter;
+
+	double sum_alpha = 0;
+	for(i=0;i<l;i++)
+		sum_alpha += fabs(alpha[i]);
+	info("nu = %f\n",sum_alpha/(C*l));
+}
+
 //
 // decision_function
 //
@@ -1636,30 +4424,37 @@ struct decision_function
 
 static decision_function svm_train_one(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn)
+	double Cp, double Cn, const double *init_alpha, path_matrix *path,
+	checkpoint *ck)
 {
 	double *alpha = Malloc(double,prob->l);
 	Solver::SolutionInfo si;
 	switch(param->svm_type)
 	{
 		case C_SVC:
-			solve_c_svc(prob,param,alpha,&si,Cp,Cn);
+			if(param->solver == DCD)
+				solve_dcd_c_svc(prob,param,alpha,&si,Cp,Cn,init_alpha);
+			else
+				solve_c_svc(prob,param,alpha,&si,Cp,Cn,init_alpha,path,ck);
 			break;
 		case NU_SVC:
-			solve_nu_svc(prob,param,alpha,&si);
+			solve_nu_svc(prob,param,alpha,&si,init_alpha,path,ck);
 			break;
 		case ONE_CLASS:
-			solve_one_class(prob,param,alpha,&si);
+			solve_one_class(prob,param,alpha,&si,init_alpha,path,ck);
 			break;
 		case EPSILON_SVR:
-			solve_epsilon_svr(prob,param,alpha,&si);
+			if(param->solver == DCD)
+				solve_dcd_svr(prob,param,alpha,&si,init_alpha);
+			else
+				solve_epsilon_svr(prob,param,alpha,&si,init_alpha,path,ck);
 			break;
 		case NU_SVR:
-			solve_nu_svr(prob,param,alpha,&si);
+			solve_nu_svr(prob,param,alpha,&si,init_alpha,path,ck);
 			break;
 	}
 
-	info("obj = %f, rho = %f\n",si.obj,si.rho);
+	info("obj = %f, rho = %f, gap = %g\n",si.obj,si.rho,si.gap);
 
 	// output SVs
 
@@ -1880,20 +4675,24 @@ static void multiclass_probability(int k, double **r, double *p)
 }
 
 // Using cross-validation decision values to get parameters for SVC probability estimates
+// folds drawn from a generator seeded by seed, so that the estimate does
+// not depend on rand() or on what ran before (a resumed checkpoint, other
+// threads)
 static void svm_binary_svc_probability(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn, double& probA, double& probB)
+	double Cp, double Cn, double& probA, double& probB, unsigned seed)
 {
 	int i;
 	int nr_fold = 5;
 	int *perm = Malloc(int,prob->l);
 	double *dec_values = Malloc(double,prob->l);
+	std::minstd_rand rng(seed);
 
 	// random shuffle
 	for(i=0;i<prob->l;i++) perm[i]=i;
 	for(i=0;i<prob->l;i++)
 	{
-		int j = i+rand()%(prob->l-i);
+		int j = i+random_below(&rng,prob->l-i);
 		swap(perm[i],perm[j]);
 	}
 	for(i=0;i<nr_fold;i++)
@@ -1948,6 +4747,8 @@ static void svm_binary_svc_probability(
 			subparam.weight_label[1]=-1;
 			subparam.weight[0]=Cp;
 			subparam.weight[1]=Cn;
+			// the folds and the final training share the time budget
+			subparam.max_time = param->max_time/(nr_fold+1);
 			struct svm_model *submodel = svm_train(&subprob,&subparam);
 			for(j=begin;j<end;j++)
 			{
@@ -2044,6 +4845,9 @@ static int svm_one_class_probability(const svm_problem *prob, const svm_model *m
 }
 
 // Return parameter of a Laplace distribution
+static void cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold,
+	double *target, std::minstd_rand *rng);
+
 static double svm_svr_probability(
 	const svm_problem *prob, const svm_parameter *param)
 {
@@ -2054,7 +4858,9 @@ static double svm_svr_probability(
 
 	svm_parameter newparam = *param;
 	newparam.probability = 0;
-	svm_cross_validation(prob,&newparam,nr_fold,ymv);
+	newparam.max_time = param->max_time/(nr_fold+1);
+	std::minstd_rand rng(1);
+	cross_validation(prob,&newparam,nr_fold,ymv,&rng);
 	for(i=0;i<prob->l;i++)
 	{
 		ymv[i]=prob->y[i]-ymv[i];
@@ -2156,108 +4962,1296 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 //
 // Interface functions
 //
-svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
+// Coefficients of previous models' SVs, indexed by training instance
+// (sv_indices), for warm starts. In a classification model the SV's
+// coefficient against class c of that model is
+// sv_coef[c < own class ? c : c-1].
+struct warm_start
 {
-	svm_model *model = Malloc(svm_model,1);
-	model->param = *param;
-	model->free_sv = 0;	// XXX
+	int nr_model;
+	const svm_model **model;
+	int *sv_model;	// sv_model[i]: model having instance i as an SV, or -1
+	int *sv_pos;	// sv_pos[i]: position of instance i in its model's SV
+	int **sv_class;	// sv_class[m][k]: class index of model[m]->SV[k]
+};
 
-	if(param->svm_type == ONE_CLASS ||
-	   param->svm_type == EPSILON_SVR ||
-	   param->svm_type == NU_SVR)
+static bool warm_start_init(warm_start *ws, const svm_problem *prob,
+	const svm_parameter *param, int nr_model, const svm_model *const *model)
+{
+	ws->nr_model = 0;
+	ws->model = NULL;
+	ws->sv_model = NULL;
+	ws->sv_pos = NULL;
+	ws->sv_class = NULL;
+	if(nr_model <= 0)
+		return false;
+	ws->model = Malloc(const svm_model *,nr_model);
+	ws->sv_class = Malloc(int *,nr_model);
+	ws->sv_model = Malloc(int,prob->l);
+	ws->sv_pos = Malloc(int,prob->l);
+	int i, k, m;
+	for(i=0;i<prob->l;i++)
+		ws->sv_model[i] = -1;
+	for(m=0;m<nr_model;m++)
 	{
-		// regression or one-class-svm
-		model->nr_class = 2;
-		model->label = NULL;
-		model->nSV = NULL;
-		model->probA = NULL; model->probB = NULL;
-		model->prob_density_marks = NULL;
-		model->sv_coef = Malloc(double *,1);
-
-		decision_function f = svm_train_one(prob,param,0,0);
-		model->rho = Malloc(double,1);
-		model->rho[0] = f.rho;
-
-		int nSV = 0;
-		int i;
-		for(i=0;i<prob->l;i++)
-			if(fabs(f.alpha[i]) > 0) ++nSV;
-		model->l = nSV;
-		model->SV = Malloc(svm_node *,nSV);
-		model->sv_coef[0] = Malloc(double,nSV);
-		model->sv_indices = Malloc(int,nSV);
-		int j = 0;
-		for(i=0;i<prob->l;i++)
-			if(fabs(f.alpha[i]) > 0)
-			{
-				model->SV[j] = prob->x[i];
-				model->sv_coef[0][j] = f.alpha[i];
-				model->sv_indices[j] = i+1;
-				++j;
-			}
-
-		if(param->probability &&
-		   (param->svm_type == EPSILON_SVR ||
-		    param->svm_type == NU_SVR))
+		const svm_model *mm = model[m];
+		if(mm->sv_indices == NULL || mm->param.svm_type != param->svm_type)
 		{
-			model->probA = Malloc(double,1);
-			model->probA[0] = svm_svr_probability(prob,param);
+			info("WARNING: initial model not usable for a warm start; ignored\n");
+			continue;
 		}
-		else if(param->probability && param->svm_type == ONE_CLASS)
+		int n = ws->nr_model++;
+		ws->model[n] = mm;
+		for(k=0;k<mm->l;k++)
+			if(mm->sv_indices[k] >= 1 && mm->sv_indices[k] <= prob->l)
+			{
+				ws->sv_model[mm->sv_indices[k]-1] = n;
+				ws->sv_pos[mm->sv_indices[k]-1] = k;
+			}
+		ws->sv_class[n] = NULL;
+		if(mm->nSV)
 		{
-			int nr_marks = 10;
-			double *prob_density_marks = Malloc(double,nr_marks);
-
-			if(svm_one_class_probability(prob,model,prob_density_marks) == 0)
-				model->prob_density_marks = prob_density_marks;
-			else
-				free(prob_density_marks);
+			ws->sv_class[n] = Malloc(int,mm->l);
+			k = 0;
+			for(i=0;i<mm->nr_class;i++)
+				for(int c=0;c<mm->nSV[i];c++)
+					ws->sv_class[n][k++] = i;
+		}
+	}
+	return ws->nr_model > 0;
+}
+
+static void warm_start_destroy(warm_start *ws)
+{
+	for(int m=0;m<ws->nr_model;m++)
+		free(ws->sv_class[m]);
+	free(ws->sv_class);
+	free(ws->model);
+	free(ws->sv_model);
+	free(ws->sv_pos);
+}
+
+static int warm_start_class(const svm_model *model, int label)
+{
+	for(int i=0;i<model->nr_class;i++)
+		if(model->label[i] == label)
+			return i;
+	return -1;
+}
+
+// initial coefficient of instance i in the binary problem
+// label_pos (+1) vs. label_neg (-1)
+static double warm_start_alpha(const warm_start *ws, int i, int label_pos, int label_neg)
+{
+	int m = ws->sv_model[i];
+	if(m < 0)
+		return 0;
+	const svm_model *model = ws->model[m];
+	int k = ws->sv_pos[i];
+	if(ws->sv_class[m] == NULL)
+		return model->sv_coef[0][k];
+	int c_pos = warm_start_class(model,label_pos);
+	int c_neg = warm_start_class(model,label_neg);
+	if(c_pos < 0 || c_neg < 0)
+		return 0;
+	int own = ws->sv_class[m][k];
+	int other = own == c_pos ? c_neg : own == c_neg ? c_pos : -1;
+	if(other < 0)
+		return 0;
+	// the previous model used the lower class index as +1
+	double coef = model->sv_coef[other < own ? other : other-1][k];
+	return (c_pos < c_neg) ? coef : -coef;
+}
+
+// model of a regression or one-class problem from its solution
+static svm_model *svm_build_one_model(const svm_problem *prob, const svm_parameter *param,
+	const decision_function& f)
+{
+	svm_model *model = Malloc(svm_model,1);
+	model->param = *param;
+	model->free_sv = 0;	// XXX
+
+	model->nr_class = 2;
+	model->label = NULL;
+	model->nSV = NULL;
+	model->probA = NULL; model->probB = NULL;
+	model->prob_density_marks = NULL;
+	model->sv_coef = Malloc(double *,1);
+
+	model->rho = Malloc(double,1);
+	model->rho[0] = f.rho;
+
+	int nSV = 0;
+	int i;
+	for(i=0;i<prob->l;i++)
+		if(fabs(f.alpha[i]) > 0) ++nSV;
+	model->l = nSV;
+	model->SV = Malloc(svm_node *,nSV);
+	model->sv_coef[0] = Malloc(double,nSV);
+	model->sv_indices = Malloc(int,nSV);
+	int j = 0;
+	for(i=0;i<prob->l;i++)
+		if(fabs(f.alpha[i]) > 0)
+		{
+			model->SV[j] = prob->x[i];
+			model->sv_coef[0][j] = f.alpha[i];
+			model->sv_indices[j] = i+1;
+			++j;
+		}
+
+	if(param->probability &&
+	   (param->svm_type == EPSILON_SVR ||
+	    param->svm_type == NU_SVR))
+	{
+		model->probA = Malloc(double,1);
+		model->probA[0] = svm_svr_probability(prob,param);
+	}
+	else if(param->probability && param->svm_type == ONE_CLASS)
+	{
+		int nr_marks = 10;
+		double *prob_density_marks = Malloc(double,nr_marks);
+
+		if(svm_one_class_probability(prob,model,prob_density_marks) == 0)
+			model->prob_density_marks = prob_density_marks;
+		else
+			free(prob_density_marks);
+	}
+	return model;
+}
+
+// training data grouped by class, shared by the k*(k-1)/2 binary problems
+struct class_groups
+{
+	int l;
+	int nr_class;
+	int *label;
+	int *start;
+	int *count;
+	int *perm;
+	svm_node **x;
+};
+
+static void class_groups_init(class_groups *g, const svm_problem *prob)
+{
+	int l = prob->l;
+	g->l = l;
+	g->label = NULL;
+	g->start = NULL;
+	g->count = NULL;
+	g->perm = Malloc(int,l);
+
+	// group training data of the same class
+	svm_group_classes(prob,&g->nr_class,&g->label,&g->start,&g->count,g->perm);
+	if(g->nr_class == 1)
+		info("WARNING: training data in only one class. See README for details.\n");
+
+	g->x = Malloc(svm_node *,l);
+	for(int i=0;i<l;i++)
+		g->x[i] = prob->x[g->perm[i]];
+}
+
+static void class_groups_destroy(class_groups *g)
+{
+	free(g->label);
+	free(g->start);
+	free(g->count);
+	free(g->perm);
+	free(g->x);
+}
+
+static double *class_groups_weighted_C(const class_groups *g, const svm_parameter *param)
+{
+	int nr_class = g->nr_class;
+	double *weighted_C = Malloc(double, nr_class);
+	int i;
+	for(i=0;i<nr_class;i++)
+		weighted_C[i] = param->C;
+	for(i=0;i<param->nr_weight;i++)
+	{
+		int j;
+		for(j=0;j<nr_class;j++)
+			if(param->weight_label[i] == g->label[j])
+				break;
+		if(j == nr_class)
+			fprintf(stderr,"WARNING: class label %d specified in weight is not found\n", param->weight_label[i]);
+		else
+			weighted_C[j] *= param->weight[i];
+	}
+	return weighted_C;
+}
+
+// class i as +1 against class j as -1; free sub_prob->x and sub_prob->y after use
+static void class_groups_pair(const class_groups *g, int i, int j, svm_problem *sub_prob)
+{
+	int si = g->start[i], sj = g->start[j];
+	int ci = g->count[i], cj = g->count[j];
+	sub_prob->l = ci+cj;
+	sub_prob->x = Malloc(svm_node *,sub_prob->l);
+	sub_prob->y = Malloc(double,sub_prob->l);
+	int k;
+	for(k=0;k<ci;k++)
+	{
+		sub_prob->x[k] = g->x[si+k];
+		sub_prob->y[k] = +1;
+	}
+	for(k=0;k<cj;k++)
+	{
+		sub_prob->x[ci+k] = g->x[sj+k];
+		sub_prob->y[ci+k] = -1;
+	}
+}
+
+// model of a classification problem from the solutions f[] of its
+// k*(k-1)/2 binary problems (and their probA[], probB[] if probability)
+static svm_model *svm_build_class_model(const class_groups *g, const svm_parameter *param,
+	const decision_function *f, const double *probA, const double *probB)
+{
+	svm_model *model = Malloc(svm_model,1);
+	model->param = *param;
+	model->free_sv = 0;	// XXX
+
+	int l = g->l;
+	int nr_class = g->nr_class;
+	const int *start = g->start;
+	const int *count = g->count;
+	int i;
+
+	bool *nonzero = Malloc(bool,l);
+	for(i=0;i<l;i++)
+		nonzero[i] = false;
+	int p = 0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			int k;
+			for(k=0;k<count[i];k++)
+				if(fabs(f[p].alpha[k]) > 0)
+					nonzero[start[i]+k] = true;
+			for(k=0;k<count[j];k++)
+				if(fabs(f[p].alpha[count[i]+k]) > 0)
+					nonzero[start[j]+k] = true;
+			++p;
+		}
+
+	model->nr_class = nr_class;
+
+	model->label = Malloc(int,nr_class);
+	for(i=0;i<nr_class;i++)
+		model->label[i] = g->label[i];
+
+	model->rho = Malloc(double,nr_class*(nr_class-1)/2);
+	for(i=0;i<nr_class*(nr_class-1)/2;i++)
+		model->rho[i] = f[i].rho;
+
+	if(param->probability)
+	{
+		model->probA = Malloc(double,nr_class*(nr_class-1)/2);
+		model->probB = Malloc(double,nr_class*(nr_class-1)/2);
+		for(i=0;i<nr_class*(nr_class-1)/2;i++)
+		{
+			model->probA[i] = probA[i];
+			model->probB[i] = probB[i];
+		}
+	}
+	else
+	{
+		model->probA=NULL;
+		model->probB=NULL;
+	}
+	model->prob_density_marks=NULL;	// for one-class SVM probabilistic outputs only
+
+	int total_sv = 0;
+	int *nz_count = Malloc(int,nr_class);
+	model->nSV = Malloc(int,nr_class);
+	for(i=0;i<nr_class;i++)
+	{
+		int nSV = 0;
+		for(int j=0;j<count[i];j++)
+			if(nonzero[start[i]+j])
+			{
+				++nSV;
+				++total_sv;
+			}
+		model->nSV[i] = nSV;
+		nz_count[i] = nSV;
+	}
+
+	info("Total nSV = %d\n",total_sv);
+
+	model->l = total_sv;
+	model->SV = Malloc(svm_node *,total_sv);
+	model->sv_indices = Malloc(int,total_sv);
+	p = 0;
+	for(i=0;i<l;i++)
+		if(nonzero[i])
+		{
+			model->SV[p] = g->x[i];
+			model->sv_indices[p++] = g->perm[i] + 1;
+		}
+
+	int *nz_start = Malloc(int,nr_class);
+	nz_start[0] = 0;
+	for(i=1;i<nr_class;i++)
+		nz_start[i] = nz_start[i-1]+nz_count[i-1];
+
+	model->sv_coef = Malloc(double *,nr_class-1);
+	for(i=0;i<nr_class-1;i++)
+		model->sv_coef[i] = Malloc(double,total_sv);
+
+	p = 0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			// classifier (i,j): coefficients with
+			// i are in sv_coef[j-1][nz_start[i]...],
+			// j are in sv_coef[i][nz_start[j]...]
+
+			int si = start[i];
+			int sj = start[j];
+			int ci = count[i];
+			int cj = count[j];
+
+			int q = nz_start[i];
+			int k;
+			for(k=0;k<ci;k++)
+				if(nonzero[si+k])
+					model->sv_coef[j-1][q++] = f[p].alpha[k];
+			q = nz_start[j];
+			for(k=0;k<cj;k++)
+				if(nonzero[sj+k])
+					model->sv_coef[i][q++] = f[p].alpha[ci+k];
+			++p;
+		}
+
+	free(nonzero);
+	free(nz_count);
+	free(nz_start);
+	return model;
+}
+
+//
+// Checkpoints of svm_train_checkpoint
+//
+// A subproblem is one binary problem of classification, or the single
+// problem of regression and one-class SVM. file_name has a header naming
+// the problem, then a record appended as each subproblem finishes:
+//
+//	int pair, int len, double rho, double probA, double probB, double alpha[len]
+//
+// file_name.solver has the header and the solver_state of the subproblem
+// being solved, replaced every interval seconds. Both are binary files for
+// the machine that wrote them.
+//
+// raised whenever the layout of the files changes; 1 was the unversioned
+// layout, which had svm_type where the version is now
+#define CHECKPOINT_VERSION 2
+
+struct checkpoint_header
+{
+	char magic[8];
+	int version;
+	int svm_type;
+	int solver;
+	int kernel_type;
+	int degree;
+	int probability;
+	int shrinking;
+	int working_set_size;
+	int out_of_core;
+	int nr_landmark;
+	int landmark_iter;
+	int screening;
+	int l;
+	int nr_pair;
+	double gamma;
+	double coef0;
+	double C;
+	double nu;
+	double p;
+	double eps;
+	double cache_slack;
+	uint64_t fingerprint;	// hash of the labels, features and class weights
+};
+
+struct checkpoint
+{
+	char *file_name;
+	char *state_file_name;
+	double interval;	// seconds between saved states, <= 0 for every check
+	double last_save;
+	checkpoint_header header;
+	FILE *fp;		// file_name, appended to; NULL if it can't be written
+	int pair;		// subproblem being solved
+	bool stopped;		// it stopped early: the files keep its state from now on
+	// subproblems finished in an earlier run; alpha[p] is NULL if not
+	double **alpha;
+	int *len;
+	double *rho;
+	double *probA;
+	double *probB;
+	int state_pair;		// subproblem of state, -1 if none
+	solver_state state;
+};
+
+template <class T>
+static bool read_values(FILE *fp, T *v, int n)
+{
+	return fread(v,sizeof(T),(size_t)n,fp) == (size_t)n;
+}
+
+template <class T>
+static bool write_values(FILE *fp, const T *v, int n)
+{
+	return fwrite(v,sizeof(T),(size_t)n,fp) == (size_t)n;
+}
+
+static char *concat(const char *a, const char *b)
+{
+	char *s = Malloc(char,strlen(a)+strlen(b)+1);
+	strcpy(s,a);
+	strcat(s,b);
+	return s;
+}
+
+// put the completely written tmp_name in place of file_name
+static bool replace_file(const char *tmp_name, const char *file_name)
+{
+#ifdef _WIN32
+	remove(file_name);	// rename does not replace an existing file there
+#endif
+	return rename(tmp_name,file_name) == 0;
+}
+
+static void checkpoint_init(checkpoint *ck, const char *file_name, double interval)
+{
+	ck->file_name = concat(file_name,"");
+	ck->state_file_name = concat(file_name,".solver");
+	ck->interval = interval;
+	ck->last_save = wall_time();
+	ck->fp = NULL;
+	ck->pair = -1;
+	ck->stopped = false;
+	ck->alpha = NULL;
+	ck->len = NULL;
+	ck->rho = NULL;
+	ck->probA = NULL;
+	ck->probB = NULL;
+	ck->state_pair = -1;
+	ck->state.l = 0;
+	ck->state.active_set = NULL;
+	ck->state.alpha = NULL;
+	ck->state.G = NULL;
+	ck->state.G_bar = NULL;
+}
+
+static void checkpoint_destroy(checkpoint *ck)
+{
+	if(ck->fp != NULL)
+		fclose(ck->fp);
+	if(ck->alpha != NULL)
+		for(int p=0;p<ck->header.nr_pair;p++)
+			free(ck->alpha[p]);
+	free(ck->alpha);
+	free(ck->len);
+	free(ck->rho);
+	free(ck->probA);
+	free(ck->probB);
+	free(ck->state.active_set);
+	free(ck->state.alpha);
+	free(ck->state.G);
+	free(ck->state.G_bar);
+	free(ck->file_name);
+	free(ck->state_file_name);
+}
+
+static void checkpoint_header_init(checkpoint_header *h, const svm_problem *prob,
+	const svm_parameter *param, int nr_pair)
+{
+	memset(h,0,sizeof(checkpoint_header));	// padding too, for memcmp
+	memcpy(h->magic,"LIBSVMCK",8);
+	h->version = CHECKPOINT_VERSION;
+	h->svm_type = param->svm_type;
+	h->solver = param->solver;
+	h->kernel_type = param->kernel_type;
+	h->degree = param->degree;
+	h->probability = param->probability;
+	h->shrinking = param->shrinking;
+	h->working_set_size = param->working_set_size;
+	h->out_of_core = param->out_of_core;
+	h->nr_landmark = param->nr_landmark;
+	h->landmark_iter = param->landmark_iter;
+	h->screening = param->screening;
+	h->l = prob->l;
+	h->nr_pair = nr_pair;
+	h->gamma = param->gamma;
+	h->coef0 = param->coef0;
+	h->C = param->C;
+	h->nu = param->nu;
+	h->p = param->p;
+	h->eps = param->eps;
+	h->cache_slack = param->cache_slack;
+	// FNV-1a over the bytes, so that any change of order or value shows
+	uint64_t hash = 14695981039346656037ULL;
+	auto add = [&hash](const void *v, size_t n) {
+		for(size_t k=0;k<n;k++)
+			hash = (hash ^ ((const unsigned char *)v)[k])*1099511628211ULL;
+	};
+	int i;
+	for(i=0;i<prob->l;i++)
+	{
+		add(&prob->y[i],sizeof(double));
+		const svm_node *x = prob->x[i];
+		for(;x->index!=-1;x++)
+		{
+			add(&x->index,sizeof(int));
+			add(&x->value,sizeof(double));
+		}
+		add(&x->index,sizeof(int));	// where the row ends
+	}
+	for(i=0;i<param->nr_weight;i++)
+	{
+		add(&param->weight_label[i],sizeof(int));
+		add(&param->weight[i],sizeof(double));
+	}
+	h->fingerprint = hash;
+}
+
+static bool checkpoint_write_record(FILE *fp, int pair, int len, const double *alpha,
+	double rho, double probA, double probB)
+{
+	double v[3] = {rho, probA, probB};
+	return write_values(fp,&pair,1) && write_values(fp,&len,1) &&
+		write_values(fp,v,3) && write_values(fp,alpha,len);
+}
+
+static bool solver_state_valid(const solver_state *s)
+{
+	if(s->active_size < 0 || s->active_size > s->l || s->counter < 1 || s->iter < 0 ||
+	   s->shrink_period < 0 || s->shrink_period > 16 || s->shrink_round < 0)
+		return false;
+	vector<char> seen(s->l,0);
+	for(int i=0;i<s->l;i++)
+	{
+		int k = s->active_set[i];
+		if(k < 0 || k >= s->l || seen[k])
+			return false;
+		seen[k] = 1;
+	}
+	return true;
+}
+
+// read what an earlier run of this problem left in the files, and start
+// file_name again with the finished subproblems
+static void checkpoint_open(checkpoint *ck, const svm_problem *prob,
+	const svm_parameter *param, int nr_pair)
+{
+	checkpoint_header_init(&ck->header,prob,param,nr_pair);
+	ck->alpha = Malloc(double *,nr_pair);
+	ck->len = Malloc(int,nr_pair);
+	ck->rho = Malloc(double,nr_pair);
+	ck->probA = Malloc(double,nr_pair);
+	ck->probB = Malloc(double,nr_pair);
+	int p;
+	for(p=0;p<nr_pair;p++)
+		ck->alpha[p] = NULL;
+
+	checkpoint_header h;
+	FILE *fp = fopen(ck->file_name,"rb");
+	if(fp != NULL)
+	{
+		bool whole = read_values(fp,&h,1);
+		if(whole && memcmp(&h,&ck->header,sizeof(h)) == 0)
+		{
+			// a record cut short by a crash is dropped
+			int len;
+			double v[3];
+			while(read_values(fp,&p,1) && read_values(fp,&len,1) && read_values(fp,v,3) &&
+			      p >= 0 && p < nr_pair && len >= 0 && len <= prob->l)
+			{
+				double *alpha = Malloc(double,len);
+				if(!read_values(fp,alpha,len))
+				{
+					free(alpha);
+					break;
+				}
+				free(ck->alpha[p]);
+				ck->alpha[p] = alpha;
+				ck->len[p] = len;
+				ck->rho[p] = v[0];
+				ck->probA[p] = v[1];
+				ck->probB[p] = v[2];
+			}
+		}
+		else if(whole && memcmp(h.magic,ck->header.magic,8) == 0 && h.version != CHECKPOINT_VERSION)
+			info("WARNING: checkpoint %s has format version %d, not %d; starting over\n",
+				ck->file_name,h.version,CHECKPOINT_VERSION);
+		else
+			info("WARNING: checkpoint %s is of another problem; starting over\n",ck->file_name);
+		fclose(fp);
+	}
+
+	fp = fopen(ck->state_file_name,"rb");
+	if(fp != NULL)
+	{
+		solver_state *s = &ck->state;
+		// pair, l, iter, counter, active_size, unshrink, shrink_period, shrink_round
+		int head[8];
+		double shrink[2];
+		if(read_values(fp,&h,1) && memcmp(&h,&ck->header,sizeof(h)) == 0 &&
+		   read_values(fp,head,8) && read_values(fp,shrink,2) &&
+		   head[0] >= 0 && head[0] < nr_pair &&
+		   ck->alpha[head[0]] == NULL && head[1] > 0 && head[1] <= 2*prob->l)
+		{
+			int l = head[1];
+			s->l = l;
+			s->iter = head[2];
+			s->counter = head[3];
+			s->active_size = head[4];
+			s->unshrink = head[5];
+			s->shrink_period = head[6];
+			s->shrink_round = head[7];
+			s->shrink_saved = shrink[0];
+			s->shrink_cost = shrink[1];
+			s->active_set = Malloc(int,l);
+			s->alpha = Malloc(double,l);
+			s->G = Malloc(double,l);
+			s->G_bar = Malloc(double,l);
+			if(read_values(fp,s->active_set,l) && read_values(fp,s->alpha,l) &&
+			   read_values(fp,s->G,l) && read_values(fp,s->G_bar,l) &&
+			   solver_state_valid(s))
+				ck->state_pair = head[0];
+		}
+		fclose(fp);
+	}
+
+	// written aside and renamed, so the old file stays whole until then
+	char *tmp_name = concat(ck->file_name,".tmp");
+	fp = fopen(tmp_name,"wb");
+	bool ok = fp != NULL && write_values(fp,&ck->header,1);
+	for(p=0;p<nr_pair && ok;p++)
+		if(ck->alpha[p] != NULL)
+			ok = checkpoint_write_record(fp,p,ck->len[p],ck->alpha[p],
+				ck->rho[p],ck->probA[p],ck->probB[p]);
+	if(fp != NULL && fclose(fp) != 0)
+		ok = false;
+	if(ok && replace_file(tmp_name,ck->file_name))
+		ck->fp = fopen(ck->file_name,"ab");
+	if(ck->fp == NULL)
+		fprintf(stderr,"WARNING: can't write checkpoint %s\n",ck->file_name);
+	free(tmp_name);
+}
+
+// start subproblem pair of len variables; if an earlier run finished it,
+// take its solution and return true
+static bool checkpoint_take(checkpoint *ck, int pair, int len,
+	double **alpha, double *rho, double *probA, double *probB)
+{
+	ck->pair = pair;
+	if(ck->alpha[pair] == NULL || ck->len[pair] != len)
+		return false;
+	*alpha = ck->alpha[pair];
+	*rho = ck->rho[pair];
+	if(probA != NULL)
+	{
+		*probA = ck->probA[pair];
+		*probB = ck->probB[pair];
+	}
+	ck->alpha[pair] = NULL;
+	info("subproblem %d finished in an earlier run\n",pair);
+	return true;
+}
+
+// record the solution of the subproblem being solved
+static void checkpoint_finish(checkpoint *ck, int len, const double *alpha,
+	double rho, double probA, double probB)
+{
+	if(ck->stopped || ck->fp == NULL)
+		return;
+	if(!checkpoint_write_record(ck->fp,ck->pair,len,alpha,rho,probA,probB) ||
+	   fflush(ck->fp) != 0)
+		fprintf(stderr,"WARNING: can't write checkpoint %s\n",ck->file_name);
+	remove(ck->state_file_name);
+}
+
+static bool checkpoint_due(const checkpoint *ck)
+{
+	return !ck->stopped && ck->fp != NULL && wall_time()-ck->last_save >= ck->interval;
+}
+
+// save s, the state of the subproblem being solved; if it stopped early,
+// keep it as the one to continue from
+static void checkpoint_save_state(checkpoint *ck, const solver_state *s, bool stopped)
+{
+	if(ck->stopped || ck->fp == NULL)
+		return;
+	ck->stopped = stopped;
+	char *tmp_name = concat(ck->state_file_name,".tmp");
+	FILE *fp = fopen(tmp_name,"wb");
+	int head[8] = {ck->pair, s->l, s->iter, s->counter, s->active_size, s->unshrink,
+		s->shrink_period, s->shrink_round};
+	double shrink[2] = {s->shrink_saved, s->shrink_cost};
+	bool ok = fp != NULL && write_values(fp,&ck->header,1) && write_values(fp,head,8) &&
+		write_values(fp,shrink,2) &&
+		write_values(fp,s->active_set,s->l) && write_values(fp,s->alpha,s->l) &&
+		write_values(fp,s->G,s->l) && write_values(fp,s->G_bar,s->l);
+	if(fp != NULL && fclose(fp) != 0)
+		ok = false;
+	if(!ok || !replace_file(tmp_name,ck->state_file_name))
+		fprintf(stderr,"WARNING: can't write checkpoint %s\n",ck->state_file_name);
+	free(tmp_name);
+	ck->last_save = wall_time();
+}
+
+// the state to continue the subproblem being solved from, if it has l
+// variables; given once
+static const solver_state *checkpoint_state(checkpoint *ck, int l)
+{
+	if(ck->state_pair != ck->pair || ck->state.l != l)
+		return NULL;
+	ck->state_pair = -1;
+	info("subproblem %d continues from #iter = %d\n",ck->pair,ck->state.iter);
+	return &ck->state;
+}
+
+// an n-th of the time left, kept positive so that it still limits
+static double time_share(double left, int n)
+{
+	return max(left/n,DBL_MIN);
+}
+
+//
+// Training on a Nystrom approximation of the kernel (nr_landmark > 0)
+//
+// With landmarks u_1..u_m and K_UU = L L', the map z(x) = L^-1 k_U(x),
+// k_U(x) = (K(u_1,x),...,K(u_m,x)), gives z(x)'z(y) = k_U(x)' K_UU^-1 k_U(y),
+// the Nystrom approximation of K(x,y). The problem is mapped to z once and
+// trained with the linear kernel, so memory is O(l*m) and a column of Q
+// costs O(m). A linear solution w = sum_i y_i alpha_i z(x_i) is the kernel
+// expansion sum_k beta_k K(u_k,x) with L' beta = w, an ordinary model whose
+// SVs are the landmarks. L comes from a pivoted Cholesky factorization,
+// which leaves out landmarks (nearly) in the span of the others.
+//
+// Classification takes landmarks from each class, in proportion to its
+// size, and maps each binary problem with those of its two classes, as
+// the SVs of a class serve the decision functions of its pairs. The
+// kernel values between the instances and all landmarks are computed
+// once, and each pair factors and maps with its part of them.
+//
+struct nystrom_map
+{
+	vector<int> pivot;	// landmarks of the basis, in pivot order
+	vector<double> L;	// L[k*r+j], j <= k: their Cholesky factor
+	int r;
+};
+
+// K[i*m+k] = K(x_i,u_k) for n instances and m landmarks
+static void nystrom_kernel(svm_node *const *x, int n, svm_node *const *u, int m,
+	const svm_parameter& param, double *K)
+{
+	int i;
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic,64)
+#endif
+	for(i=0;i<n;i++)
+	{
+		PredictInstance px(x[i],param,m);
+		for(int k=0;k<m;k++)
+			K[(size_t)i*m+k] = px.k_function(u[k],param);
+	}
+}
+
+// the map of landmarks col[0..m) of K_UU, a kernel matrix of M landmarks
+static void nystrom_map_init(nystrom_map *map, const double *K_UU, int M, const int *col, int m)
+{
+	auto K = [&](int a, int b) { return K_UU[(size_t)col[a]*M+col[b]]; };
+
+	// column[k][i]: k-th Cholesky column, d[i]: what is left of K_ii
+	vector<vector<double> > column;
+	vector<double> d(m);
+	double max_d = 0;
+	int i;
+	for(i=0;i<m;i++)
+	{
+		d[i] = K(i,i);
+		max_d = max(max_d,d[i]);
+	}
+	map->pivot.clear();
+	while((int)map->pivot.size() < m)
+	{
+		int s = -1;
+		double best = 1e-10*max_d;
+		for(i=0;i<m;i++)
+			if(d[i] > best)
+			{
+				best = d[i];
+				s = i;
+			}
+		if(s == -1)
+			break;
+		int k = (int)map->pivot.size();
+		double pivot = sqrt(d[s]);
+		vector<double> c(m);
+		for(i=0;i<m;i++)
+		{
+			double v = K(s,i);
+			for(int j=0;j<k;j++)
+				v -= column[j][i]*column[j][s];
+			c[i] = v/pivot;
+		}
+		for(i=0;i<m;i++)
+			d[i] -= c[i]*c[i];
+		d[s] = 0;
+		map->pivot.push_back(s);
+		column.push_back(c);
+	}
+
+	int r = (int)map->pivot.size();
+	map->r = r;
+	map->L.assign((size_t)r*r,0);
+	for(int k=0;k<r;k++)
+		for(int j=0;j<=k;j++)
+			map->L[(size_t)k*r+j] = column[j][map->pivot[k]];
+	info("Nystrom rank %d of %d landmarks\n",r,m);
+}
+
+// rows z(x_i) of n instances, r nodes and a terminator each, from the
+// kernel values K_XU[row[i]*M+col[k]] of the instances with the landmarks
+static svm_node *nystrom_features(const nystrom_map& map, const double *K_XU, int M,
+	const int *col, const int *row, int n, svm_node **z)
+{
+	int r = map.r;
+	svm_node *z_space = Malloc(svm_node,(size_t)n*(r+1));
+	int i;
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(static)
+#endif
+	for(i=0;i<n;i++)
+	{
+		svm_node *zi = &z_space[(size_t)i*(r+1)];
+		const double *k_x = &K_XU[(size_t)row[i]*M];
+		for(int k=0;k<r;k++)
+		{
+			const double *Lk = &map.L[(size_t)k*r];
+			double v = k_x[col[map.pivot[k]]];
+			for(int j=0;j<k;j++)
+				v -= Lk[j]*zi[j].value;
+			zi[k].index = k+1;
+			zi[k].value = v/Lk[k];
+		}
+		zi[r].index = -1;
+		z[i] = zi;
+	}
+	return z_space;
+}
+
+// beta[0..m) of the kernel expansion of a linear model trained on z
+static void nystrom_beta(const nystrom_map& map, const svm_model *linear, int m, double *beta)
+{
+	int r = map.r;
+	vector<double> w(r,0), b(r);
+	for(int s=0;s<linear->l;s++)
+		for(const svm_node *p = linear->SV[s]; p->index != -1; ++p)
+			w[p->index-1] += linear->sv_coef[0][s]*p->value;
+	for(int k=r-1;k>=0;k--)
+	{
+		double v = w[k];
+		for(int j=k+1;j<r;j++)
+			v -= map.L[(size_t)j*r+k]*b[j];
+		b[k] = v/map.L[(size_t)k*r+k];
+	}
+	for(int i=0;i<m;i++)
+		beta[i] = 0;
+	for(int k=0;k<r;k++)
+		beta[map.pivot[k]] = b[k];
+}
+
+// m landmarks among x[0..n): a uniform sample drawn with a generator
+// seeded by seed, moved by landmark_iter iterations of k-means. Landmarks
+// that are not rows of x are allocated and listed in owned; source[k] is
+// the row of x a landmark is, or -1.
+static void nystrom_landmarks(svm_node *const *x, int n, int m, int landmark_iter, unsigned seed,
+	svm_node **u, int *source, vector<svm_node *>& owned)
+{
+	int i, k;
+	std::minstd_rand rng(seed);
+	vector<int> perm(n);
+	for(i=0;i<n;i++)
+		perm[i] = i;
+	for(k=0;k<m;k++)
+	{
+		int j = k+random_below(&rng,n-k);
+		swap(perm[k],perm[j]);
+		u[k] = x[perm[k]];
+		source[k] = perm[k];
+	}
+	if(landmark_iter == 0)
+		return;
+
+	// centers stay sparse: together they have at most the nonzeros of
+	// the instances, whatever the dimension
+	vector<vector<svm_node> > center(m);
+	vector<double> center_square(m), x_square(n,0);
+	vector<int> x_len(n,0);
+	for(k=0;k<m;k++)
+		for(const svm_node *p = u[k]; ; ++p)
+		{
+			center[k].push_back(*p);
+			if(p->index == -1)
+				break;
+		}
+	for(i=0;i<n;i++)
+		for(const svm_node *p = x[i]; p->index != -1; ++p)
+		{
+			x_square[i] += p->value*p->value;
+			++x_len[i];
+		}
+	vector<int> assign(n,-1);
+	for(int iter=0;iter<landmark_iter;iter++)
+	{
+		for(k=0;k<m;k++)
+		{
+			double sum = 0;
+			for(const svm_node *p = center[k].data(); p->index != -1; ++p)
+				sum += p->value*p->value;
+			center_square[k] = sum;
+		}
+		int changed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic,64) reduction(+:changed)
+#endif
+		for(i=0;i<n;i++)
+		{
+			int best = 0;
+			double best_d = INF;
+			for(int c=0;c<m;c++)
+			{
+				double dot = intersect(x[i],x_len[i],center[c].data(),(int)center[c].size()-1);
+				double dist = x_square[i]-2*dot+center_square[c];
+				if(dist < best_d)
+				{
+					best_d = dist;
+					best = c;
+				}
+			}
+			if(assign[i] != best)
+			{
+				assign[i] = best;
+				++changed;
+			}
+		}
+		if(changed == 0)
+			break;
+
+		// members of each cluster, then their nonzeros summed by index;
+		// an empty cluster keeps its center
+		vector<int> start(m+1,0), member(n);
+		for(i=0;i<n;i++)
+			++start[assign[i]+1];
+		for(k=0;k<m;k++)
+			start[k+1] += start[k];
+		{
+			vector<int> next(start.begin(),start.end()-1);
+			for(i=0;i<n;i++)
+				member[next[assign[i]]++] = i;
+		}
+		vector<svm_node> nodes;
+		for(k=0;k<m;k++)
+		{
+			int count = start[k+1]-start[k];
+			if(count == 0)
+				continue;
+			nodes.clear();
+			for(int t=start[k];t<start[k+1];t++)
+				nodes.insert(nodes.end(),x[member[t]],x[member[t]]+x_len[member[t]]);
+			std::sort(nodes.begin(),nodes.end(),
+				[](const svm_node& a, const svm_node& b) { return a.index < b.index; });
+			vector<svm_node>& c = center[k];
+			c.clear();
+			for(size_t t=0;t<nodes.size();)
+			{
+				svm_node sum = nodes[t];
+				for(++t; t < nodes.size() && nodes[t].index == sum.index; ++t)
+					sum.value += nodes[t].value;
+				sum.value /= count;
+				if(sum.value != 0)
+					c.push_back(sum);
+			}
+			svm_node end = {-1,0};
+			c.push_back(end);
+		}
+	}
+
+	for(k=0;k<m;k++)
+	{
+		svm_node *row = Malloc(svm_node,center[k].size());
+		memcpy(row,center[k].data(),sizeof(svm_node)*center[k].size());
+		u[k] = row;
+		source[k] = -1;
+		owned.push_back(row);
+	}
+}
+
+// copy the SVs of model into one block the model owns
+static void model_own_svs(svm_model *model)
+{
+	size_t elements = 0;
+	int i;
+	for(i=0;i<model->l;i++)
+		for(const svm_node *p = model->SV[i]; ; ++p)
+		{
+			++elements;
+			if(p->index == -1)
+				break;
+		}
+	svm_node *x_space = model->l > 0 ? Malloc(svm_node,elements) : NULL;
+	size_t n = 0;
+	for(i=0;i<model->l;i++)
+	{
+		const svm_node *p = model->SV[i];
+		model->SV[i] = &x_space[n];
+		for(; ; ++p)
+		{
+			x_space[n++] = *p;
+			if(p->index == -1)
+				break;
+		}
+	}
+	model->free_sv = 1;
+}
+
+static svm_model *svm_train_model(const svm_problem *prob, const svm_parameter *param,
+	int nr_init, const svm_model *const *init_model, checkpoint *ck);
+static svm_model *svm_train_screened(const svm_problem *prob, const svm_parameter *param);
+
+static svm_model *svm_train_nystrom(const svm_problem *prob, const svm_parameter *param)
+{
+	svm_parameter param_z = *param;
+	param_z.kernel_type = LINEAR;
+	param_z.nr_landmark = 0;
+	param_z.landmark_iter = 0;
+	vector<svm_node *> owned;
+	svm_model *model;
+	int i, k;
+
+	if(param->svm_type == ONE_CLASS ||
+	   param->svm_type == EPSILON_SVR ||
+	   param->svm_type == NU_SVR)
+	{
+		int l = prob->l;
+		int m = min(param->nr_landmark,l);
+		vector<svm_node *> u(m);
+		vector<int> source(m);
+		nystrom_landmarks(prob->x,l,m,param->landmark_iter,1,u.data(),source.data(),owned);
+		vector<double> K_UU((size_t)m*m), K_XU((size_t)l*m);
+		nystrom_kernel(u.data(),m,u.data(),m,*param,K_UU.data());
+		nystrom_kernel(prob->x,l,u.data(),m,*param,K_XU.data());
+		vector<int> col(m), row(l);
+		for(k=0;k<m;k++)
+			col[k] = k;
+		for(i=0;i<l;i++)
+			row[i] = i;
+		nystrom_map map;
+		nystrom_map_init(&map,K_UU.data(),m,col.data(),m);
+
+		svm_problem z_prob = {l, prob->y, Malloc(svm_node *,l)};
+		svm_node *z_space = nystrom_features(map,K_XU.data(),m,col.data(),row.data(),l,z_prob.x);
+		svm_model *linear = svm_train_model(&z_prob,&param_z,0,NULL,NULL);
+
+		decision_function f;
+		f.alpha = Malloc(double,m);
+		f.rho = linear->rho[0];
+		nystrom_beta(map,linear,m,f.alpha);
+		svm_problem u_prob = {m, NULL, u.data()};
+		svm_parameter param_m = *param;
+		param_m.probability = 0;
+		model = svm_build_one_model(&u_prob,&param_m,f);
+		model->param = *param;
+		for(i=0;i<model->l;i++)
+			model->sv_indices[i] = source[model->sv_indices[i]-1]+1;
+		if(linear->probA)
+		{
+			model->probA = Malloc(double,1);
+			model->probA[0] = linear->probA[0];
+		}
+		if(linear->prob_density_marks)
+		{
+			model->prob_density_marks = Malloc(double,10);
+			memcpy(model->prob_density_marks,linear->prob_density_marks,sizeof(double)*10);
+		}
+		free(f.alpha);
+		svm_free_and_destroy_model(&linear);
+		free(z_space);
+		free(z_prob.x);
+	}
+	else
+	{
+		class_groups g;
+		class_groups_init(&g,prob);
+		int nr_class = g.nr_class;
+		int nr_pair = nr_class*(nr_class-1)/2;
+		double *weighted_C = class_groups_weighted_C(&g,param);
+
+		// the landmarks, grouped by class like the instances in g
+		class_groups ug;
+		ug.nr_class = nr_class;
+		ug.label = Malloc(int,nr_class);
+		ug.start = Malloc(int,nr_class);
+		ug.count = Malloc(int,nr_class);
+		ug.l = 0;
+		for(int c=0;c<nr_class;c++)
+		{
+			ug.label[c] = g.label[c];
+			ug.start[c] = ug.l;
+			ug.count[c] = min(g.count[c],max(1,(int)((double)param->nr_landmark*g.count[c]/g.l+0.5)));
+			ug.l += ug.count[c];
+		}
+		ug.x = Malloc(svm_node *,ug.l);
+		ug.perm = Malloc(int,ug.l);
+		for(int c=0;c<nr_class;c++)
+		{
+			nystrom_landmarks(&g.x[g.start[c]],g.count[c],ug.count[c],param->landmark_iter,c+1,
+				&ug.x[ug.start[c]],&ug.perm[ug.start[c]],owned);
+			for(k=ug.start[c];k<ug.start[c]+ug.count[c];k++)
+				if(ug.perm[k] >= 0)
+					ug.perm[k] = g.perm[g.start[c]+ug.perm[k]];
+		}
+
+		// kernel values of all instances with all landmarks, shared by the pairs
+		int M = ug.l;
+		vector<double> K_UU((size_t)M*M), K_XU((size_t)g.l*M);
+		nystrom_kernel(ug.x,M,ug.x,M,*param,K_UU.data());
+		nystrom_kernel(g.x,g.l,ug.x,M,*param,K_XU.data());
+
+		decision_function *f = Malloc(decision_function,nr_pair);
+		double *probA = NULL, *probB = NULL;
+		if(param->probability)
+		{
+			probA = Malloc(double,nr_pair);
+			probB = Malloc(double,nr_pair);
 		}
+		double start_time = wall_time();
+		int p = 0;
+		for(i=0;i<nr_class;i++)
+			for(int j=i+1;j<nr_class;j++)
+			{
+				svm_problem sub_prob;
+				class_groups_pair(&g,i,j,&sub_prob);
+				// landmarks and instances of class i, then of class j
+				int m = ug.count[i]+ug.count[j];
+				vector<int> col(m), row(sub_prob.l);
+				for(k=0;k<ug.count[i];k++)
+					col[k] = ug.start[i]+k;
+				for(k=0;k<ug.count[j];k++)
+					col[ug.count[i]+k] = ug.start[j]+k;
+				for(k=0;k<g.count[i];k++)
+					row[k] = g.start[i]+k;
+				for(k=0;k<g.count[j];k++)
+					row[g.count[i]+k] = g.start[j]+k;
+				nystrom_map map;
+				nystrom_map_init(&map,K_UU.data(),M,col.data(),m);
+
+				svm_problem z_prob = {sub_prob.l, sub_prob.y, Malloc(svm_node *,sub_prob.l)};
+				svm_node *z_space = nystrom_features(map,K_XU.data(),M,col.data(),row.data(),sub_prob.l,z_prob.x);
+				// the binary problem has labels +1 for class i and -1 for j
+				int weight_label[2] = {+1, -1};
+				double weight[2] = {weighted_C[i]/param->C, weighted_C[j]/param->C};
+				svm_parameter param_p = param_z;
+				param_p.nr_weight = 2;
+				param_p.weight_label = weight_label;
+				param_p.weight = weight;
+				if(param->max_time > 0)
+					param_p.max_time = time_share(param->max_time-(wall_time()-start_time),nr_pair-p);
+				svm_model *linear = svm_train_model(&z_prob,&param_p,0,NULL,NULL);
+
+				f[p].alpha = Malloc(double,m);
+				f[p].rho = linear->rho[0];
+				nystrom_beta(map,linear,m,f[p].alpha);
+				if(param->probability)
+				{
+					probA[p] = linear->probA[0];
+					probB[p] = linear->probB[0];
+				}
+				svm_free_and_destroy_model(&linear);
+				free(z_space);
+				free(z_prob.x);
+				free(sub_prob.x);
+				free(sub_prob.y);
+				++p;
+			}
 
-		free(f.alpha);
+		model = svm_build_class_model(&ug,param,f,probA,probB);
+
+		free(probA);
+		free(probB);
+		free(weighted_C);
+		for(p=0;p<nr_pair;p++)
+			free(f[p].alpha);
+		free(f);
+		class_groups_destroy(&ug);
+		class_groups_destroy(&g);
 	}
-	else
-	{
-		// classification
-		int l = prob->l;
-		int nr_class;
-		int *label = NULL;
-		int *start = NULL;
-		int *count = NULL;
-		int *perm = Malloc(int,l);
 
-		// group training data of the same class
-		svm_group_classes(prob,&nr_class,&label,&start,&count,perm);
-		if(nr_class == 1)
-			info("WARNING: training data in only one class. See README for details.\n");
+	// k-means landmarks are no rows of prob: their sv_indices are 0
+	if(!owned.empty())
+	{
+		model_own_svs(model);
+		for(svm_node *row : owned)
+			free(row);
+	}
+	return model;
+}
 
-		svm_node **x = Malloc(svm_node *,l);
-		int i;
-		for(i=0;i<l;i++)
-			x[i] = prob->x[perm[i]];
+static svm_model *svm_train_model(const svm_problem *prob, const svm_parameter *param,
+	int nr_init, const svm_model *const *init_model, checkpoint *ck)
+{
+	if(param->nr_landmark > 0)
+		return svm_train_nystrom(prob,param);
+	if(param->screening > 0 && nr_init == 0 && ck == NULL)
+		return svm_train_screened(prob,param);
 
-		// calculate weighted C
+	svm_model *model;
+	warm_start ws;
+	bool warm = warm_start_init(&ws,prob,param,nr_init,init_model);
 
-		double *weighted_C = Malloc(double, nr_class);
-		for(i=0;i<nr_class;i++)
-			weighted_C[i] = param->C;
-		for(i=0;i<param->nr_weight;i++)
+	if(param->svm_type == ONE_CLASS ||
+	   param->svm_type == EPSILON_SVR ||
+	   param->svm_type == NU_SVR)
+	{
+		// regression or one-class-svm
+		decision_function f;
+		if(ck != NULL)
+			checkpoint_open(ck,prob,param,1);
+		if(ck == NULL || !checkpoint_take(ck,0,prob->l,&f.alpha,&f.rho,NULL,NULL))
 		{
-			int j;
-			for(j=0;j<nr_class;j++)
-				if(param->weight_label[i] == label[j])
-					break;
-			if(j == nr_class)
-				fprintf(stderr,"WARNING: class label %d specified in weight is not found\n", param->weight_label[i]);
-			else
-				weighted_C[j] *= param->weight[i];
+			double *init_alpha = NULL;
+			if(warm)
+			{
+				init_alpha = Malloc(double,prob->l);
+				for(int i=0;i<prob->l;i++)
+					init_alpha[i] = warm_start_alpha(&ws,i,0,0);
+			}
+			// SVR probability runs a 5-fold cross validation afterwards
+			svm_parameter param_f = *param;
+			if(param->probability && param->svm_type != ONE_CLASS)
+				param_f.max_time = param->max_time/6;
+			f = svm_train_one(prob,&param_f,0,0,init_alpha,NULL,ck);
+			free(init_alpha);
+			if(ck != NULL)
+				checkpoint_finish(ck,prob->l,f.alpha,f.rho,0,0);
 		}
+		model = svm_build_one_model(prob,param,f);
+		free(f.alpha);
+	}
+	else
+	{
+		// classification
+		class_groups g;
+		class_groups_init(&g,prob);
+		int nr_class = g.nr_class;
+		double *weighted_C = class_groups_weighted_C(&g,param);
 
 		// train k*(k-1)/2 models
 
-		bool *nonzero = Malloc(bool,l);
-		for(i=0;i<l;i++)
-			nonzero[i] = false;
 		decision_function *f = Malloc(decision_function,nr_class*(nr_class-1)/2);
 
 		double *probA=NULL,*probB=NULL;
@@ -2267,38 +6261,52 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 			probB=Malloc(double,nr_class*(nr_class-1)/2);
 		}
 
-		int p = 0;
+		int nr_pair = nr_class*(nr_class-1)/2;
+		if(ck != NULL)
+			checkpoint_open(ck,prob,param,nr_pair);
+		double start_time = wall_time();
+		int i, p = 0;
 		for(i=0;i<nr_class;i++)
 			for(int j=i+1;j<nr_class;j++)
 			{
-				svm_problem sub_prob;
-				int si = start[i], sj = start[j];
-				int ci = count[i], cj = count[j];
-				sub_prob.l = ci+cj;
-				sub_prob.x = Malloc(svm_node *,sub_prob.l);
-				sub_prob.y = Malloc(double,sub_prob.l);
-				int k;
-				for(k=0;k<ci;k++)
-				{
-					sub_prob.x[k] = x[si+k];
-					sub_prob.y[k] = +1;
-				}
-				for(k=0;k<cj;k++)
+				if(ck != NULL && checkpoint_take(ck,p,g.count[i]+g.count[j],&f[p].alpha,&f[p].rho,
+				   probA ? &probA[p] : NULL,probB ? &probB[p] : NULL))
 				{
-					sub_prob.x[ci+k] = x[sj+k];
-					sub_prob.y[ci+k] = -1;
+					++p;
+					continue;
 				}
 
+				svm_problem sub_prob;
+				class_groups_pair(&g,i,j,&sub_prob);
+
+				// each binary problem gets an even share of the time left
+				svm_parameter param_p = *param;
+				double pair_start = wall_time();
+				if(param->max_time > 0)
+					param_p.max_time = time_share(param->max_time-(pair_start-start_time),nr_pair-p);
+
 				if(param->probability)
-					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
+					svm_binary_svc_probability(&sub_prob,&param_p,weighted_C[i],weighted_C[j],probA[p],probB[p],p+1);
+				if(param->max_time > 0)
+					param_p.max_time = time_share(param_p.max_time-(wall_time()-pair_start),1);
 
-				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j]);
-				for(k=0;k<ci;k++)
-					if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
-						nonzero[si+k] = true;
-				for(k=0;k<cj;k++)
-					if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
-						nonzero[sj+k] = true;
+				double *init_alpha = NULL;
+				if(warm)
+				{
+					int si = g.start[i], sj = g.start[j];
+					int ci = g.count[i], cj = g.count[j];
+					init_alpha = Malloc(double,sub_prob.l);
+					int k;
+					for(k=0;k<ci;k++)
+						init_alpha[k] = warm_start_alpha(&ws,g.perm[si+k],g.label[i],g.label[j]);
+					for(k=0;k<cj;k++)
+						init_alpha[ci+k] = warm_start_alpha(&ws,g.perm[sj+k],g.label[i],g.label[j]);
+				}
+				f[p] = svm_train_one(&sub_prob,&param_p,weighted_C[i],weighted_C[j],init_alpha,NULL,ck);
+				free(init_alpha);
+				if(ck != NULL)
+					checkpoint_finish(ck,sub_prob.l,f[p].alpha,f[p].rho,
+						probA ? probA[p] : 0,probB ? probB[p] : 0);
 				free(sub_prob.x);
 				free(sub_prob.y);
 				++p;
@@ -2306,116 +6314,672 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 
 		// build output
 
-		model->nr_class = nr_class;
-
-		model->label = Malloc(int,nr_class);
-		for(i=0;i<nr_class;i++)
-			model->label[i] = label[i];
+		model = svm_build_class_model(&g,param,f,probA,probB);
 
-		model->rho = Malloc(double,nr_class*(nr_class-1)/2);
+		free(probA);
+		free(probB);
+		free(weighted_C);
 		for(i=0;i<nr_class*(nr_class-1)/2;i++)
-			model->rho[i] = f[i].rho;
+			free(f[i].alpha);
+		free(f);
+		class_groups_destroy(&g);
+	}
+	warm_start_destroy(&ws);
+	return model;
+}
 
-		if(param->probability)
+// the model of a training call, NULL if it was cancelled
+static svm_model *unless_cancelled(const progress_scope& scope, svm_model *model)
+{
+	if(scope.cancelled())
+		svm_free_and_destroy_model(&model);
+	return model;
+}
+
+svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
+{
+	progress_scope scope;
+	return unless_cancelled(scope,svm_train_model(prob,param,0,NULL,NULL));
+}
+
+// screening trains from scratch and keeps no checkpoint of its rounds
+static bool screening_unsupported(const svm_parameter *param, const char *what)
+{
+	if(param->screening <= 0)
+		return false;
+	fprintf(stderr,"ERROR: screening is not supported with %s\n",what);
+	return true;
+}
+
+svm_model *svm_train_warm(const svm_problem *prob, const svm_parameter *param,
+	const svm_model *init_model)
+{
+	if(init_model != NULL && screening_unsupported(param,"a warm start"))
+		return NULL;
+	progress_scope scope;
+	return unless_cancelled(scope,svm_train_model(prob,param,init_model ? 1 : 0,&init_model,NULL));
+}
+
+svm_model *svm_train_checkpoint(const svm_problem *prob, const svm_parameter *param,
+	const char *checkpoint_file_name, double interval)
+{
+	if(screening_unsupported(param,"checkpoints"))
+		return NULL;
+	progress_scope scope;
+	checkpoint ck;
+	checkpoint_init(&ck,checkpoint_file_name,interval);
+	svm_model *model = svm_train_model(prob,param,0,NULL,&ck);
+	checkpoint_destroy(&ck);
+	return unless_cancelled(scope,model);
+}
+
+// parameter of the nr-th model on a path: values are C, or nu for
+// NU_SVC and ONE_CLASS
+static svm_parameter path_parameter(const svm_parameter *param, const double *values, int nr)
+{
+	svm_parameter param_v = *param;
+	if(param->svm_type == NU_SVC || param->svm_type == ONE_CLASS)
+		param_v.nu = values[nr];
+	else
+		param_v.C = values[nr];
+	return param_v;
+}
+
+static void svm_train_path_models(const svm_problem *prob, const svm_parameter *param,
+	int nr_value, const double *values, svm_model **models)
+{
+	int v;
+	if(param->nr_landmark > 0)
+	{
+		// Nystrom models are trained one value at a time
+		for(v=0;v<nr_value;v++)
+		{
+			svm_parameter param_v = path_parameter(param,values,v);
+			models[v] = svm_train(prob,&param_v);
+		}
+		return;
+	}
+	path_matrix pm = {NULL, NULL};
+
+	if(param->svm_type == ONE_CLASS ||
+	   param->svm_type == EPSILON_SVR ||
+	   param->svm_type == NU_SVR)
+	{
+		decision_function prev = {NULL, 0};
+		for(v=0;v<nr_value;v++)
 		{
-			model->probA = Malloc(double,nr_class*(nr_class-1)/2);
-			model->probB = Malloc(double,nr_class*(nr_class-1)/2);
-			for(i=0;i<nr_class*(nr_class-1)/2;i++)
+			svm_parameter param_v = path_parameter(param,values,v);
+			decision_function f = svm_train_one(prob,&param_v,0,0,prev.alpha,&pm,NULL);
+			models[v] = svm_build_one_model(prob,&param_v,f);
+			free(prev.alpha);
+			prev = f;
+		}
+		free(prev.alpha);
+		path_matrix_destroy(&pm);
+		return;
+	}
+
+	class_groups g;
+	class_groups_init(&g,prob);
+	int nr_class = g.nr_class;
+	int nr_pair = nr_class*(nr_class-1)/2;
+
+	// solve each binary problem along the whole path with one kernel
+	// matrix before moving on to the next, so only one cache is alive
+
+	decision_function *f = Malloc(decision_function,nr_value*nr_pair);
+	double **weighted_C = Malloc(double *,nr_value);
+	double *probA = NULL, *probB = NULL;
+	if(param->probability)
+	{
+		probA = Malloc(double,nr_value*nr_pair);
+		probB = Malloc(double,nr_value*nr_pair);
+	}
+	svm_parameter *param_v = Malloc(svm_parameter,nr_value);
+	for(v=0;v<nr_value;v++)
+	{
+		param_v[v] = path_parameter(param,values,v);
+		weighted_C[v] = class_groups_weighted_C(&g,&param_v[v]);
+	}
+
+	int i, p = 0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			svm_problem sub_prob;
+			class_groups_pair(&g,i,j,&sub_prob);
+			for(v=0;v<nr_value;v++)
 			{
-				model->probA[i] = probA[i];
-				model->probB[i] = probB[i];
+				int q = v*nr_pair+p;
+				if(param->probability)
+					svm_binary_svc_probability(&sub_prob,&param_v[v],weighted_C[v][i],weighted_C[v][j],probA[q],probB[q],p+1);
+				f[q] = svm_train_one(&sub_prob,&param_v[v],weighted_C[v][i],weighted_C[v][j],
+					v > 0 ? f[q-nr_pair].alpha : NULL,&pm,NULL);
 			}
+			path_matrix_destroy(&pm);
+			free(sub_prob.x);
+			free(sub_prob.y);
+			++p;
 		}
-		else
+
+	for(v=0;v<nr_value;v++)
+		models[v] = svm_build_class_model(&g,&param_v[v],&f[v*nr_pair],
+			probA ? &probA[v*nr_pair] : NULL,probB ? &probB[v*nr_pair] : NULL);
+
+	for(v=0;v<nr_value;v++)
+		free(weighted_C[v]);
+	free(weighted_C);
+	for(i=0;i<nr_value*nr_pair;i++)
+		free(f[i].alpha);
+	free(f);
+	free(probA);
+	free(probB);
+	free(param_v);
+	class_groups_destroy(&g);
+}
+
+void svm_train_path(const svm_problem *prob, const svm_parameter *param,
+	int nr_value, const double *values, svm_model **models)
+{
+	if(nr_value <= 0)
+		return;
+	if(screening_unsupported(param,"a regularization path"))
+	{
+		for(int v=0;v<nr_value;v++)
+			models[v] = NULL;
+		return;
+	}
+	progress_scope scope;
+	svm_train_path_models(prob,param,nr_value,values,models);
+	for(int v=0;v<nr_value;v++)
+		models[v] = unless_cancelled(scope,models[v]);
+}
+
+//
+// Cascade training (Graf et al., 2005)
+//
+// The instances are split into partitions, an SVM is trained on each, and
+// the SVs of neighbouring partitions are merged level by level, each merged
+// problem warm started from the two models below it. Feedback passes add the
+// instances the top model misclassifies by the optimality conditions and
+// train again until none are left.
+//
+struct cascade_node
+{
+	int l;
+	int *index;		// index[0,l): instances of prob in this node
+	svm_model *model;	// trained on them; sv_indices refer to index
+	int nr_init;
+	svm_model *init[2];	// warm start of a node not yet trained
+};
+
+static void cascade_train(const svm_problem *prob, const svm_parameter *param, cascade_node *node)
+{
+	svm_problem sub_prob;
+	sub_prob.l = node->l;
+	sub_prob.x = Malloc(svm_node *,node->l);
+	sub_prob.y = Malloc(double,node->l);
+	for(int i=0;i<node->l;i++)
+	{
+		sub_prob.x[i] = prob->x[node->index[i]];
+		sub_prob.y[i] = prob->y[node->index[i]];
+	}
+	node->model = svm_train_model(&sub_prob,param,node->nr_init,node->init,NULL);
+	for(int k=0;k<node->nr_init;k++)
+		svm_free_and_destroy_model(&node->init[k]);
+	node->nr_init = 0;
+	free(sub_prob.x);
+	free(sub_prob.y);
+}
+
+// train the nodes without a model, each on one thread
+static void cascade_train_level(const svm_problem *prob, const svm_parameter *param,
+	cascade_node *node, int nr_node)
+{
+	int k;
+	unsigned epoch = progress_scope().epoch();
+#ifdef _OPENMP
+#pragma omp parallel for private(k) schedule(dynamic) if(nr_node > 1)
+#endif
+	for(k=0;k<nr_node;k++)
+		if(node[k].model == NULL)
 		{
-			model->probA=NULL;
-			model->probB=NULL;
+			progress_scope scope(epoch);
+			cascade_train(prob,param,&node[k]);
 		}
-		model->prob_density_marks=NULL;	// for one-class SVM probabilistic outputs only
+}
 
-		int total_sv = 0;
-		int *nz_count = Malloc(int,nr_class);
-		model->nSV = Malloc(int,nr_class);
-		for(i=0;i<nr_class;i++)
+// to = SVs of the models in from[0,nr_from), then extra[0,nr_extra); the
+// models become the warm start of to, with sv_indices moved into to->index
+static void cascade_merge(cascade_node *from, int nr_from, const int *extra, int nr_extra,
+	cascade_node *to)
+{
+	int k, n = 0;
+	to->l = nr_extra;
+	for(k=0;k<nr_from;k++)
+		to->l += from[k].model->l;
+	to->index = Malloc(int,to->l);
+	to->model = NULL;
+	to->nr_init = nr_from;
+	for(k=0;k<nr_from;k++)
+	{
+		svm_model *model = from[k].model;
+		for(int s=0;s<model->l;s++)
 		{
-			int nSV = 0;
-			for(int j=0;j<count[i];j++)
-				if(nonzero[start[i]+j])
-				{
-					++nSV;
-					++total_sv;
-				}
-			model->nSV[i] = nSV;
-			nz_count[i] = nSV;
+			to->index[n] = from[k].index[model->sv_indices[s]-1];
+			model->sv_indices[s] = ++n;
+		}
+		to->init[k] = model;
+		free(from[k].index);
+	}
+	for(k=0;k<nr_extra;k++)
+		to->index[n++] = extra[k];
+}
+
+// how far instance i is from violating the optimality conditions of model
+// with alpha_i = 0: min y_i f(x_i) - 1 against each other class for C_SVC,
+// p - |y_i - f(x_i)| for EPSILON_SVR; negative if it violates them
+static double kkt_slack(const svm_problem *prob, const svm_parameter *param,
+	const svm_model *model, int i)
+{
+	if(param->svm_type == EPSILON_SVR)
+	{
+		double dec;
+		svm_predict_values(model,prob->x[i],&dec);
+		return param->p - fabs(prob->y[i]-dec);
+	}
+	int nr_class = model->nr_class;
+	int c;
+	for(c=0;c<nr_class;c++)
+		if(model->label[c] == (int)prob->y[i])
+			break;
+	if(c == nr_class)
+		return -HUGE_VAL;
+	double *dec_values = Malloc(double,nr_class*(nr_class-1)/2);
+	svm_predict_values(model,prob->x[i],dec_values);
+	double slack = HUGE_VAL;
+	int p = 0;
+	for(int a=0;a<nr_class;a++)
+		for(int b=a+1;b<nr_class;b++,p++)
+		{
+			if(a == c)
+				slack = min(slack,dec_values[p]-1);
+			if(b == c)
+				slack = min(slack,-dec_values[p]-1);
 		}
+	free(dec_values);
+	return slack;
+}
+
+// instances outside the training set of model whose kkt_slack is below
+// -tolerance
+static int cascade_violators(const svm_problem *prob, const svm_parameter *param,
+	const svm_model *model, const char *in_set, double tolerance, int *violator)
+{
+	int l = prob->l;
+	char *violates = Malloc(char,l);
+	int i;
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic,64)
+#endif
+	for(i=0;i<l;i++)
+		violates[i] = !in_set[i] && kkt_slack(prob,param,model,i) < -tolerance;
+	int n = 0;
+	for(i=0;i<l;i++)
+		if(violates[i])
+			violator[n++] = i;
+	free(violates);
+	return n;
+}
+
+svm_model *svm_train_cascade(const svm_problem *prob, const svm_parameter *param,
+	int nr_partition, int nr_feedback)
+{
+	progress_scope scope;
+	int l = prob->l;
+	if(nr_partition > l)
+		nr_partition = l;
+	if(nr_partition <= 1 || param->nr_landmark > 0 ||
+	   (param->svm_type != C_SVC && param->svm_type != EPSILON_SVR))
+	{
+		if(nr_partition > 1)
+			info("WARNING: cascade training supports C-SVC and epsilon-SVR with the exact kernel only; training the whole problem\n");
+		return unless_cancelled(scope,svm_train(prob,param));
+	}
 
-		info("Total nSV = %d\n",total_sv);
+	// probability outputs are fitted once, on the final training set
+	svm_parameter sub_param = *param;
+	sub_param.probability = 0;
 
-		model->l = total_sv;
-		model->SV = Malloc(svm_node *,total_sv);
-		model->sv_indices = Malloc(int,total_sv);
-		p = 0;
+	// partitions: each class dealt round robin so all keep the class ratio
+	int i, k;
+	int *perm = Malloc(int,l);
+	if(param->svm_type == C_SVC)
+	{
+		int nr_class, *label = NULL, *start = NULL, *count = NULL;
+		svm_group_classes(prob,&nr_class,&label,&start,&count,perm);
+		free(label);
+		free(start);
+		free(count);
+	}
+	else
 		for(i=0;i<l;i++)
-			if(nonzero[i])
-			{
-				model->SV[p] = x[i];
-				model->sv_indices[p++] = perm[i] + 1;
-			}
+			perm[i] = i;
 
-		int *nz_start = Malloc(int,nr_class);
-		nz_start[0] = 0;
-		for(i=1;i<nr_class;i++)
-			nz_start[i] = nz_start[i-1]+nz_count[i-1];
+	vector<cascade_node> level(nr_partition);
+	for(k=0;k<nr_partition;k++)
+	{
+		level[k].l = (l-k+nr_partition-1)/nr_partition;
+		level[k].index = Malloc(int,level[k].l);
+		level[k].model = NULL;
+		level[k].nr_init = 0;
+	}
+	for(i=0;i<l;i++)
+		level[i%nr_partition].index[i/nr_partition] = perm[i];
+	free(perm);
+	cascade_train_level(prob,&sub_param,level.data(),nr_partition);
+
+	while(level.size() > 1)
+	{
+		int nr_node = (int)level.size();
+		vector<cascade_node> next((nr_node+1)/2);
+		for(k=0;k+1<nr_node;k+=2)
+			cascade_merge(&level[k],2,NULL,0,&next[k/2]);
+		if(nr_node%2 == 1)
+			next.back() = level.back();
+		info("cascade: %d models\n",(int)next.size());
+		cascade_train_level(prob,&sub_param,next.data(),(int)next.size());
+		level.swap(next);
+	}
+	cascade_node top = level[0];
+
+	char *in_set = Malloc(char,l);
+	int *violator = Malloc(int,l);
+	for(int f=0;f<nr_feedback && !training_cancelled();f++)
+	{
+		for(i=0;i<l;i++)
+			in_set[i] = 0;
+		for(i=0;i<top.l;i++)
+			in_set[top.index[i]] = 1;
+		int nr_violator = cascade_violators(prob,param,top.model,in_set,param->eps,violator);
+		info("cascade feedback %d: %d violators\n",f+1,nr_violator);
+		if(nr_violator == 0)
+			break;
+		cascade_node next;
+		cascade_merge(&top,1,violator,nr_violator,&next);
+		cascade_train(prob,&sub_param,&next);
+		top = next;
+	}
+	free(in_set);
+	free(violator);
+
+	if(param->probability)
+	{
+		cascade_node next;
+		cascade_merge(&top,1,NULL,0,&next);
+		cascade_train(prob,param,&next);
+		top = next;
+	}
+
+	svm_model *model = top.model;
+	model->param = *param;
+	for(k=0;k<model->l;k++)
+		model->sv_indices[k] = top.index[model->sv_indices[k]-1]+1;
+	free(top.index);
+	return unless_cancelled(scope,model);
+}
+
+//
+// Screening of likely non-SVs (screening > 0)
+//
+// A model of a sample of the data tells which instances are far on the
+// right side of the margin (or, for EPSILON_SVR, well inside the tube);
+// they are left out, and the rest is trained warm from the sample model.
+// The left-out instances are then checked against the optimality
+// conditions of the result with alpha_i = 0, and violators are added and
+// trained again until there are none, so the model is that of the whole
+// problem up to eps whatever screening left out. Screening 1 keeps
+// instances with margin below 2 (|residual| above p/2), screening 2 those
+// below 1 (above p); the latter leaves out more and re-trains more often.
+//
+// The training set only grows, so the rounds end; after max_round of them
+// the instances still left out are added at once. All rounds draw on one
+// budget: max_time from the start, and max_iter for each binary problem,
+// spent on the optimizations of every round together.
+//
+
+// adds extra[0,nr_extra) to the instances of node, which keep their places,
+// so that its model, sv_indices and all, is the warm start of the next one
+static void screening_grow(cascade_node *node, const int *extra, int nr_extra)
+{
+	node->index = (int *)realloc(node->index,sizeof(int)*(size_t)(node->l+nr_extra));
+	memcpy(node->index+node->l,extra,sizeof(int)*(size_t)nr_extra);
+	node->l += nr_extra;
+	node->nr_init = 1;
+	node->init[0] = node->model;
+	node->model = NULL;
+}
+
+static svm_model *svm_train_screened(const svm_problem *prob, const svm_parameter *param)
+{
+	int l = prob->l;
+	svm_parameter sub_param = *param;
+	sub_param.screening = 0;
+	sub_param.probability = 0;
+	int i, k;
+	const int max_round = 10;
+
+	// what is left of the budget goes to the next training; false if none
+	int nr_pair = 1;	// of the classes found below
+	long start_iter = solver_iterations;
+	double start_time = wall_time();
+	auto budget = [&]() {
+		bool left = true;
+		if(param->max_iter > 0)
+		{
+			long iter_left = (long)param->max_iter*nr_pair-(solver_iterations-start_iter);
+			left = iter_left > 0;
+			sub_param.max_iter = (int)max(1L,iter_left/nr_pair);
+		}
+		if(param->max_time > 0)
+		{
+			double time_left = param->max_time-(wall_time()-start_time);
+			left = left && time_left > 0;
+			sub_param.max_time = time_share(time_left,1);
+		}
+		return left;
+	};
+
+	// every step-th instance, classes dealt like cascade partitions
+	int *perm = Malloc(int,l);
+	if(param->svm_type == C_SVC)
+	{
+		int nr_class, *label = NULL, *start = NULL, *count = NULL;
+		svm_group_classes(prob,&nr_class,&label,&start,&count,perm);
+		nr_pair = nr_class*(nr_class-1)/2;
+		free(label);
+		free(start);
+		free(count);
+	}
+	else
+		for(i=0;i<l;i++)
+			perm[i] = i;
+	int step = max(1,min(8,l/1000));
+	cascade_node sample;
+	sample.l = (l+step-1)/step;
+	sample.index = Malloc(int,sample.l);
+	sample.model = NULL;
+	sample.nr_init = 0;
+	for(i=0;i<sample.l;i++)
+		sample.index[i] = perm[i*step];
+	free(perm);
+	budget();
+	cascade_train(prob,&sub_param,&sample);
+
+	// keep what the sample model puts near or beyond the margin, except
+	// its SVs, which the warm start brings along
+	double margin = param->screening == 1 ?
+		(param->svm_type == C_SVC ? 1 : param->p/2) : 0;
+	char *in_set = Malloc(char,l);
+	char *keep = Malloc(char,l);
+	int *extra = Malloc(int,l);
+	for(i=0;i<l;i++)
+		in_set[i] = 0;
+	for(k=0;k<sample.model->l;k++)
+		in_set[sample.index[sample.model->sv_indices[k]-1]] = 1;
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic,64)
+#endif
+	for(i=0;i<l;i++)
+		keep[i] = !in_set[i] && kkt_slack(prob,param,sample.model,i) < margin;
+	int nr_extra = 0;
+	for(i=0;i<l;i++)
+		if(keep[i])
+		{
+			extra[nr_extra++] = i;
+			in_set[i] = 1;
+		}
+	free(keep);
+	info("screening: %d of %d instances left out\n",l-sample.model->l-nr_extra,l);
+	cascade_node top;
+	cascade_merge(&sample,1,extra,nr_extra,&top);
+	budget();
+	cascade_train(prob,&sub_param,&top);
+
+	for(int round=1;budget() && !training_cancelled();round++)
+	{
+		int nr_violator = cascade_violators(prob,param,top.model,in_set,param->eps,extra);
+		info("screening round %d: %d violators\n",round,nr_violator);
+		if(nr_violator == 0)
+			break;
+		if(round == max_round)
+		{
+			nr_violator = 0;
+			for(i=0;i<l;i++)
+				if(!in_set[i])
+					extra[nr_violator++] = i;
+			info("screening: %d rounds, adding the %d instances left out\n",round,nr_violator);
+		}
+		for(k=0;k<nr_violator;k++)
+			in_set[extra[k]] = 1;
+		screening_grow(&top,extra,nr_violator);
+		cascade_train(prob,&sub_param,&top);
+	}
+	free(in_set);
+	free(extra);
 
-		model->sv_coef = Malloc(double *,nr_class-1);
-		for(i=0;i<nr_class-1;i++)
-			model->sv_coef[i] = Malloc(double,total_sv);
+	if(param->probability)
+	{
+		sub_param.probability = 1;
+		cascade_node next;
+		cascade_merge(&top,1,NULL,0,&next);
+		cascade_train(prob,&sub_param,&next);
+		top = next;
+	}
+
+	svm_model *model = top.model;
+	model->param = *param;
+	for(k=0;k<model->l;k++)
+		model->sv_indices[k] = top.index[model->sv_indices[k]-1]+1;
+	free(top.index);
+	return model;
+}
+
+//
+// Bagged ensembles
+//
+// Each member is trained on l/nr_model instances, so k members cost about
+// k^(1-a) of one SVM on all the data when SMO takes O(l^a), a > 1, and
+// they train concurrently like the nodes of a cascade level. The classes
+// are spread evenly over the members; a class with fewer instances than
+// members is given whole to each, so that all members know all classes.
+//
+svm_ensemble *svm_train_ensemble(const svm_problem *prob, const svm_parameter *param,
+	int nr_model, int bootstrap)
+{
+	progress_scope scope;
+	int l = prob->l;
+	nr_model = max(1,min(nr_model,l));
+	int i, k;
 
-		p = 0;
-		for(i=0;i<nr_class;i++)
-			for(int j=i+1;j<nr_class;j++)
-			{
-				// classifier (i,j): coefficients with
-				// i are in sv_coef[j-1][nz_start[i]...],
-				// j are in sv_coef[i][nz_start[j]...]
+	int nr_class = 1, *label = NULL, *start = NULL, *count = NULL;
+	int *perm = Malloc(int,l);
+	if(param->svm_type == C_SVC || param->svm_type == NU_SVC)
+		svm_group_classes(prob,&nr_class,&label,&start,&count,perm);
+	else
+	{
+		start = Malloc(int,1);
+		count = Malloc(int,1);
+		start[0] = 0;
+		count[0] = l;
+		for(i=0;i<l;i++)
+			perm[i] = i;
+	}
 
-				int si = start[i];
-				int sj = start[j];
-				int ci = count[i];
-				int cj = count[j];
+	// a bootstrap member draws with its own generator, seeded by its number
+	vector<vector<int> > member(nr_model);
+	vector<std::minstd_rand> rng;
+	for(k=0;k<nr_model;k++)
+		rng.push_back(std::minstd_rand(k+1));
+	int next = 0;
+	for(int c=0;c<nr_class;c++)
+	{
+		const int *index = &perm[start[c]];
+		int n = count[c];
+		if(n < nr_model)
+			for(k=0;k<nr_model;k++)
+				member[k].insert(member[k].end(),index,index+n);
+		else if(bootstrap)
+			for(k=0;k<nr_model;k++)
+				for(int t=0;t<(n+nr_model/2)/nr_model;t++)
+					member[k].push_back(index[random_below(&rng[k],n)]);
+		else
+			for(int t=0;t<n;t++)
+				member[(next+t)%nr_model].push_back(index[t]);
+		next += n;
+	}
+	free(label);
+	free(start);
+	free(count);
+	free(perm);
 
-				int q = nz_start[i];
-				int k;
-				for(k=0;k<ci;k++)
-					if(nonzero[si+k])
-						model->sv_coef[j-1][q++] = f[p].alpha[k];
-				q = nz_start[j];
-				for(k=0;k<cj;k++)
-					if(nonzero[sj+k])
-						model->sv_coef[i][q++] = f[p].alpha[ci+k];
-				++p;
-			}
+	vector<cascade_node> node(nr_model);
+	for(k=0;k<nr_model;k++)
+	{
+		// instances in the order of prob, which fixes the order of labels
+		std::sort(member[k].begin(),member[k].end());
+		node[k].l = (int)member[k].size();
+		node[k].index = Malloc(int,node[k].l);
+		memcpy(node[k].index,member[k].data(),sizeof(int)*node[k].l);
+		node[k].model = NULL;
+		node[k].nr_init = 0;
+	}
+	cascade_train_level(prob,param,node.data(),nr_model);
 
-		free(label);
-		free(probA);
-		free(probB);
-		free(count);
-		free(perm);
-		free(start);
-		free(x);
-		free(weighted_C);
-		free(nonzero);
-		for(i=0;i<nr_class*(nr_class-1)/2;i++)
-			free(f[i].alpha);
-		free(f);
-		free(nz_count);
-		free(nz_start);
+	svm_ensemble *ensemble = Malloc(svm_ensemble,1);
+	ensemble->nr_model = nr_model;
+	ensemble->model = Malloc(svm_model *,nr_model);
+	int total_sv = 0;
+	for(k=0;k<nr_model;k++)
+	{
+		svm_model *model = node[k].model;
+		if(model->sv_indices)
+			for(int s=0;s<model->l;s++)
+				if(model->sv_indices[s] > 0)
+					model->sv_indices[s] = node[k].index[model->sv_indices[s]-1]+1;
+		free(node[k].index);
+		ensemble->model[k] = model;
+		total_sv += model->l;
 	}
-	return model;
+	info("ensemble of %d models, %d SVs\n",nr_model,total_sv);
+	if(scope.cancelled())
+		svm_free_and_destroy_ensemble(&ensemble);
+	return ensemble;
 }
 
-// Stratified cross validation
-void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold, double *target)
+// Stratified cross validation, folds drawn from rng or, if NULL, rand()
+static void cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold,
+	double *target, std::minstd_rand *rng)
 {
 	int i;
 	int *fold_start;
@@ -2447,7 +7011,7 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		for (c=0; c<nr_class; c++)
 			for(i=0;i<count[c];i++)
 			{
-				int j = i+rand()%(count[c]-i);
+				int j = i+random_below(rng,count[c]-i);
 				swap(index[start[c]+j],index[start[c]+i]);
 			}
 		for(i=0;i<nr_fold;i++)
@@ -2484,14 +7048,14 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		for(i=0;i<l;i++) perm[i]=i;
 		for(i=0;i<l;i++)
 		{
-			int j = i+rand()%(l-i);
+			int j = i+random_below(rng,l-i);
 			swap(perm[i],perm[j]);
 		}
 		for(i=0;i<=nr_fold;i++)
 			fold_start[i]=i*l/nr_fold;
 	}
 
-	for(i=0;i<nr_fold;i++)
+	for(i=0;i<nr_fold && !training_cancelled();i++)
 	{
 		int begin = fold_start[i];
 		int end = fold_start[i+1];
@@ -2531,10 +7095,697 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		free(subprob.x);
 		free(subprob.y);
 	}
-	free(fold_start);
-	free(perm);
+	// a cancelled one predicts nothing
+	if(training_cancelled())
+		for(i=0;i<l;i++)
+			target[i] = NAN;
+	free(fold_start);
+	free(perm);
+}
+
+void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold, double *target)
+{
+	progress_scope scope;
+	cross_validation(prob,param,nr_fold,target,NULL);
+}
+
+
+//
+// Reduced-set approximation of a model
+//
+// Each decision function is f(x) = <w,phi(x)> - rho with w a combination
+// of the SVs. Pivoted Cholesky factorization of the kernel matrix of the
+// SVs picks, one at a time, the SV whose phi removes the largest part of
+// what is left of w, and w is replaced by its projection on the span of
+// the SVs picked so far. The SVs of a class carry k-1 coefficient vectors,
+// one per pair, so each class is projected on its own picks with all its
+// vectors at once; a regression or one-class model is a single group.
+// Every pick keeps its Cholesky column over its group until the end, so
+// the factor takes 8*nr_sv*l bytes at most: nr_sv bounds the memory, and
+// a tolerance alone may keep all l columns.
+//
+struct reduce_group
+{
+	int start, l;		// SVs [start,start+l) of the model
+	vector<int> pick;	// picked SVs, in the order they were picked
+	vector<vector<double> > L;	// L[m][i-start]: Cholesky column of pick[m]
+	vector<vector<double> > t;	// t[m][o]: w of output o on the m-th basis vector
+};
+
+svm_model *svm_reduce_model(const svm_model *model, int nr_sv, double tolerance)
+{
+	int l = model->l;
+	int svm_type = model->param.svm_type;
+	bool classification = svm_type == C_SVC || svm_type == NU_SVC;
+	int nr_class = model->nr_class;
+	int nr_out = classification ? nr_class-1 : 1;
+	int nr_group = classification ? nr_class : 1;
+	const svm_parameter& param = model->param;
+	if(nr_sv <= 0 || nr_sv > l)
+		nr_sv = l;
+
+	vector<reduce_group> group(nr_group);
+	vector<int> group_of(l);
+	int i, o, c;
+	for(c=0;c<nr_group;c++)
+	{
+		group[c].start = c > 0 ? group[c-1].start+group[c-1].l : 0;
+		group[c].l = classification ? model->nSV[c] : l;
+		for(i=group[c].start;i<group[c].start+group[c].l;i++)
+			group_of[i] = c;
+	}
+
+	// e[o][i] = <residual of w, phi(SV i)>, first <w,phi(SV i)>, and d[i] the
+	// squared distance of phi(SV i) from the span of the picks of its group
+	vector<vector<double> > e(nr_out,vector<double>(l,0));
+	vector<double> d(l), kd(l);
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic,16)
+#endif
+	for(i=0;i<l;i++)
+	{
+		const reduce_group& g = group[group_of[i]];
+		PredictInstance px(model->SV[i],param,g.l);
+		for(int j=g.start;j<g.start+g.l;j++)
+		{
+			double k = px.k_function(model->SV[j],param);
+			if(j == i)
+				kd[i] = k;
+			for(int q=0;q<nr_out;q++)
+				e[q][i] += model->sv_coef[q][j]*k;
+		}
+		d[i] = kd[i];
+	}
+	double w_square = 0;
+	for(o=0;o<nr_out;o++)
+		for(i=0;i<l;i++)
+			w_square += model->sv_coef[o][i]*e[o][i];
+	double residual = w_square;
+
+	int nr_pick = 0;
+	vector<char> picked(l,0);
+	while(nr_pick < nr_sv && residual > tolerance*tolerance*w_square)
+	{
+		int s = -1;
+		double best = 0;
+		for(i=0;i<l;i++)
+			if(!picked[i] && d[i] > 1e-10*kd[i])
+			{
+				double gain = 0;
+				for(o=0;o<nr_out;o++)
+					gain += e[o][i]*e[o][i];
+				gain /= d[i];
+				if(gain > best)
+				{
+					best = gain;
+					s = i;
+				}
+			}
+		if(s == -1)
+			break;
+
+		reduce_group& g = group[group_of[s]];
+		int m = (int)g.pick.size();
+		double pivot = sqrt(d[s]);
+		vector<double> col(g.l);
+		PredictInstance px(model->SV[s],param,g.l);
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic,64)
+#endif
+		for(i=0;i<g.l;i++)
+		{
+			double v = px.k_function(model->SV[g.start+i],param);
+			for(int k=0;k<m;k++)
+				v -= g.L[k][i]*g.L[k][s-g.start];
+			col[i] = v/pivot;
+		}
+		vector<double> t(nr_out);
+		for(o=0;o<nr_out;o++)
+		{
+			t[o] = e[o][s]/pivot;
+			residual -= t[o]*t[o];
+		}
+		for(i=0;i<g.l;i++)
+		{
+			d[g.start+i] -= col[i]*col[i];
+			for(o=0;o<nr_out;o++)
+				e[o][g.start+i] -= col[i]*t[o];
+		}
+		picked[s] = 1;
+		g.pick.push_back(s);
+		g.L.push_back(col);
+		g.t.push_back(t);
+		++nr_pick;
+	}
+	info("reduced %d SVs to %d, relative error of w %g\n",l,nr_pick,
+		w_square > 0 ? sqrt(max(residual,0.0)/w_square) : 0.0);
+
+	// the projection is sum_m beta[m] phi(pick[m]) with L_S' beta = t, where
+	// L_S holds the rows of the picks in the Cholesky columns
+	svm_model *reduced = Malloc(svm_model,1);
+	reduced->param = param;
+	reduced->param.nr_weight = 0;
+	reduced->param.weight_label = NULL;
+	reduced->param.weight = NULL;
+	reduced->nr_class = nr_class;
+	reduced->l = nr_pick;
+	reduced->SV = Malloc(svm_node *,nr_pick);
+	reduced->sv_coef = Malloc(double *,nr_out);
+	for(o=0;o<nr_out;o++)
+		reduced->sv_coef[o] = Malloc(double,nr_pick);
+	reduced->sv_indices = model->sv_indices ? Malloc(int,nr_pick) : NULL;
+
+	size_t elements = 0;
+	for(i=0;i<l;i++)
+		if(picked[i])
+			for(const svm_node *px = model->SV[i]; ; ++px)
+			{
+				++elements;
+				if(px->index == -1)
+					break;
+			}
+	svm_node *x_space = Malloc(svm_node,elements);
+	size_t n = 0;
+	int q = 0;
+	for(c=0;c<nr_group;c++)
+	{
+		reduce_group& g = group[c];
+		int m = (int)g.pick.size();
+		vector<double> beta((size_t)m*nr_out);
+		for(int j=m-1;j>=0;j--)
+			for(o=0;o<nr_out;o++)
+			{
+				double v = g.t[j][o];
+				for(int k=j+1;k<m;k++)
+					v -= g.L[j][g.pick[k]-g.start]*beta[(size_t)k*nr_out+o];
+				beta[(size_t)j*nr_out+o] = v/g.L[j][g.pick[j]-g.start];
+			}
+
+		// SVs keep the order they had in the model
+		vector<int> order(m);
+		for(int j=0;j<m;j++)
+			order[j] = j;
+		std::sort(order.begin(),order.end(),[&g](int a, int b) { return g.pick[a] < g.pick[b]; });
+		for(int j : order)
+		{
+			int k = g.pick[j];
+			reduced->SV[q] = &x_space[n];
+			for(const svm_node *px = model->SV[k]; ; ++px)
+			{
+				x_space[n++] = *px;
+				if(px->index == -1)
+					break;
+			}
+			for(o=0;o<nr_out;o++)
+				reduced->sv_coef[o][q] = beta[(size_t)j*nr_out+o];
+			if(reduced->sv_indices)
+				reduced->sv_indices[q] = model->sv_indices[k];
+			++q;
+		}
+	}
+
+	int nr_pair = classification ? nr_class*(nr_class-1)/2 : 1;
+	reduced->rho = Malloc(double,nr_pair);
+	memcpy(reduced->rho,model->rho,sizeof(double)*nr_pair);
+	reduced->probA = NULL;
+	reduced->probB = NULL;
+	reduced->prob_density_marks = NULL;
+	if(model->probA)
+	{
+		reduced->probA = Malloc(double,nr_pair);
+		memcpy(reduced->probA,model->probA,sizeof(double)*nr_pair);
+	}
+	if(model->probB)
+	{
+		reduced->probB = Malloc(double,nr_pair);
+		memcpy(reduced->probB,model->probB,sizeof(double)*nr_pair);
+	}
+	if(model->prob_density_marks)
+	{
+		reduced->prob_density_marks = Malloc(double,10);
+		memcpy(reduced->prob_density_marks,model->prob_density_marks,sizeof(double)*10);
+	}
+	reduced->label = NULL;
+	reduced->nSV = NULL;
+	if(classification)
+	{
+		reduced->label = Malloc(int,nr_class);
+		reduced->nSV = Malloc(int,nr_class);
+		for(c=0;c<nr_class;c++)
+		{
+			reduced->label[c] = model->label[c];
+			reduced->nSV[c] = (int)group[c].pick.size();
+		}
+	}
+	reduced->free_sv = 1;
+	if(nr_pick == 0)
+		free(x_space);
+	return reduced;
+}
+
+//
+// Incremental training of a two-class C-SVC
+//
+// This is SMO warm-started from the previous solution, not the exact
+// increments of Cauwenberghs and Poggio, which keep every instance
+// optimal while an alpha moves. The session keeps the dual solution
+// alpha of its current training set with the gradient G and G_bar the
+// solver would have for it. A new instance joins with alpha = 0, which
+// keeps the solution feasible, and its gradient is one pass over the
+// SVs. A removed instance gives its alpha to others of its class (or
+// takes it from the other class) so that y'alpha = 0 still holds, each
+// moved alpha updating the gradient with one column of Q. Updates may
+// leave instances violating the optimality conditions; svm_incremental_model
+// runs SMO from that point, where mostly the changed ones do, instead of
+// training from scratch.
+//
+// Q and its kernel cache last as long as the session. Its rows come and
+// go, so it evaluates the kernel from the rows as prediction does instead
+// of keeping converted copies as Kernel does.
+//
+class INCREMENTAL_Q: public QMatrix
+{
+public:
+	INCREMENTAL_Q(const svm_parameter& param_)
+	:param(param_), capacity(64), nnz(0)
+	{
+		cache = new Cache(capacity,(size_t)(param.cache_size*(1<<20)));
+#ifdef _OPENMP
+		eval_cost = 0;
+		nr_timed = 0;
+#endif
+	}
+
+	// a row at the end, which must outlive its time in Q
+	void append(const svm_node *x_, schar y_)
+	{
+		if((int)x.size() == capacity)
+		{
+			capacity *= 2;
+			cache->grow(capacity);
+		}
+		x.push_back(x_);
+		y.push_back(y_);
+		for(const svm_node *px = x_; px->index != -1; ++px)
+			++nnz;
+#ifdef _OPENMP
+		double start = omp_get_wtime();
+#endif
+		QD.push_back(Kernel::k_function(x_,x_,param));
+#ifdef _OPENMP
+		// the first rows sample the cost of an evaluation
+		if(nr_timed < 64)
+		{
+			eval_cost = (eval_cost*nr_timed+omp_get_wtime()-start)/(nr_timed+1);
+			++nr_timed;
+		}
+#endif
+	}
+
+	// drop the last row
+	void pop()
+	{
+		for(const svm_node *px = x.back(); px->index != -1; ++px)
+			--nnz;
+		x.pop_back();
+		y.pop_back();
+		QD.pop_back();
+		cache->truncate((int)x.size());
+	}
+
+	Qfloat *get_Q(int i, int len) const
+	{
+		Qfloat *data;
+		int start = cache->get_data(i,&data,len);
+		if(start < len)
+		{
+#ifdef _OPENMP
+			int nr_thread = parallel_threads((len-start)*eval_cost);
+#pragma omp parallel num_threads(nr_thread) if(nr_thread > 1)
+			{
+				int t = omp_get_thread_num(), n = omp_get_num_threads();
+				fill_Q(i,data,start+(len-start)*t/n,start+(len-start)*(t+1)/n);
+			}
+#else
+			fill_Q(i,data,start,len);
+#endif
+		}
+		return data;
+	}
+
+	Qfloat *get_Q_lookup(int i, int len, int *start) const
+	{
+		Qfloat *data;
+		*start = cache->get_data(i,&data,len);
+		return data;
+	}
+
+	void fill_Q(int i, Qfloat *data, int begin, int end) const
+	{
+		PredictInstance pi(x[i],param,end-begin);
+		for(int j=begin;j<end;j++)
+			data[j] = (Qfloat)(y[i]*y[j]*pi.k_function(x[j],param));
+	}
+
+	int peek_Q(int i, const Qfloat **data) const
+	{
+		Qfloat *cached;
+		int len = cache->peek(i,&cached);
+		*data = cached;
+		return len;
+	}
+
+	double *get_QD() const
+	{
+		return QD.data();
+	}
+
+	void swap_index(int i, int j) const
+	{
+		cache->swap_index(i,j);
+		swap(x[i],x[j]);
+		swap(y[i],y[j]);
+		swap(QD[i],QD[j]);
+	}
+
+	double get_cache_hit_rate() const
+	{
+		return cache->hit_rate();
+	}
+
+	// a dot product, then exp, pow or tanh
+	double get_kernel_cost() const
+	{
+		int l = (int)x.size();
+		return (l > 0 ? (double)nnz/l : 0) +
+			(param.kernel_type == LINEAR || param.kernel_type == PRECOMPUTED ? 1 : 20);
+	}
+
+#ifdef _OPENMP
+	double get_eval_time() const { return eval_cost; }
+#endif
+
+	~INCREMENTAL_Q()
+	{
+		delete cache;
+	}
+private:
+	const svm_parameter& param;
+	mutable vector<const svm_node *> x;
+	mutable vector<schar> y;
+	mutable vector<double> QD;
+	Cache *cache;
+	int capacity;	// columns the cache has room for
+	size_t nnz;
+#ifdef _OPENMP
+	double eval_cost;
+	int nr_timed;
+#endif
+};
+
+struct svm_incremental
+{
+	svm_parameter param;
+	int label[2];		// y = +1 for label[0], as svm_train orders them
+	double C[2];
+	int next_id;
+	// by row of Q
+	vector<svm_node *> x;	// copies of the rows, owned
+	vector<schar> y;
+	vector<int> id;		// 1 to l for the instances of prob, then as added
+	vector<double> alpha, G, G_bar;
+	INCREMENTAL_Q *Q;
+};
+
+static int incremental_class(const svm_incremental *inc, double y)
+{
+	for(int c=0;c<2;c++)
+		if((int)y == inc->label[c])
+			return c;
+	return -1;
+}
+
+static svm_node *copy_row(const svm_node *x)
+{
+	int n = 0;
+	while(x[n].index != -1)
+		++n;
+	svm_node *row = Malloc(svm_node,n+1);
+	memcpy(row,x,sizeof(svm_node)*(n+1));
+	return row;
+}
+
+static void incremental_append(svm_incremental *inc, const svm_node *x, schar y)
+{
+	svm_node *row = copy_row(x);
+	inc->x.push_back(row);
+	inc->y.push_back(y);
+	inc->id.push_back(inc->next_id++);
+	inc->alpha.push_back(0);
+	inc->Q->append(row,y);
+}
+
+// change alpha[j] by delta, clamped to [0,C_j], and the gradients with
+// column j; returns the change made
+static double incremental_move(svm_incremental *inc, int j, double delta)
+{
+	int l = (int)inc->x.size();
+	double C_j = inc->C[inc->y[j] > 0 ? 0 : 1];
+	double old = inc->alpha[j];
+	bool was_upper = old >= C_j;
+	inc->alpha[j] = min(max(old+delta,0.0),C_j);
+	delta = inc->alpha[j]-old;
+	bool upper = inc->alpha[j] >= C_j;
+	const Qfloat *Q_j = inc->Q->get_Q(j,l);
+	for(int i=0;i<l;i++)
+	{
+		inc->G[i] += Q_j[i]*delta;
+		if(upper != was_upper)
+			inc->G_bar[i] += (upper ? C_j : -C_j)*Q_j[i];
+	}
+	return delta;
+}
+
+svm_incremental *svm_incremental_create(const svm_problem *prob, const svm_parameter *param)
+{
+	if(param->svm_type != C_SVC || param->solver != SMO || param->probability ||
+	   svm_check_parameter(prob,param) != NULL)
+		return NULL;
+	class_groups g;
+	class_groups_init(&g,prob);
+	if(g.nr_class != 2)
+	{
+		class_groups_destroy(&g);
+		return NULL;
+	}
+
+	svm_incremental *inc = new svm_incremental;
+	inc->param = *param;
+	inc->param.nr_weight = 0;
+	inc->param.weight_label = NULL;
+	inc->param.weight = NULL;
+	double *weighted_C = class_groups_weighted_C(&g,param);
+	for(int c=0;c<2;c++)
+	{
+		inc->label[c] = g.label[c];
+		inc->C[c] = weighted_C[c];
+	}
+	free(weighted_C);
+	class_groups_destroy(&g);
+
+	inc->next_id = 1;
+	inc->Q = new INCREMENTAL_Q(inc->param);
+	for(int i=0;i<prob->l;i++)
+		incremental_append(inc,prob->x[i],incremental_class(inc,prob->y[i]) == 0 ? +1 : -1);
+	inc->G.assign(prob->l,-1);
+	inc->G_bar.assign(prob->l,0);
+	return inc;
+}
+
+int svm_incremental_add(svm_incremental *inc, const svm_node *x, double y)
+{
+	int c = incremental_class(inc,y);
+	if(c == -1)
+		return -1;
+	int l = (int)inc->x.size();
+	incremental_append(inc,x,c == 0 ? +1 : -1);
+
+	// G = Q alpha - 1 and G_bar = C Q over the upper bounded ones
+	PredictInstance pi(inc->x[l],inc->param,l);
+	double G = -1, G_bar = 0;
+	for(int j=0;j<l;j++)
+		if(inc->alpha[j] > 0)
+		{
+			double C_j = inc->C[inc->y[j] > 0 ? 0 : 1];
+			Qfloat Q_ij = (Qfloat)(inc->y[l]*inc->y[j]*pi.k_function(inc->x[j],inc->param));
+			G += Q_ij*inc->alpha[j];
+			if(inc->alpha[j] >= C_j)
+				G_bar += C_j*Q_ij;
+		}
+	inc->G.push_back(G);
+	inc->G_bar.push_back(G_bar);
+	return inc->id[l];
+}
+
+int svm_incremental_remove(svm_incremental *inc, int id)
+{
+	int l = (int)inc->x.size();
+	int index = (int)(std::find(inc->id.begin(),inc->id.end(),id)-inc->id.begin());
+	if(index == l)
+		return -1;
+	int count = 0;
+	for(int i=0;i<l;i++)
+		count += inc->y[i] == inc->y[index];
+	if(count == 1)
+		return -1;	// the last of its class
+
+	double moved = inc->alpha[index];
+	if(moved > 0)
+	{
+		incremental_move(inc,index,-moved);
+		// free ones of the same class first, then those at zero, then the
+		// other class; they keep y'alpha = 0
+		for(int pass=0;pass<3 && moved > 0;pass++)
+			for(int j=0;j<l && moved > 0;j++)
+			{
+				if(j == index)
+					continue;
+				double C_j = inc->C[inc->y[j] > 0 ? 0 : 1];
+				double a = inc->alpha[j], delta;
+				if(inc->y[j] != inc->y[index])
+					delta = pass == 2 ? -min(a,moved) : 0;
+				else if(pass == 0)
+					delta = a > 0 && a < C_j ? min(C_j-a,moved) : 0;
+				else
+					delta = pass == 1 && a <= 0 ? min(C_j,moved) : 0;
+				if(delta != 0)
+					moved -= fabs(incremental_move(inc,j,delta));
+			}
+	}
+
+	// the last row takes its place, in Q as well
+	int last = l-1;
+	inc->Q->swap_index(index,last);
+	swap(inc->x[index],inc->x[last]);
+	swap(inc->y[index],inc->y[last]);
+	swap(inc->id[index],inc->id[last]);
+	swap(inc->alpha[index],inc->alpha[last]);
+	swap(inc->G[index],inc->G[last]);
+	swap(inc->G_bar[index],inc->G_bar[last]);
+	inc->Q->pop();
+	free(inc->x[last]);
+	inc->x.pop_back();
+	inc->y.pop_back();
+	inc->id.pop_back();
+	inc->alpha.pop_back();
+	inc->G.pop_back();
+	inc->G_bar.pop_back();
+	return 0;
+}
+
+// put the arrays of the session in the order of src, src[i] the old
+// index of what goes to i
+template <class T>
+static void incremental_reorder(vector<T>& v, const vector<int>& src)
+{
+	vector<T> w(v.size());
+	for(size_t i=0;i<v.size();i++)
+		w[i] = v[src[i]];
+	v.swap(w);
+}
+
+svm_model *svm_incremental_model(svm_incremental *inc)
+{
+	progress_scope scope;
+	int l = (int)inc->x.size();
+	vector<int> perm(l);
+	for(int i=0;i<l;i++)
+		perm[i] = i;
+
+	solver_state s;
+	s.l = l;
+	s.iter = 0;
+	s.counter = min(l,1000)+1;
+	s.active_size = l;
+	s.unshrink = 0;
+	s.shrink_period = 1;
+	s.shrink_round = 0;
+	s.shrink_saved = 0;
+	s.shrink_cost = 0;
+	s.active_set = perm.data();
+	s.alpha = inc->alpha.data();
+	s.G = inc->G.data();
+	s.G_bar = inc->G_bar.data();
+
+	const svm_parameter& param = inc->param;
+	vector<double> minus_ones(l,-1.0);
+	vector<double> alpha(inc->alpha);
+	Solver::SolutionInfo si;
+	Solver solver;
+	solver.set_resume(&s,inc->G.data(),inc->G_bar.data());
+	solver.Solve(l,*inc->Q,minus_ones.data(),inc->y.data(),
+		alpha.data(),inc->C[0],inc->C[1],param.eps,&si,param.shrinking,param,perm.data());
+	inc->alpha = alpha;
+	// Q keeps the rows where the solver left them
+	incremental_reorder(inc->x,perm);
+	incremental_reorder(inc->y,perm);
+	incremental_reorder(inc->id,perm);
+	incremental_reorder(inc->alpha,perm);
+	incremental_reorder(inc->G,perm);
+	incremental_reorder(inc->G_bar,perm);
+	info("obj = %f, rho = %f, gap = %g\n",si.obj,si.rho,si.gap);
+	if(scope.cancelled())
+		return NULL;
+
+	// the classes in the order svm_train gives them, each in the order
+	// the instances joined
+	vector<int> order(l);
+	for(int i=0;i<l;i++)
+		order[i] = i;
+	std::sort(order.begin(),order.end(),[inc](int a, int b) {
+		return inc->y[a] != inc->y[b] ? inc->y[a] > inc->y[b] : inc->id[a] < inc->id[b]; });
+	class_groups g;
+	g.l = l;
+	g.nr_class = 2;
+	g.label = Malloc(int,2);
+	g.start = Malloc(int,2);
+	g.count = Malloc(int,2);
+	g.perm = Malloc(int,l);
+	g.x = Malloc(svm_node *,l);
+	decision_function f;
+	f.alpha = Malloc(double,l);
+	f.rho = si.rho;
+	g.count[0] = 0;
+	for(int k=0;k<l;k++)
+	{
+		int i = order[k];
+		g.count[0] += inc->y[i] > 0;
+		g.perm[k] = inc->id[i]-1;	// sv_indices are the ids
+		g.x[k] = inc->x[i];
+		f.alpha[k] = inc->y[i]*inc->alpha[i];
+	}
+	g.count[1] = l-g.count[0];
+	for(int c=0;c<2;c++)
+	{
+		g.label[c] = inc->label[c];
+		g.start[c] = c == 0 ? 0 : g.count[0];
+	}
+	svm_model *model = svm_build_class_model(&g,&param,&f,NULL,NULL);
+	model_own_svs(model);
+	free(f.alpha);
+	class_groups_destroy(&g);
+	return model;
 }
 
+void svm_incremental_destroy(svm_incremental *inc)
+{
+	if(inc == NULL)
+		return;
+	delete inc->Q;
+	for(svm_node *row : inc->x)
+		free(row);
+	delete inc;
+}
 
 int svm_get_svm_type(const svm_model *model)
 {
@@ -2577,7 +7828,8 @@ double svm_get_svr_probability(const svm_model *model)
 	}
 }
 
-double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+// decision values of model from the kernel values of an instance and its SVs
+static double predict_values(const svm_model *model, const double *kvalue, double *dec_values)
 {
 	int i;
 	if(model->param.svm_type == ONE_CLASS ||
@@ -2586,11 +7838,8 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	{
 		double *sv_coef = model->sv_coef[0];
 		double sum = 0;
-#ifdef _OPENMP
-#pragma omp parallel for private(i) reduction(+:sum) schedule(guided)
-#endif
 		for(i=0;i<model->l;i++)
-			sum += sv_coef[i] * Kernel::k_function(x,model->SV[i],model->param);
+			sum += sv_coef[i] * kvalue[i];
 		sum -= model->rho[0];
 		*dec_values = sum;
 
@@ -2602,14 +7851,6 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	else
 	{
 		int nr_class = model->nr_class;
-		int l = model->l;
-
-		double *kvalue = Malloc(double,l);
-#ifdef _OPENMP
-#pragma omp parallel for private(i) schedule(guided)
-#endif
-		for(i=0;i<l;i++)
-			kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
 
 		int *start = Malloc(int,nr_class);
 		start[0] = 0;
@@ -2652,13 +7893,22 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 			if(vote[i] > vote[vote_max_idx])
 				vote_max_idx = i;
 
-		free(kvalue);
 		free(start);
 		free(vote);
 		return model->label[vote_max_idx];
 	}
 }
 
+double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	double *kvalue = Malloc(double,model->l);
+	PredictInstance px(x,model->param,model->l);
+	px.k_values(model,kvalue);
+	double pred_result = predict_values(model,kvalue,dec_values);
+	free(kvalue);
+	return pred_result;
+}
+
 double svm_predict(const svm_model *model, const svm_node *x)
 {
 	int nr_class = model->nr_class;
@@ -2674,6 +7924,103 @@ double svm_predict(const svm_model *model, const svm_node *x)
 	return pred_result;
 }
 
+// The instance is scattered once (PredictInstance) for the kernel values of
+// all members, which share the kernel. Regression averages the members,
+// classification averages the decision values of each pair of labels and
+// votes with them as a single model does.
+double svm_predict_ensemble_values(const svm_ensemble *ensemble, const svm_node *x, double *dec_values)
+{
+	const svm_model *first = ensemble->model[0];
+	int svm_type = first->param.svm_type;
+	int nr_class = first->nr_class;
+	int nr_pair = nr_class*(nr_class-1)/2;
+	int i, k, total_sv = 0, max_sv = 0;
+	for(k=0;k<ensemble->nr_model;k++)
+	{
+		total_sv += ensemble->model[k]->l;
+		max_sv = max(max_sv,ensemble->model[k]->l);
+	}
+	PredictInstance px(x,first->param,total_sv);
+	double *kvalue = Malloc(double,max_sv);
+	double *member_dec = Malloc(double,nr_pair > 0 ? nr_pair : 1);
+	int *index = Malloc(int,nr_class);
+
+	bool classification = svm_type == C_SVC || svm_type == NU_SVC;
+	int nr_dec = classification ? nr_pair : 1;
+	for(i=0;i<nr_dec;i++)
+		dec_values[i] = 0;
+	for(k=0;k<ensemble->nr_model;k++)
+	{
+		const svm_model *model = ensemble->model[k];
+		px.k_values(model,kvalue);
+		predict_values(model,kvalue,member_dec);
+		if(!classification)
+		{
+			dec_values[0] += member_dec[0];
+			continue;
+		}
+
+		// pair (a,b), a < b, of the first model's labels is number
+		// a*nr_class-a*(a+1)/2+b-a-1
+		for(i=0;i<nr_class;i++)
+		{
+			index[i] = 0;
+			while(index[i] < nr_class-1 && first->label[index[i]] != model->label[i])
+				++index[i];
+		}
+		int p = 0;
+		for(i=0;i<nr_class;i++)
+			for(int j=i+1;j<nr_class;j++)
+			{
+				int a = index[i], b = index[j];
+				if(a < b)
+					dec_values[a*nr_class-a*(a+1)/2+b-a-1] += member_dec[p];
+				else
+					dec_values[b*nr_class-b*(b+1)/2+a-b-1] -= member_dec[p];
+				++p;
+			}
+	}
+	for(i=0;i<nr_dec;i++)
+		dec_values[i] /= ensemble->nr_model;
+	free(kvalue);
+	free(member_dec);
+	free(index);
+
+	if(svm_type == ONE_CLASS)
+		return dec_values[0] > 0 ? 1 : -1;
+	if(!classification)
+		return dec_values[0];
+
+	int *vote = Malloc(int,nr_class);
+	for(i=0;i<nr_class;i++)
+		vote[i] = 0;
+	int p = 0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			if(dec_values[p] > 0)
+				++vote[i];
+			else
+				++vote[j];
+			p++;
+		}
+	int vote_max_idx = 0;
+	for(i=1;i<nr_class;i++)
+		if(vote[i] > vote[vote_max_idx])
+			vote_max_idx = i;
+	free(vote);
+	return first->label[vote_max_idx];
+}
+
+double svm_predict_ensemble(const svm_ensemble *ensemble, const svm_node *x)
+{
+	int nr_class = ensemble->model[0]->nr_class;
+	double *dec_values = Malloc(double,max(nr_class*(nr_class-1)/2,1));
+	double pred_result = svm_predict_ensemble_values(ensemble,x,dec_values);
+	free(dec_values);
+	return pred_result;
+}
+
 double svm_predict_probability(
 	const svm_model *model, const svm_node *x, double *prob_estimates)
 {
@@ -2737,17 +8084,9 @@ static const char *kernel_type_table[]=
 	"linear","polynomial","rbf","sigmoid","precomputed",NULL
 };
 
-int svm_save_model(const char *model_file_name, const svm_model *model)
+// write model to fp in the "C" locale
+static void save_model(FILE *fp, const svm_model *model)
 {
-	FILE *fp = fopen(model_file_name,"w");
-	if(fp==NULL) return -1;
-
-	char *old_locale = setlocale(LC_ALL, NULL);
-	if (old_locale) {
-		old_locale = strdup(old_locale);
-	}
-	setlocale(LC_ALL, "C");
-
 	const svm_parameter& param = model->param;
 
 	fprintf(fp,"svm_type %s\n", svm_type_table[param.svm_type]);
@@ -2834,6 +8173,20 @@ int svm_save_model(const char *model_file_name, const svm_model *model)
 			}
 		fprintf(fp, "\n");
 	}
+}
+
+int svm_save_model(const char *model_file_name, const svm_model *model)
+{
+	FILE *fp = fopen(model_file_name,"w");
+	if(fp==NULL) return -1;
+
+	char *old_locale = setlocale(LC_ALL, NULL);
+	if (old_locale) {
+		old_locale = strdup(old_locale);
+	}
+	setlocale(LC_ALL, "C");
+
+	save_model(fp,model);
 
 	setlocale(LC_ALL, old_locale);
 	free(old_locale);
@@ -2874,10 +8227,9 @@ static char* readline(FILE *input)
 bool read_model_header(FILE *fp, svm_model* model)
 {
 	svm_parameter& param = model->param;
-	// parameters for training only won't be assigned, but arrays are assigned as NULL for safety
-	param.nr_weight = 0;
-	param.weight_label = NULL;
-	param.weight = NULL;
+	// parameters for training only won't be assigned; they are zeroed, which
+	// leaves the arrays NULL and every training option at its default
+	memset(&param,0,sizeof(param));
 
 	char cmd[81];
 	while(1)
@@ -2992,17 +8344,9 @@ bool read_model_header(FILE *fp, svm_model* model)
 
 }
 
-svm_model *svm_load_model(const char *model_file_name)
+// read a model written by save_model from fp, in the "C" locale
+static svm_model *load_model(FILE *fp)
 {
-	FILE *fp = fopen(model_file_name,"rb");
-	if(fp==NULL) return NULL;
-
-	char *old_locale = setlocale(LC_ALL, NULL);
-	if (old_locale) {
-		old_locale = strdup(old_locale);
-	}
-	setlocale(LC_ALL, "C");
-
 	// read parameters
 
 	svm_model *model = Malloc(svm_model,1);
@@ -3018,13 +8362,10 @@ svm_model *svm_load_model(const char *model_file_name)
 	if (!read_model_header(fp, model))
 	{
 		fprintf(stderr, "ERROR: fscanf failed to read model\n");
-		setlocale(LC_ALL, old_locale);
-		free(old_locale);
 		free(model->rho);
 		free(model->label);
 		free(model->nSV);
 		free(model);
-		fclose(fp);
 		return NULL;
 	}
 
@@ -3037,7 +8378,8 @@ svm_model *svm_load_model(const char *model_file_name)
 	line = Malloc(char,max_line_len);
 	char *p,*endptr,*idx,*val;
 
-	while(readline(fp)!=NULL)
+	// the SV lines; more models may follow in an ensemble file
+	for(int n=0;n<model->l && readline(fp)!=NULL;n++)
 	{
 		p = strtok(line,":");
 		while(1)
@@ -3092,16 +8434,102 @@ svm_model *svm_load_model(const char *model_file_name)
 	}
 	free(line);
 
+	model->free_sv = 1;	// XXX
+	return model;
+}
+
+svm_model *svm_load_model(const char *model_file_name)
+{
+	FILE *fp = fopen(model_file_name,"rb");
+	if(fp==NULL) return NULL;
+
+	char *old_locale = setlocale(LC_ALL, NULL);
+	if (old_locale) {
+		old_locale = strdup(old_locale);
+	}
+	setlocale(LC_ALL, "C");
+
+	svm_model *model = load_model(fp);
+
 	setlocale(LC_ALL, old_locale);
 	free(old_locale);
 
 	if (ferror(fp) != 0 || fclose(fp) != 0)
+	{
+		if(model)
+			svm_free_and_destroy_model(&model);
 		return NULL;
-
-	model->free_sv = 1;	// XXX
+	}
 	return model;
 }
 
+// An ensemble file is a line "ensemble nr_model" followed by the members
+// as svm_save_model writes them
+int svm_save_ensemble(const char *ensemble_file_name, const svm_ensemble *ensemble)
+{
+	FILE *fp = fopen(ensemble_file_name,"w");
+	if(fp==NULL) return -1;
+
+	char *old_locale = setlocale(LC_ALL, NULL);
+	if (old_locale) {
+		old_locale = strdup(old_locale);
+	}
+	setlocale(LC_ALL, "C");
+
+	fprintf(fp,"ensemble %d\n",ensemble->nr_model);
+	for(int k=0;k<ensemble->nr_model;k++)
+		save_model(fp,ensemble->model[k]);
+
+	setlocale(LC_ALL, old_locale);
+	free(old_locale);
+
+	if (ferror(fp) != 0 || fclose(fp) != 0) return -1;
+	else return 0;
+}
+
+svm_ensemble *svm_load_ensemble(const char *ensemble_file_name)
+{
+	FILE *fp = fopen(ensemble_file_name,"rb");
+	if(fp==NULL) return NULL;
+
+	char *old_locale = setlocale(LC_ALL, NULL);
+	if (old_locale) {
+		old_locale = strdup(old_locale);
+	}
+	setlocale(LC_ALL, "C");
+
+	// quietly NULL for a model file
+	svm_ensemble *ensemble = NULL;
+	char cmd[81];
+	int nr_model;
+	if(fscanf(fp,"%80s",cmd) == 1 && strcmp(cmd,"ensemble") == 0 &&
+	   fscanf(fp,"%d",&nr_model) == 1 && nr_model > 0)
+	{
+		ensemble = Malloc(svm_ensemble,1);
+		ensemble->model = Malloc(svm_model *,nr_model);
+		ensemble->nr_model = 0;
+		while(ensemble->nr_model < nr_model)
+		{
+			svm_model *model = load_model(fp);
+			if(model == NULL)
+				break;
+			ensemble->model[ensemble->nr_model++] = model;
+		}
+		if(ensemble->nr_model < nr_model)
+			svm_free_and_destroy_ensemble(&ensemble);
+	}
+
+	setlocale(LC_ALL, old_locale);
+	free(old_locale);
+
+	if (ferror(fp) != 0 || fclose(fp) != 0)
+	{
+		svm_free_and_destroy_ensemble(&ensemble);
+		return NULL;
+	}
+	return ensemble;
+}
+
 void svm_free_model_content(svm_model* model_ptr)
 {
 	if(model_ptr->free_sv && model_ptr->l > 0 && model_ptr->SV != NULL)
@@ -3150,12 +8578,279 @@ void svm_free_and_destroy_model(svm_model** model_ptr_ptr)
 	}
 }
 
+void svm_free_and_destroy_ensemble(svm_ensemble **ensemble_ptr_ptr)
+{
+	if(ensemble_ptr_ptr != NULL && *ensemble_ptr_ptr != NULL)
+	{
+		svm_ensemble *ensemble = *ensemble_ptr_ptr;
+		for(int k=0;k<ensemble->nr_model;k++)
+			svm_free_and_destroy_model(&ensemble->model[k]);
+		free(ensemble->model);
+		free(ensemble);
+		*ensemble_ptr_ptr = NULL;
+	}
+}
+
 void svm_destroy_param(svm_parameter* param)
 {
 	free(param->weight_label);
 	free(param->weight);
 }
 
+//
+// Problems mapped from a row file
+//
+// svm_convert_problem turns a file in the LIBSVM text format into
+//
+//	problem_file_header, svm_node x_space[nr_node], double y[l], int64_t start[l]
+//
+// where row i starts at x_space[start[i]] and ends with a node of index
+// -1, one line at a time. svm_map_problem maps the file read-only and uses
+// the rows in place, so only y and the row pointers take memory. Like
+// checkpoints, row files are binary files for the machine that wrote them.
+//
+struct problem_file_header
+{
+	char magic[8];
+	int64_t l;
+	int64_t nr_node;
+};
+
+struct mapped_problem
+{
+	svm_problem prob;	// first, so svm_unmap_problem can find the rest
+	void *base;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+};
+
+int svm_convert_problem(const char *text_file_name, const char *problem_file_name)
+{
+	FILE *in = fopen(text_file_name,"r");
+	if(in == NULL) return -1;
+	char *tmp_name = concat(problem_file_name,".tmp");
+	FILE *out = fopen(tmp_name,"wb");
+	if(out == NULL)
+	{
+		fclose(in);
+		free(tmp_name);
+		return -1;
+	}
+
+	char *old_locale = setlocale(LC_ALL, NULL);
+	if (old_locale) {
+		old_locale = strdup(old_locale);
+	}
+	setlocale(LC_ALL, "C");
+
+	problem_file_header h;
+	memset(&h,0,sizeof(h));
+	bool ok = write_values(out,&h,1);	// written again at the end
+	vector<double> y;
+	vector<int64_t> start;
+	int64_t nr_node = 0;
+	svm_node node;
+	memset(&node,0,sizeof(node));	// padding too, so the file is reproducible
+
+	max_line_len = 1024;
+	line = Malloc(char,max_line_len);
+	while(ok && readline(in) != NULL)
+	{
+		char *endptr;
+		char *label = strtok(line," \t\n");
+		ok = label != NULL && y.size() < INT_MAX;
+		if(ok)
+		{
+			y.push_back(strtod(label,&endptr));
+			ok = endptr != label && *endptr == '\0';
+		}
+		start.push_back(nr_node);
+		int last_index = -1;	// precomputed kernels start from index 0
+		while(ok)
+		{
+			char *idx = strtok(NULL,":");
+			char *val = strtok(NULL," \t");
+			if(val == NULL)
+				break;
+
+			errno = 0;
+			node.index = (int) strtol(idx,&endptr,10);
+			ok = endptr != idx && errno == 0 && *endptr == '\0' && node.index > last_index;
+			last_index = node.index;
+			if(ok)
+			{
+				errno = 0;
+				node.value = strtod(val,&endptr);
+				ok = endptr != val && errno == 0 && (*endptr == '\0' || isspace(*endptr)) &&
+					write_values(out,&node,1);
+				++nr_node;
+			}
+		}
+		if(!ok)
+			fprintf(stderr,"ERROR: wrong input format at line %d\n",(int)start.size());
+		node.index = -1;
+		node.value = 0;
+		ok = ok && write_values(out,&node,1);
+		++nr_node;
+	}
+	free(line);
+	line = NULL;
+	setlocale(LC_ALL, old_locale);
+	free(old_locale);
+
+	int l = (int)y.size();
+	if(ok)
+	{
+		memcpy(h.magic,"LIBSVMPR",8);
+		h.l = l;
+		h.nr_node = nr_node;
+		ok = ferror(in) == 0 && write_values(out,y.data(),l) && write_values(out,start.data(),l) &&
+			fseek(out,0,SEEK_SET) == 0 && write_values(out,&h,1);
+	}
+	fclose(in);
+	ok = fclose(out) == 0 && ok;
+	ok = ok && replace_file(tmp_name,problem_file_name);
+	if(!ok)
+		remove(tmp_name);
+	free(tmp_name);
+	return ok ? 0 : -1;
+}
+
+static void mapped_problem_destroy(mapped_problem *m)
+{
+	free(m->prob.y);
+	free(m->prob.x);
+#ifdef _WIN32
+	if(m->base != NULL)
+		UnmapViewOfFile(m->base);
+	if(m->mapping != NULL)
+		CloseHandle(m->mapping);
+	if(m->file != INVALID_HANDLE_VALUE)
+		CloseHandle(m->file);
+#else
+	if(m->base != NULL)
+		munmap(m->base,m->size);
+#endif
+	free(m);
+}
+
+// the problems svm_map_problem returned and svm_unmap_problem did not free
+static std::mutex mapped_mutex;
+static vector<mapped_problem *> mapped_problems;
+
+// check the layout and every node, as the solvers index arrays by the
+// feature index, and point the problem at the rows
+static bool mapped_problem_init(mapped_problem *m)
+{
+	const problem_file_header *h = (const problem_file_header *)m->base;
+	if(m->size < sizeof(*h) || memcmp(h->magic,"LIBSVMPR",8) != 0 ||
+	   h->l < 0 || h->l > INT_MAX || h->nr_node < h->l ||
+	   (uint64_t)h->nr_node > (m->size-sizeof(*h))/sizeof(svm_node))
+		return false;
+	int l = (int)h->l;
+	size_t nr_node = (size_t)h->nr_node;
+	if(m->size != sizeof(*h)+nr_node*sizeof(svm_node)+(size_t)l*(sizeof(double)+sizeof(int64_t)))
+		return false;
+
+	svm_node *x_space = (svm_node *)(h+1);
+	const double *y = (const double *)(x_space+nr_node);
+	const int64_t *start = (const int64_t *)(y+l);
+	for(int i=0;i<l;i++)
+	{
+		int64_t end = i+1 < l ? start[i+1] : (int64_t)nr_node;
+		if((i == 0 && start[i] != 0) || start[i] >= end || x_space[end-1].index != -1)
+			return false;
+		// indices ascend from 0 up to the terminating -1
+		int last_index = -1;
+		for(int64_t k=start[i];k<end-1;k++)
+		{
+			if(x_space[k].index <= last_index)
+				return false;
+			last_index = x_space[k].index;
+		}
+	}
+
+	m->prob.l = l;
+	m->prob.y = Malloc(double,l);
+	m->prob.x = Malloc(svm_node *,l);
+	for(int i=0;i<l;i++)
+	{
+		m->prob.y[i] = y[i];
+		m->prob.x[i] = &x_space[start[i]];
+	}
+	return true;
+}
+
+svm_problem *svm_map_problem(const char *problem_file_name)
+{
+	mapped_problem *m = Malloc(mapped_problem,1);
+	m->prob.l = 0;
+	m->prob.y = NULL;
+	m->prob.x = NULL;
+	m->base = NULL;
+	m->size = 0;
+#ifdef _WIN32
+	m->mapping = NULL;
+	m->file = CreateFileA(problem_file_name,GENERIC_READ,FILE_SHARE_READ,NULL,
+		OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	LARGE_INTEGER size;
+	if(m->file != INVALID_HANDLE_VALUE && GetFileSizeEx(m->file,&size) && size.QuadPart > 0 &&
+	   (uint64_t)size.QuadPart <= SIZE_MAX)
+	{
+		m->size = (size_t)size.QuadPart;
+		m->mapping = CreateFileMappingA(m->file,NULL,PAGE_READONLY,0,0,NULL);
+		if(m->mapping != NULL)
+			m->base = MapViewOfFile(m->mapping,FILE_MAP_READ,0,0,0);
+	}
+#else
+	int fd = open(problem_file_name,O_RDONLY);
+	struct stat st;
+	if(fd >= 0 && fstat(fd,&st) == 0 && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX)
+	{
+		m->size = (size_t)st.st_size;
+		void *base = mmap(NULL,m->size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(base != MAP_FAILED)
+			m->base = base;
+	}
+	if(fd >= 0)
+		close(fd);	// the mapping keeps the file
+#endif
+	if(m->base == NULL || !mapped_problem_init(m))
+	{
+		mapped_problem_destroy(m);
+		return NULL;
+	}
+	std::lock_guard<std::mutex> lock(mapped_mutex);
+	mapped_problems.push_back(m);
+	return &m->prob;
+}
+
+void svm_unmap_problem(svm_problem *prob)
+{
+	if(prob == NULL)
+		return;
+	mapped_problem *m = NULL;
+	{
+		std::lock_guard<std::mutex> lock(mapped_mutex);
+		for(size_t k=0;k<mapped_problems.size();k++)
+			if(&mapped_problems[k]->prob == prob)
+			{
+				m = mapped_problems[k];
+				mapped_problems.erase(mapped_problems.begin()+k);
+				break;
+			}
+	}
+	if(m == NULL)
+	{
+		fprintf(stderr,"WARNING: svm_unmap_problem: not a problem from svm_map_problem; left alone\n");
+		return;
+	}
+	mapped_problem_destroy(m);
+}
+
 const char *svm_check_parameter(const svm_problem *prob, const svm_parameter *param)
 {
 	// svm_type
@@ -3210,13 +8905,59 @@ const char *svm_check_parameter(const svm_problem *prob, const svm_parameter *pa
 			return "p < 0";
 
 	if(param->shrinking != 0 &&
-	   param->shrinking != 1)
-		return "shrinking != 0 and shrinking != 1";
+	   param->shrinking != 1 &&
+	   param->shrinking != 2)
+		return "shrinking != 0, 1 and 2";
 
 	if(param->probability != 0 &&
 	   param->probability != 1)
 		return "probability != 0 and probability != 1";
 
+	if(param->max_iter < 0)
+		return "max_iter < 0";
+
+	if(param->max_time < 0)
+		return "max_time < 0";
+
+	if(param->solver != SMO &&
+	   param->solver != DCD)
+		return "unknown solver";
+
+	if(param->solver == DCD &&
+	   ((kernel_type != LINEAR && param->nr_landmark == 0) ||
+	    (svm_type != C_SVC && svm_type != EPSILON_SVR)))
+		return "solver DCD is for C_SVC or EPSILON_SVR with the linear kernel or nr_landmark > 0";
+
+	if(param->working_set_size < 0 || param->working_set_size == 1 ||
+	   param->working_set_size > 1024)
+		return "working_set_size is not 0 or in [2,1024]";
+
+	if(param->cache_slack < 0 || param->cache_slack >= 1)
+		return "cache_slack < 0 or >= 1";
+
+	if(param->out_of_core != 0 &&
+	   param->out_of_core != 1)
+		return "out_of_core != 0 and out_of_core != 1";
+
+	if(param->nr_landmark < 0)
+		return "nr_landmark < 0";
+
+	if(param->nr_landmark > 0 &&
+	   (kernel_type == LINEAR || kernel_type == PRECOMPUTED))
+		return "nr_landmark > 0 is for the POLY, RBF and SIGMOID kernels";
+
+	if(param->landmark_iter < 0)
+		return "landmark_iter < 0";
+
+	if(param->screening != 0 &&
+	   param->screening != 1 &&
+	   param->screening != 2)
+		return "screening != 0, 1 and 2";
+
+	if(param->screening != 0 &&
+	   svm_type != C_SVC && svm_type != EPSILON_SVR)
+		return "screening is for C_SVC and EPSILON_SVR";
+
 
 	// check whether nu-svc is feasible
 
@@ -3291,3 +9032,9 @@ void svm_set_print_string_function(void (*print_func)(const char *))
 	else
 		svm_print_string = print_func;
 }
+
+void svm_set_progress_function(int (*progress_func)(const struct svm_progress *, void *), void *user)
+{
+	svm_progress_function = progress_func;
+	svm_progress_user = user;
+}
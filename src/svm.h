@@ -1,7 +1,7 @@
 #ifndef _LIBSVM_H
 #define _LIBSVM_H
 
-#define LIBSVM_VERSION 337
+#define LIBSVM_VERSION 340
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +24,7 @@ struct svm_problem
 
 enum { C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR };	/* svm_type */
 enum { LINEAR, POLY, RBF, SIGMOID, PRECOMPUTED }; /* kernel_type */
+enum { SMO, DCD };	/* solver */
 
 struct svm_parameter
 {
@@ -44,6 +45,15 @@ struct svm_parameter
 	double p;	/* for EPSILON_SVR */
 	int shrinking;	/* use the shrinking heuristics */
 	int probability; /* do probability estimates */
+	int max_iter;	/* iteration limit of each optimization, 0 for the default */
+	double max_time;	/* wall-clock limit of training in seconds, 0 for none */
+	int solver;	/* SMO, or DCD for C_SVC and EPSILON_SVR with LINEAR or nr_landmark > 0 */
+	int working_set_size;	/* variables optimized together by SMO, 0 for pairs */
+	double cache_slack;	/* fraction of gain SMO may give up for a cached column, 0 for none */
+	int out_of_core;	/* rows are read from a mapped file: no in-memory copies, columns filled in storage order */
+	int nr_landmark;	/* rank of a Nystrom approximation of the kernel, 0 for the exact kernel */
+	int landmark_iter;	/* k-means iterations placing the landmarks, 0 for a uniform sample */
+	int screening;	/* leave out likely non-SVs before training, 0 for none, 1 or 2 for more; verified afterwards */
 };
 
 //
@@ -72,11 +82,55 @@ struct svm_model
 				/* 0 if svm_model is created by svm_train */
 };
 
+//
+// svm_progress
+//
+struct svm_progress
+{
+	int l;			/* number of variables of this optimization */
+	int iter;		/* iterations so far */
+	double violation;	/* maximal violation Gmax+Gmax2 of the optimality condition */
+	int active_size;	/* variables left by shrinking */
+	double obj;		/* objective value (estimated while shrinking) */
+	double cache_hit_rate;	/* fraction of kernel columns found in the cache */
+	double elapsed;		/* seconds since this optimization started */
+	double gap;		/* duality gap of the solution on the final report, NAN before */
+	int stopped;		/* 1 on the final report if max_iter or max_time stopped the optimization */
+};
+
+//
+// svm_ensemble
+//
+struct svm_ensemble
+{
+	int nr_model;			/* number of member models */
+	struct svm_model **model;	/* members (model[nr_model]), all with the same kernel */
+};
+
 struct svm_model *svm_train(const struct svm_problem *prob, const struct svm_parameter *param);
+struct svm_model *svm_train_warm(const struct svm_problem *prob, const struct svm_parameter *param, const struct svm_model *init_model);
+void svm_train_path(const struct svm_problem *prob, const struct svm_parameter *param, int nr_value, const double *values, struct svm_model **models);
+struct svm_model *svm_train_cascade(const struct svm_problem *prob, const struct svm_parameter *param, int nr_partition, int nr_feedback);
+struct svm_model *svm_train_checkpoint(const struct svm_problem *prob, const struct svm_parameter *param, const char *checkpoint_file_name, double interval);
 void svm_cross_validation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, double *target);
+struct svm_model *svm_reduce_model(const struct svm_model *model, int nr_sv, double tolerance);
+struct svm_ensemble *svm_train_ensemble(const struct svm_problem *prob, const struct svm_parameter *param, int nr_model, int bootstrap);
 
 int svm_save_model(const char *model_file_name, const struct svm_model *model);
 struct svm_model *svm_load_model(const char *model_file_name);
+int svm_save_ensemble(const char *ensemble_file_name, const struct svm_ensemble *ensemble);
+struct svm_ensemble *svm_load_ensemble(const char *ensemble_file_name);
+
+int svm_convert_problem(const char *text_file_name, const char *problem_file_name);
+struct svm_problem *svm_map_problem(const char *problem_file_name);
+void svm_unmap_problem(struct svm_problem *prob);
+
+struct svm_incremental;
+struct svm_incremental *svm_incremental_create(const struct svm_problem *prob, const struct svm_parameter *param);
+int svm_incremental_add(struct svm_incremental *inc, const struct svm_node *x, double y);
+int svm_incremental_remove(struct svm_incremental *inc, int id);
+struct svm_model *svm_incremental_model(struct svm_incremental *inc);
+void svm_incremental_destroy(struct svm_incremental *inc);
 
 int svm_get_svm_type(const struct svm_model *model);
 int svm_get_nr_class(const struct svm_model *model);
@@ -88,15 +142,19 @@ double svm_get_svr_probability(const struct svm_model *model);
 double svm_predict_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
+double svm_predict_ensemble_values(const struct svm_ensemble *ensemble, const struct svm_node *x, double* dec_values);
+double svm_predict_ensemble(const struct svm_ensemble *ensemble, const struct svm_node *x);
 
 void svm_free_model_content(struct svm_model *model_ptr);
 void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);
+void svm_free_and_destroy_ensemble(struct svm_ensemble **ensemble_ptr_ptr);
 void svm_destroy_param(struct svm_parameter *param);
 
 const char *svm_check_parameter(const struct svm_problem *prob, const struct svm_parameter *param);
 int svm_check_probability_model(const struct svm_model *model);
 
 void svm_set_print_string_function(void (*print_func)(const char *));
+void svm_set_progress_function(int (*progress_func)(const struct svm_progress *progress, void *user), void *user);
 
 #ifdef __cplusplus
 }
@@ -111,6 +111,38 @@ TEST_F(ModelIOTest, LoadedModelDecisionValues) {
     }
 }
 
+TEST_F(ModelIOTest, LoadedModelHasDefaultTrainingOptions) {
+    auto builder = createLinearlySeperableData(30, 42);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.max_iter = 1000;
+    param.max_time = 60;
+    param.working_set_size = 4;
+    param.cache_slack = 0.1;
+    SvmModelGuard model(svm_train(prob, &param));
+    ASSERT_TRUE(model);
+
+    std::string model_path = createTempFile();
+    ASSERT_EQ(svm_save_model(model_path.c_str(), model.get()), 0);
+    SvmModelGuard loaded(svm_load_model(model_path.c_str()));
+    ASSERT_TRUE(loaded);
+
+    // training options are not saved and must not be left uninitialized
+    const svm_parameter& p = loaded->param;
+    EXPECT_EQ(p.nr_weight, 0);
+    EXPECT_EQ(p.weight_label, nullptr);
+    EXPECT_EQ(p.weight, nullptr);
+    EXPECT_EQ(p.max_iter, 0);
+    EXPECT_EQ(p.max_time, 0);
+    EXPECT_EQ(p.solver, SMO);
+    EXPECT_EQ(p.working_set_size, 0);
+    EXPECT_EQ(p.cache_slack, 0);
+    EXPECT_EQ(p.out_of_core, 0);
+    EXPECT_EQ(p.nr_landmark, 0);
+    EXPECT_EQ(p.landmark_iter, 0);
+    EXPECT_EQ(p.screening, 0);
+}
+
 // ===========================================================================
 // Different SVM Type Tests
 // ===========================================================================
@@ -218,6 +250,29 @@ TEST_F(ModelIOTest, SaveLoadLinearKernel) {
     EXPECT_EQ(loaded_model->param.kernel_type, LINEAR);
 }
 
+TEST_F(ModelIOTest, SaveLoadLinearDcdModel) {
+    auto builder = createMultiClassData(3, 30, 4, 42);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, LINEAR);
+    param.solver = DCD;
+
+    SvmModelGuard model(svm_train(prob, &param));
+    ASSERT_TRUE(model);
+    std::string model_path = createTempFile();
+
+    ASSERT_EQ(svm_save_model(model_path.c_str(), model.get()), 0);
+    SvmModelGuard loaded_model(svm_load_model(model_path.c_str()));
+    ASSERT_TRUE(loaded_model);
+
+    std::vector<double> dec(3), loaded_dec(3);
+    for (int i = 0; i < prob->l; ++i) {
+        svm_predict_values(model.get(), prob->x[i], dec.data());
+        svm_predict_values(loaded_model.get(), prob->x[i], loaded_dec.data());
+        for (int k = 0; k < 3; ++k)
+            EXPECT_NEAR(dec[k], loaded_dec[k], 1e-6);
+    }
+}
+
 TEST_F(ModelIOTest, SaveLoadPolynomialKernel) {
     auto builder = createXorData(20, 0.05, 42);
     svm_problem* prob = builder->build();
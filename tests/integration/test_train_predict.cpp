@@ -6,6 +6,9 @@
 #include <gtest/gtest.h>
 #include "svm.h"
 #include "test_utils.h"
+#include <atomic>
+#include <set>
+#include <thread>
 #include <vector>
 #include <cmath>
 
@@ -443,3 +446,1582 @@ TEST_F(TrainPredictTest, ClassWeights) {
     param.weight_label = nullptr;
     param.weight = nullptr;
 }
+
+// ===========================================================================
+// Warm Start Tests
+// ===========================================================================
+
+namespace {
+
+std::unique_ptr<SvmProblemBuilder> createDataFor(int svm_type) {
+    if (svm_type == EPSILON_SVR || svm_type == NU_SVR)
+        return createRegressionData(80, 0.1, 42);
+    if (svm_type == ONE_CLASS)
+        return createLinearlySeperableData(60, 42);
+    return createMultiClassData(3, 25, 4, 42);
+}
+
+struct ProgressLog {
+    std::vector<svm_progress> reports;
+    int cancel_after = -1;  // cancel once this many reports arrived
+};
+
+int recordProgress(const svm_progress* progress, void* user) {
+    ProgressLog* log = static_cast<ProgressLog*>(user);
+    log->reports.push_back(*progress);
+    return log->cancel_after >= 0 && (int)log->reports.size() >= log->cancel_after;
+}
+
+// Records the progress reports of one training call
+class ProgressRecorder {
+public:
+    ProgressRecorder() { svm_set_progress_function(&recordProgress, &log); }
+    ~ProgressRecorder() { svm_set_progress_function(nullptr, nullptr); }
+    ProgressLog log;
+};
+
+// The last report of every optimization: the one before the next start
+std::vector<svm_progress> finalReports(const ProgressLog& log) {
+    std::vector<svm_progress> last;
+    for (size_t k = 0; k < log.reports.size(); ++k)
+        if (k + 1 == log.reports.size() || log.reports[k + 1].iter == 0)
+            last.push_back(log.reports[k]);
+    return last;
+}
+
+int totalIterations(const ProgressLog& log) {
+    int total = 0;
+    for (const svm_progress& r : finalReports(log)) total += r.iter;
+    return total;
+}
+
+// The two models solve the same problem to the stopping tolerance, so
+// their decision values agree up to a small multiple of eps
+void expectSameDecisionValues(const svm_model* a, const svm_model* b, const svm_problem* prob) {
+    int nr_class = svm_get_nr_class(a);
+    int nr_dec = (a->param.svm_type == C_SVC || a->param.svm_type == NU_SVC) ?
+        nr_class * (nr_class - 1) / 2 : 1;
+    std::vector<double> dec_a(nr_dec), dec_b(nr_dec);
+    for (int i = 0; i < prob->l; ++i) {
+        svm_predict_values(a, prob->x[i], dec_a.data());
+        svm_predict_values(b, prob->x[i], dec_b.data());
+        for (int k = 0; k < nr_dec; ++k)
+            EXPECT_NEAR(dec_a[k], dec_b[k], 0.05) << "svm_type=" << a->param.svm_type << " i=" << i;
+    }
+}
+
+} // namespace
+
+TEST_F(TrainPredictTest, WarmStart_NullModelMatchesTrain) {
+    auto builder = createMultiClassData(3, 25, 4, 42);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+
+    SvmModelGuard cold(svm_train(prob, &param));
+    SvmModelGuard warm(svm_train_warm(prob, &param, nullptr));
+    ASSERT_TRUE(cold);
+    ASSERT_TRUE(warm);
+    ASSERT_EQ(cold->l, warm->l);
+    for (int k = 0; k < 3; ++k)
+        EXPECT_EQ(cold->rho[k], warm->rho[k]);
+}
+
+TEST_F(TrainPredictTest, WarmStart_FromOwnSolutionSkipsTheWork) {
+    auto builder = createXorData(300, 0.3, 7);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 10;
+
+    ProgressRecorder cold_progress;
+    SvmModelGuard cold(svm_train(prob, &param));
+    ASSERT_TRUE(cold);
+    int cold_iter = totalIterations(cold_progress.log);
+    ASSERT_GT(cold_iter, 100);
+
+    ProgressRecorder warm_progress;
+    SvmModelGuard warm(svm_train_warm(prob, &param, cold.get()));
+    ASSERT_TRUE(warm);
+    // the start already satisfies the stopping condition up to rounding
+    EXPECT_LT(totalIterations(warm_progress.log) * 10, cold_iter);
+    EXPECT_NEAR(warm->rho[0], cold->rho[0], 10 * param.eps);
+}
+
+TEST_F(TrainPredictTest, WarmStart_RepairsAnInfeasibleStart) {
+    for (int st : {C_SVC, NU_SVC, EPSILON_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        // previous model saw only the first 80% of the instances
+        svm_problem old_prob = *prob;
+        old_prob.l = prob->l * 4 / 5;
+
+        svm_parameter param = getDefaultParameter(st, RBF);
+        param.C = 10;
+        SvmModelGuard old_model(svm_train(&old_prob, &param));
+        ASSERT_TRUE(old_model);
+
+        // the old coefficients exceed the new bound; nu changes the sum
+        param.C = 0.5;
+        param.nu = 0.3;
+        ProgressRecorder progress;
+        SvmModelGuard warm(svm_train_warm(prob, &param, old_model.get()));
+        ASSERT_TRUE(warm);
+
+        // every optimization ends optimal ...
+        std::vector<svm_progress> last = finalReports(progress.log);
+        ASSERT_FALSE(last.empty());
+        for (const svm_progress& r : last)
+            EXPECT_LT(r.violation, param.eps) << "svm_type=" << st;
+        // ... and inside the new box (nu-SVC coefficients are rescaled)
+        if (st == NU_SVC) continue;
+        for (int c = 0; c < warm->nr_class - 1; ++c)
+            for (int k = 0; k < warm->l; ++k)
+                EXPECT_LE(std::fabs(warm->sv_coef[c][k]), param.C) << "svm_type=" << st;
+    }
+}
+
+// ===========================================================================
+// Regularization Path Tests
+// ===========================================================================
+
+TEST_F(TrainPredictTest, TrainPath_SingleValueMatchesTrain) {
+    for (int st : {C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        double value = (st == NU_SVC || st == ONE_CLASS) ? param.nu : param.C;
+
+        svm_model* path_model = nullptr;
+        svm_train_path(prob, &param, 1, &value, &path_model);
+        SvmModelGuard model(path_model);
+        SvmModelGuard reference(svm_train(prob, &param));
+        ASSERT_TRUE(model);
+        ASSERT_TRUE(reference);
+        ASSERT_EQ(model->l, reference->l);
+        EXPECT_EQ(model->rho[0], reference->rho[0]);
+    }
+}
+
+TEST_F(TrainPredictTest, TrainPath_WarmStartsEachValueFromTheLast) {
+    for (int st : {C_SVC, NU_SVC, EPSILON_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        std::vector<double> values;
+        if (st == NU_SVC)
+            values = {0.1, 0.2, 0.4, 0.6};
+        else
+            values = {0.125, 0.5, 2, 8, 32};
+
+        std::vector<svm_model*> models(values.size(), nullptr);
+        ProgressRecorder path_progress;
+        svm_train_path(prob, &param, (int)values.size(), values.data(), models.data());
+        std::vector<svm_progress> last = finalReports(path_progress.log);
+        int path_iter = totalIterations(path_progress.log);
+
+        int independent_iter = 0;
+        for (size_t v = 0; v < values.size(); ++v) {
+            SvmModelGuard model(models[v]);
+            ASSERT_TRUE(model);
+            svm_parameter param_v = param;
+            if (st == NU_SVC) {
+                param_v.nu = values[v];
+                EXPECT_EQ(model->param.nu, values[v]);
+            } else {
+                param_v.C = values[v];
+                EXPECT_EQ(model->param.C, values[v]);
+                for (int c = 0; c < model->nr_class - 1; ++c)
+                    for (int k = 0; k < model->l; ++k)
+                        EXPECT_LE(std::fabs(model->sv_coef[c][k]), values[v]);
+            }
+            ProgressRecorder progress;
+            SvmModelGuard reference(svm_train(prob, &param_v));
+            ASSERT_TRUE(reference);
+            independent_iter += totalIterations(progress.log);
+        }
+
+        // one optimization per value and pair, each ending optimal
+        int nr_pair = (st == EPSILON_SVR) ? 1 : 3;
+        ASSERT_EQ(last.size(), values.size() * nr_pair) << "svm_type=" << st;
+        for (const svm_progress& r : last)
+            EXPECT_LT(r.violation, param.eps) << "svm_type=" << st;
+        EXPECT_LT(path_iter, independent_iter) << "svm_type=" << st;
+    }
+}
+
+TEST_F(TrainPredictTest, TrainPath_ProbabilityModels) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.probability = 1;
+    double values[] = {0.5, 2, 8};
+    svm_model* models[3] = {nullptr, nullptr, nullptr};
+    svm_train_path(prob, &param, 3, values, models);
+    for (svm_model*& m : models) {
+        SvmModelGuard model(m);
+        ASSERT_TRUE(model);
+        EXPECT_EQ(svm_check_probability_model(model.get()), 1);
+    }
+}
+
+TEST_F(TrainPredictTest, Cascade_WithFeedbackMatchesTrain) {
+    for (int st : {C_SVC, EPSILON_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+
+        SvmModelGuard cascade(svm_train_cascade(prob, &param, 4, 20));
+        SvmModelGuard reference(svm_train(prob, &param));
+        ASSERT_TRUE(cascade);
+        ASSERT_TRUE(reference);
+        EXPECT_EQ(cascade->nr_class, reference->nr_class);
+        for (int k = 0; k < cascade->l; ++k) {
+            int i = cascade->sv_indices[k];
+            ASSERT_GE(i, 1);
+            ASSERT_LE(i, prob->l);
+            EXPECT_EQ(cascade->SV[k], prob->x[i - 1]);
+        }
+        expectSameDecisionValues(cascade.get(), reference.get(), prob);
+    }
+}
+
+TEST_F(TrainPredictTest, Cascade_OtherTypesFallBackToTrain) {
+    for (int st : {NU_SVC, ONE_CLASS, NU_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+
+        SvmModelGuard cascade(svm_train_cascade(prob, &param, 4, 1));
+        SvmModelGuard reference(svm_train(prob, &param));
+        ASSERT_TRUE(cascade);
+        ASSERT_TRUE(reference);
+        ASSERT_EQ(cascade->l, reference->l);
+        EXPECT_EQ(cascade->rho[0], reference->rho[0]);
+    }
+}
+
+TEST_F(TrainPredictTest, Shrinking_AutomaticShrinksAndConverges) {
+    // many bounded variables: shrinking pays, and the automatic mode
+    // must keep doing it and still reach the optimum
+    auto builder = createXorData(300, 0.3, 7);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 100;
+
+    param.shrinking = 0;
+    ProgressRecorder plain;
+    SvmModelGuard reference(svm_train(prob, &param));
+    ASSERT_TRUE(reference);
+    svm_progress whole = plain.log.reports.back();
+
+    param.shrinking = 2;
+    ProgressRecorder progress;
+    SvmModelGuard automatic(svm_train(prob, &param));
+    ASSERT_TRUE(automatic);
+    const std::vector<svm_progress>& reports = progress.log.reports;
+    ASSERT_FALSE(reports.empty());
+    int shrunk = 0;
+    for (const svm_progress& r : reports)
+        shrunk += r.active_size < r.l;
+    EXPECT_GT(shrunk, 0);
+    // the gradient is whole again at the end, and optimal
+    EXPECT_EQ(reports.back().active_size, reports.back().l);
+    EXPECT_LT(reports.back().violation, param.eps);
+    EXPECT_NEAR(reports.back().obj, whole.obj, 1e-3 * fabs(whole.obj));
+    EXPECT_LE(reports.back().iter, 2 * whole.iter);
+}
+
+TEST_F(TrainPredictTest, Shrinking_BoundedSupportVectorsMatchNoShrinking) {
+    // overlapping data keeps many variables moving on and off the bound
+    // for long enough to be shrunk, and the gradient rebuilt afterwards
+    // depends on G_bar having caught up with them
+    auto builder = createXorData(400, 0.5, 7);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 10;
+
+    param.shrinking = 1;
+    SvmModelGuard shrunk(svm_train(prob, &param));
+    param.shrinking = 0;
+    SvmModelGuard reference(svm_train(prob, &param));
+    ASSERT_TRUE(shrunk);
+    ASSERT_TRUE(reference);
+    expectSameDecisionValues(shrunk.get(), reference.get(), prob);
+}
+
+TEST_F(TrainPredictTest, WorkingSet_BlocksConvergeInFewerIterations) {
+    for (int st : {C_SVC, NU_SVC, EPSILON_SVR}) {
+        bool regression = st == EPSILON_SVR;
+        auto builder = regression ? createRegressionData(300, 0.3, 7) :
+            createXorData(150, 0.3, 7);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        param.C = 10;
+        SCOPED_TRACE(st);
+
+        ProgressRecorder pairs_progress;
+        SvmModelGuard pairs(svm_train(prob, &param));
+        ASSERT_TRUE(pairs);
+        svm_progress pairs_end = pairs_progress.log.reports.back();
+
+        // odd sizes, and blocks larger than the problem
+        for (int q : {3, 16, 1024}) {
+            param.working_set_size = q;
+            ProgressRecorder progress;
+            SvmModelGuard blocks(svm_train(prob, &param));
+            ASSERT_TRUE(blocks);
+            svm_progress end = progress.log.reports.back();
+            EXPECT_LT(end.violation, param.eps) << "q = " << q;
+            // three variables may not beat pairs, larger blocks must
+            if (q >= 16) {
+                EXPECT_LT(end.iter, pairs_end.iter) << "q = " << q;
+            }
+            EXPECT_NEAR(end.obj, pairs_end.obj, 1e-3 * fabs(pairs_end.obj)) << "q = " << q;
+        }
+
+        // an iteration is a block, and the limit counts those
+        param.working_set_size = 16;
+        param.max_iter = 5;
+        ProgressRecorder limited_progress;
+        SvmModelGuard limited(svm_train(prob, &param));
+        ASSERT_TRUE(limited);
+        for (const svm_progress& r : limited_progress.log.reports)
+            EXPECT_LE(r.iter, 5);
+    }
+}
+
+TEST_F(TrainPredictTest, CacheSlack_RaisesHitRateAndConverges) {
+    for (int st : {C_SVC, NU_SVC, EPSILON_SVR}) {
+        bool regression = st == EPSILON_SVR;
+        auto builder = regression ? createRegressionData(300, 0.3, 7) :
+            createXorData(150, 0.3, 7);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        param.C = 10;
+        // room for a few columns only, so the choice matters
+        param.cache_size = 0.01;
+        SCOPED_TRACE(st);
+
+        ProgressRecorder exact;
+        SvmModelGuard reference(svm_train(prob, &param));
+        ASSERT_TRUE(reference);
+        svm_progress exact_end = exact.log.reports.back();
+
+        param.cache_slack = 0.5;
+        ProgressRecorder slack;
+        SvmModelGuard cached(svm_train(prob, &param));
+        ASSERT_TRUE(cached);
+        svm_progress slack_end = slack.log.reports.back();
+
+        EXPECT_GT(slack_end.cache_hit_rate, exact_end.cache_hit_rate);
+        EXPECT_LT(slack_end.violation, param.eps);
+        EXPECT_NEAR(slack_end.obj, exact_end.obj, 1e-3 * fabs(exact_end.obj));
+    }
+}
+
+TEST_F(TrainPredictTest, Budget_IterationLimitReturnsFeasibleModel) {
+    auto builder = createMultiClassData(3, 40, 4, 42);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 100;
+    param.max_iter = 3;
+
+    ProgressRecorder limited_progress;
+    SvmModelGuard limited(svm_train(prob, &param));
+    ASSERT_TRUE(limited);
+    EXPECT_EQ(limited->nr_class, 3);
+    // every binary problem keeps its coefficients in [-C, C]
+    for (int k = 0; k < limited->nr_class - 1; ++k)
+        for (int i = 0; i < limited->l; ++i)
+            EXPECT_LE(std::fabs(limited->sv_coef[k][i]), param.C);
+
+    param.max_iter = 0;
+    ProgressRecorder full_progress;
+    SvmModelGuard full(svm_train(prob, &param));
+    ASSERT_TRUE(full);
+    EXPECT_NE(limited->rho[0], full->rho[0]);
+
+    // the final report of each pair tells whether the budget stopped it,
+    // and with which duality gap; the reports before have none
+    std::vector<svm_progress> limited_end = finalReports(limited_progress.log);
+    std::vector<svm_progress> full_end = finalReports(full_progress.log);
+    ASSERT_EQ(limited_end.size(), 3u);
+    ASSERT_EQ(full_end.size(), 3u);
+    for (size_t p = 0; p < 3; ++p) {
+        EXPECT_EQ(limited_end[p].stopped, 1);
+        EXPECT_EQ(full_end[p].stopped, 0);
+        EXPECT_GE(full_end[p].gap, 0);
+        EXPECT_GT(limited_end[p].gap, full_end[p].gap);
+    }
+    for (const svm_progress& r : limited_progress.log.reports) {
+        if (r.iter < 3) {
+            EXPECT_TRUE(std::isnan(r.gap));
+            EXPECT_EQ(r.stopped, 0);
+        }
+    }
+
+    // so does that of dual coordinate descent
+    param.kernel_type = LINEAR;
+    param.solver = 1;
+    param.max_iter = 1;
+    ProgressRecorder dcd_progress;
+    SvmModelGuard dcd(svm_train(prob, &param));
+    ASSERT_TRUE(dcd);
+    std::vector<svm_progress> dcd_end = finalReports(dcd_progress.log);
+    ASSERT_EQ(dcd_end.size(), 3u);
+    for (const svm_progress& r : dcd_end) {
+        EXPECT_EQ(r.stopped, 1);
+        EXPECT_TRUE(std::isfinite(r.gap));
+    }
+}
+
+TEST_F(TrainPredictTest, Budget_TimeLimitStopsTraining) {
+    for (int st : {C_SVC, NU_SVC, EPSILON_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        param.max_time = 1e-9;
+        param.probability = (st != NU_SVC);
+
+        SvmModelGuard model(svm_train(prob, &param));
+        ASSERT_TRUE(model);
+        EXPECT_EQ(model->param.max_time, 1e-9);
+        for (int i = 0; i < prob->l; ++i)
+            EXPECT_TRUE(std::isfinite(svm_predict(model.get(), prob->x[i])));
+    }
+}
+
+TEST_F(TrainPredictTest, Progress_ReportsConvergence) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 100;
+    param.cache_size = 0.01;
+
+    ProgressLog log;
+    svm_set_progress_function(&recordProgress, &log);
+    SvmModelGuard model(svm_train(prob, &param));
+    svm_set_progress_function(nullptr, nullptr);
+    ASSERT_TRUE(model);
+
+    // each of the three pairs reports at least at its start and end
+    ASSERT_GE(log.reports.size(), 6u);
+    int starts = 0;
+    for (size_t k = 0; k < log.reports.size(); ++k) {
+        const svm_progress& r = log.reports[k];
+        EXPECT_LE(r.active_size, r.l);
+        EXPECT_GE(r.cache_hit_rate, 0.0);
+        EXPECT_LE(r.cache_hit_rate, 1.0);
+        EXPECT_GE(r.elapsed, 0.0);
+        if (r.iter == 0) {
+            ++starts;
+            if (k > 0) {
+                EXPECT_LT(log.reports[k - 1].violation, param.eps);
+            }
+        } else {
+            ASSERT_GT(k, 0u);
+            EXPECT_GT(r.iter, log.reports[k - 1].iter);
+        }
+    }
+    EXPECT_EQ(starts, 3);
+    EXPECT_LT(log.reports.back().violation, param.eps);
+}
+
+TEST_F(TrainPredictTest, Progress_CancelStopsTraining) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+
+    ProgressLog log;
+    log.cancel_after = 1;
+    svm_set_progress_function(&recordProgress, &log);
+    SvmModelGuard model(svm_train(prob, &param));
+    EXPECT_FALSE(model);
+    // the other pairs are not even started
+    EXPECT_EQ(log.reports.size(), 1u);
+
+    // the cancel ended with that call
+    log.cancel_after = -1;
+    SvmModelGuard next(svm_train(prob, &param));
+    svm_set_progress_function(nullptr, nullptr);
+    EXPECT_TRUE(next);
+    EXPECT_GT(log.reports.size(), 1u);
+}
+
+namespace {
+struct ConcurrencyLog {
+    std::atomic<int> inside{0};
+    std::atomic<int> most_inside{0};
+    std::atomic<int> calls{0};
+    int cancel_after = -1;
+};
+
+int recordConcurrency(const svm_progress*, void* user) {
+    ConcurrencyLog* log = static_cast<ConcurrencyLog*>(user);
+    int now = ++log->inside;
+    if (now > log->most_inside)
+        log->most_inside = now;
+    std::this_thread::yield();
+    int calls = ++log->calls;
+    --log->inside;
+    return log->cancel_after >= 0 && calls >= log->cancel_after;
+}
+}
+
+TEST_F(TrainPredictTest, Progress_CascadeCallsAreSerialized) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+
+    ConcurrencyLog log;
+    svm_set_progress_function(&recordConcurrency, &log);
+    SvmModelGuard model(svm_train_cascade(prob, &param, 4, 1));
+    ASSERT_TRUE(model);
+    EXPECT_GT(log.calls, 0);
+    EXPECT_EQ(log.most_inside, 1);
+
+    // a cancel from any node cancels the whole cascade
+    ConcurrencyLog cancel_log;
+    cancel_log.cancel_after = 2;
+    svm_set_progress_function(&recordConcurrency, &cancel_log);
+    SvmModelGuard cancelled(svm_train_cascade(prob, &param, 4, 1));
+    svm_set_progress_function(nullptr, nullptr);
+    EXPECT_FALSE(cancelled);
+    EXPECT_EQ(cancel_log.calls, 2);
+}
+
+namespace {
+// the same models, bit for bit
+void expectIdenticalModels(const svm_model* a, const svm_model* b) {
+    ASSERT_EQ(a->nr_class, b->nr_class);
+    ASSERT_EQ(a->l, b->l);
+    int nr_dec = (a->param.svm_type == C_SVC || a->param.svm_type == NU_SVC) ?
+        a->nr_class * (a->nr_class - 1) / 2 : 1;
+    for (int k = 0; k < nr_dec; ++k)
+        EXPECT_EQ(a->rho[k], b->rho[k]);
+    for (int k = 0; k < a->l; ++k) {
+        EXPECT_EQ(a->sv_indices[k], b->sv_indices[k]);
+        for (int c = 0; c < a->nr_class - 1; ++c)
+            EXPECT_EQ(a->sv_coef[c][k], b->sv_coef[c][k]);
+    }
+}
+
+bool fileExists(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp)
+        fclose(fp);
+    return fp != nullptr;
+}
+}
+
+TEST_F(TrainPredictTest, Checkpoint_ResumeMatchesUninterruptedTraining) {
+    for (int st : {C_SVC, EPSILON_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        param.C = 100;
+        std::string file = getTempFilePath(".checkpoint");
+        SvmModelGuard reference(svm_train(prob, &param));
+        ASSERT_TRUE(reference);
+
+        // stopped in the middle of the first optimization, which leaves
+        // its state; max_iter is not part of the problem
+        param.max_iter = 10;
+        SvmModelGuard stopped(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+        ASSERT_TRUE(stopped);
+        EXPECT_TRUE(fileExists(file + ".solver"));
+
+        param.max_iter = 0;
+        SvmModelGuard resumed(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+        ASSERT_TRUE(resumed);
+        expectIdenticalModels(resumed.get(), reference.get());
+        EXPECT_FALSE(fileExists(file + ".solver"));
+
+        // everything is finished now; nothing is solved again
+        ProgressLog log;
+        svm_set_progress_function(&recordProgress, &log);
+        SvmModelGuard again(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+        svm_set_progress_function(nullptr, nullptr);
+        ASSERT_TRUE(again);
+        EXPECT_TRUE(log.reports.empty());
+        expectIdenticalModels(again.get(), reference.get());
+        deleteTempFile(file);
+    }
+}
+
+TEST_F(TrainPredictTest, Checkpoint_CancelledPairsAreSolvedAgain) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    std::string file = getTempFilePath(".checkpoint");
+    SvmModelGuard reference(svm_train(prob, &param));
+    ASSERT_TRUE(reference);
+
+    // the first pair finishes, the second is cancelled at its start
+    ProgressLog log;
+    log.cancel_after = 3;
+    svm_set_progress_function(&recordProgress, &log);
+    SvmModelGuard stopped(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    svm_set_progress_function(nullptr, nullptr);
+    EXPECT_FALSE(stopped);
+    ASSERT_EQ(log.reports.size(), 3u);
+    EXPECT_EQ(log.reports[2].iter, 0);
+
+    SvmModelGuard resumed(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    ASSERT_TRUE(resumed);
+    expectIdenticalModels(resumed.get(), reference.get());
+    deleteTempFile(file);
+}
+
+TEST_F(TrainPredictTest, Checkpoint_OtherProblemIsIgnored) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    std::string file = getTempFilePath(".checkpoint");
+
+    SvmModelGuard first(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    ASSERT_TRUE(first);
+    param.C = 10;
+    SvmModelGuard second(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    SvmModelGuard reference(svm_train(prob, &param));
+    ASSERT_TRUE(second);
+    ASSERT_TRUE(reference);
+    expectIdenticalModels(second.get(), reference.get());
+    deleteTempFile(file);
+}
+
+TEST_F(TrainPredictTest, Checkpoint_ProbabilityOutputsResume) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 100;
+    param.probability = 1;
+    std::string file = getTempFilePath(".checkpoint");
+    SvmModelGuard reference(svm_train(prob, &param));
+    ASSERT_TRUE(reference);
+
+    // rand() moves on in between; the cross validation does not use it
+    param.max_iter = 10;
+    SvmModelGuard stopped(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    ASSERT_TRUE(stopped);
+    for (int k = 0; k < 100; ++k)
+        rand();
+    param.max_iter = 0;
+    SvmModelGuard resumed(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    ASSERT_TRUE(resumed);
+    expectIdenticalModels(resumed.get(), reference.get());
+    for (int k = 0; k < 3; ++k) {
+        EXPECT_EQ(resumed->probA[k], reference->probA[k]);
+        EXPECT_EQ(resumed->probB[k], reference->probB[k]);
+    }
+    deleteTempFile(file);
+}
+
+TEST_F(TrainPredictTest, Checkpoint_OtherFormatVersionStartsOver) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 100;
+    std::string file = getTempFilePath(".checkpoint");
+    SvmModelGuard reference(svm_train(prob, &param));
+    ASSERT_TRUE(reference);
+
+    // the version follows the 8-byte magic in both files
+    param.max_iter = 10;
+    SvmModelGuard stopped(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    ASSERT_TRUE(stopped);
+    for (const std::string& name : {file, file + ".solver"}) {
+        FILE* fp = fopen(name.c_str(), "r+b");
+        ASSERT_NE(fp, nullptr);
+        int version;
+        ASSERT_EQ(fseek(fp, 8, SEEK_SET), 0);
+        ASSERT_EQ(fread(&version, sizeof(int), 1, fp), 1u);
+        ++version;
+        ASSERT_EQ(fseek(fp, 8, SEEK_SET), 0);
+        ASSERT_EQ(fwrite(&version, sizeof(int), 1, fp), 1u);
+        fclose(fp);
+    }
+
+    param.max_iter = 0;
+    ProgressLog log;
+    svm_set_progress_function(&recordProgress, &log);
+    SvmModelGuard resumed(svm_train_checkpoint(prob, &param, file.c_str(), 0));
+    svm_set_progress_function(nullptr, nullptr);
+    ASSERT_TRUE(resumed);
+    ASSERT_FALSE(log.reports.empty());
+    EXPECT_EQ(log.reports[0].iter, 0);
+    expectIdenticalModels(resumed.get(), reference.get());
+    deleteTempFile(file);
+}
+
+TEST_F(TrainPredictTest, Checkpoint_ChangedSettingsStartOver) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 100;
+    std::string file = getTempFilePath(".checkpoint");
+
+    // each change of the solver settings, or of the data in a way a sum
+    // of the values would miss, must not continue the saved state
+    for (int change = 0; change < 3; ++change) {
+        svm_parameter saved = param;
+        saved.max_iter = 10;
+        SvmModelGuard stopped(svm_train_checkpoint(prob, &saved, file.c_str(), 0));
+        ASSERT_TRUE(stopped);
+        ASSERT_TRUE(fileExists(file + ".solver"));
+
+        svm_parameter other = param;
+        svm_node *a = prob->x[0], *b = prob->x[1];
+        if (change == 0)
+            other.shrinking = 0;
+        else if (change == 1)
+            other.working_set_size = 4;
+        else
+            std::swap(a[0].value, b[0].value);
+        SvmModelGuard reference(svm_train(prob, &other));
+        ProgressLog log;
+        svm_set_progress_function(&recordProgress, &log);
+        SvmModelGuard resumed(svm_train_checkpoint(prob, &other, file.c_str(), 0));
+        svm_set_progress_function(nullptr, nullptr);
+        ASSERT_TRUE(reference);
+        ASSERT_TRUE(resumed);
+        ASSERT_FALSE(log.reports.empty());
+        EXPECT_EQ(log.reports[0].iter, 0) << "change " << change;
+        expectIdenticalModels(resumed.get(), reference.get());
+        if (change == 2)
+            std::swap(a[0].value, b[0].value);
+        deleteTempFile(file);
+    }
+}
+
+TEST_F(TrainPredictTest, Shrinking_ReconstructionDoesNotDependOnCache) {
+    // the rebuilt gradient takes kernel entries from cached columns, cached
+    // rows or fresh evaluations, which must all give the same model, also
+    // with the twin columns of SVR
+    for (int st : {C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR}) {
+        bool regression = st == EPSILON_SVR || st == NU_SVR;
+        auto builder = regression ? createRegressionData(600, 0.3, 7) :
+            createXorData(400, 0.5, 7);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        param.C = 10;
+
+        param.cache_size = 100;
+        SvmModelGuard large(svm_train(prob, &param));
+        param.cache_size = 0.01;
+        SvmModelGuard small(svm_train(prob, &param));
+        ASSERT_TRUE(large);
+        ASSERT_TRUE(small);
+        SCOPED_TRACE(st);
+        expectIdenticalModels(small.get(), large.get());
+    }
+}
+
+TEST_F(TrainPredictTest, Dcd_LinearAgreesWithSmo) {
+    for (int st : {C_SVC, EPSILON_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, LINEAR);
+
+        SvmModelGuard smo(svm_train(prob, &param));
+        param.solver = DCD;
+        SvmModelGuard dcd(svm_train(prob, &param));
+        ASSERT_TRUE(smo);
+        ASSERT_TRUE(dcd);
+        EXPECT_EQ(dcd->param.solver, DCD);
+
+        // the bias is regularized in DCD, so the solutions are close
+        // rather than equal
+        int agree = 0;
+        for (int i = 0; i < prob->l; ++i) {
+            double a = svm_predict(smo.get(), prob->x[i]);
+            double b = svm_predict(dcd.get(), prob->x[i]);
+            if (st == C_SVC)
+                agree += (a == b);
+            else
+                agree += (std::fabs(a - b) < 0.1);
+        }
+        EXPECT_GE(agree, prob->l * 95 / 100) << "svm_type=" << st;
+    }
+}
+
+TEST_F(TrainPredictTest, Dcd_WarmStartFromSolution) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, LINEAR);
+    param.solver = DCD;
+    param.eps = 0.1;
+
+    ProgressLog cold_log;
+    svm_set_progress_function(&recordProgress, &cold_log);
+    SvmModelGuard cold(svm_train(prob, &param));
+    ProgressLog warm_log;
+    svm_set_progress_function(&recordProgress, &warm_log);
+    SvmModelGuard warm(svm_train_warm(prob, &param, cold.get()));
+    svm_set_progress_function(nullptr, nullptr);
+    ASSERT_TRUE(cold);
+    ASSERT_TRUE(warm);
+    // starting from the solution, each pair needs fewer passes
+    EXPECT_LT(warm_log.reports.size(), cold_log.reports.size());
+    for (int i = 0; i < prob->l; ++i)
+        EXPECT_EQ(svm_predict(warm.get(), prob->x[i]),
+                  svm_predict(cold.get(), prob->x[i]));
+}
+
+namespace {
+void writeProblem(const svm_problem* prob, const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "w");
+    ASSERT_NE(fp, nullptr);
+    for (int i = 0; i < prob->l; ++i) {
+        fprintf(fp, "%.17g", prob->y[i]);
+        for (const svm_node* p = prob->x[i]; p->index != -1; ++p)
+            fprintf(fp, " %d:%.17g", p->index, p->value);
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+}
+}
+
+TEST_F(TrainPredictTest, OutOfCore_MappedProblemConverges) {
+    // classes are grouped, so storage order is not the solver's order;
+    // SVR fills two positions per stored row
+    for (int st : {C_SVC, EPSILON_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        std::string text = getTempFilePath(".txt");
+        std::string rows = getTempFilePath(".rows");
+        writeProblem(prob, text);
+        ASSERT_EQ(svm_convert_problem(text.c_str(), rows.c_str()), 0);
+        svm_problem* mapped = svm_map_problem(rows.c_str());
+        ASSERT_NE(mapped, nullptr);
+        ASSERT_EQ(mapped->l, prob->l);
+        for (int i = 0; i < prob->l; ++i) {
+            EXPECT_EQ(mapped->y[i], prob->y[i]);
+            const svm_node *p = prob->x[i], *q = mapped->x[i];
+            for (; p->index != -1; ++p, ++q) {
+                EXPECT_EQ(q->index, p->index);
+                EXPECT_EQ(q->value, p->value);
+            }
+            EXPECT_EQ(q->index, -1);
+        }
+
+        {
+            // a small cache makes shrinking fill partial columns too
+            svm_parameter param = getDefaultParameter(st, RBF);
+            param.C = 10;
+            param.cache_size = 0.01;
+            ProgressRecorder memory_progress;
+            SvmModelGuard in_memory(svm_train(prob, &param));
+            ASSERT_TRUE(in_memory);
+            std::vector<svm_progress> memory_end = finalReports(memory_progress.log);
+
+            param.out_of_core = 1;
+            ProgressRecorder file_progress;
+            SvmModelGuard from_file(svm_train(mapped, &param));
+            ASSERT_TRUE(from_file);
+            std::vector<svm_progress> file_end = finalReports(file_progress.log);
+
+            ASSERT_EQ(file_end.size(), memory_end.size());
+            for (size_t k = 0; k < file_end.size(); ++k) {
+                EXPECT_LT(file_end[k].violation, param.eps);
+                EXPECT_NEAR(file_end[k].obj, memory_end[k].obj, 1e-3 * fabs(memory_end[k].obj));
+            }
+            // the SVs point into the mapping
+            for (int k = 0; k < from_file->l; ++k)
+                EXPECT_EQ(from_file->SV[k], mapped->x[from_file->sv_indices[k] - 1]);
+        }
+        svm_unmap_problem(mapped);
+        deleteTempFile(text);
+        deleteTempFile(rows);
+    }
+}
+
+TEST_F(TrainPredictTest, OutOfCore_RejectsMalformedFiles) {
+    std::string text = getTempFilePath(".txt");
+    std::string rows = getTempFilePath(".rows");
+    FILE* fp = fopen(text.c_str(), "w");
+    ASSERT_NE(fp, nullptr);
+    fprintf(fp, "1 1:0.5 2:1\n-1 2:1 1:0.5\n");	// indices must ascend
+    fclose(fp);
+    EXPECT_EQ(svm_convert_problem(text.c_str(), rows.c_str()), -1);
+    EXPECT_EQ(svm_map_problem(rows.c_str()), nullptr);
+    // a text file is not a problem file
+    EXPECT_EQ(svm_map_problem(text.c_str()), nullptr);
+
+    // a converted file whose nodes were changed afterwards: the header
+    // is three 8-byte fields, then the nodes of "1 1:0.5 2:1"
+    fp = fopen(text.c_str(), "w");
+    ASSERT_NE(fp, nullptr);
+    fprintf(fp, "1 1:0.5 2:1\n-1 1:1\n");
+    fclose(fp);
+    for (int bad_index : {-5, 1, 0}) {
+        ASSERT_EQ(svm_convert_problem(text.c_str(), rows.c_str()), 0);
+        svm_problem* good = svm_map_problem(rows.c_str());
+        ASSERT_NE(good, nullptr);
+        svm_unmap_problem(good);
+        fp = fopen(rows.c_str(), "r+b");
+        ASSERT_NE(fp, nullptr);
+        long offset = 24 + (bad_index == -5 ? 0 : (long)sizeof(svm_node));
+        ASSERT_EQ(fseek(fp, offset, SEEK_SET), 0);
+        ASSERT_EQ(fwrite(&bad_index, sizeof(int), 1, fp), 1u);
+        fclose(fp);
+        EXPECT_EQ(svm_map_problem(rows.c_str()), nullptr) << "index " << bad_index;
+    }
+    deleteTempFile(text);
+    deleteTempFile(rows);
+}
+
+TEST_F(TrainPredictTest, OutOfCore_UnmapLeavesOtherProblemsAlone) {
+    auto builder = createDataFor(C_SVC);
+    svm_problem* prob = builder->build();
+    svm_unmap_problem(prob);
+    ASSERT_NE(prob->x, nullptr);
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    SvmModelGuard model(svm_train(prob, &param));
+    EXPECT_TRUE(model);
+}
+
+double rbfKernel(const svm_node* a, const svm_node* b, double gamma) {
+    double d = 0;
+    while (a->index != -1 && b->index != -1) {
+        if (a->index == b->index) {
+            d += (a->value - b->value) * (a->value - b->value);
+            ++a;
+            ++b;
+        } else if (a->index < b->index) {
+            d += a->value * a->value;
+            ++a;
+        } else {
+            d += b->value * b->value;
+            ++b;
+        }
+    }
+    for (; a->index != -1; ++a) d += a->value * a->value;
+    for (; b->index != -1; ++b) d += b->value * b->value;
+    return exp(-gamma * d);
+}
+
+// |w-w'|/|w| over the coefficient vectors of every class (or the single
+// one of a regression or one-class model), computed from the kernel
+struct ReductionError {
+    double relative = 0;
+    double max_on_picks = 0;  // largest |<w-w',phi(SV')>|, 0 for a projection
+};
+
+ReductionError reductionError(const svm_model* model, const svm_model* reduced) {
+    bool classification = model->param.svm_type == C_SVC || model->param.svm_type == NU_SVC;
+    int nr_group = classification ? model->nr_class : 1;
+    int nr_out = classification ? model->nr_class - 1 : 1;
+    double gamma = model->param.gamma;
+    ReductionError err;
+    double diff = 0, norm = 0;
+    int start = 0, start_r = 0;
+    for (int c = 0; c < nr_group; ++c) {
+        int l = classification ? model->nSV[c] : model->l;
+        int l_r = classification ? reduced->nSV[c] : reduced->l;
+        for (int o = 0; o < nr_out; ++o) {
+            // residual w-w' as one expansion over the SVs of both models
+            std::vector<const svm_node*> x;
+            std::vector<double> coef;
+            for (int i = 0; i < l; ++i) {
+                x.push_back(model->SV[start + i]);
+                coef.push_back(model->sv_coef[o][start + i]);
+            }
+            for (int i = 0; i < l_r; ++i) {
+                x.push_back(reduced->SV[start_r + i]);
+                coef.push_back(-reduced->sv_coef[o][start_r + i]);
+            }
+            for (size_t i = 0; i < x.size(); ++i) {
+                double r = 0;
+                for (size_t j = 0; j < x.size(); ++j) {
+                    double k = rbfKernel(x[i], x[j], gamma);
+                    r += coef[j] * k;
+                    if (i < (size_t)l && j < (size_t)l)
+                        norm += coef[i] * coef[j] * k;
+                }
+                diff += coef[i] * r;
+                if (i >= (size_t)l)
+                    err.max_on_picks = std::max(err.max_on_picks, std::fabs(r));
+            }
+        }
+        start += l;
+        start_r += l_r;
+    }
+    err.relative = norm > 0 ? sqrt(std::max(diff, 0.0) / norm) : 0;
+    return err;
+}
+
+TEST_F(TrainPredictTest, Reduce_ErrorFollowsBudgetAndTolerance) {
+    for (int st : {C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        SvmModelGuard model(svm_train(prob, &param));
+        ASSERT_TRUE(model);
+        int l = model->l;
+
+        // each budget is met exactly, w' is the projection of w on the
+        // kept SVs, and a larger budget keeps the earlier picks
+        double last = 1;
+        for (int budget : {1, l / 8, l / 4, l / 2}) {
+            if (budget < 1)
+                continue;
+            SvmModelGuard reduced(svm_reduce_model(model.get(), budget, 0));
+            ASSERT_TRUE(reduced);
+            EXPECT_EQ(reduced->l, budget) << "svm_type=" << st;
+            ReductionError err = reductionError(model.get(), reduced.get());
+            EXPECT_LT(err.max_on_picks, 1e-6) << "svm_type=" << st << " budget=" << budget;
+            EXPECT_LE(err.relative, last + 1e-9) << "svm_type=" << st << " budget=" << budget;
+            last = err.relative;
+        }
+
+        // a tolerance is reached with fewer SVs the looser it is; 0 keeps
+        // as many as it takes to reproduce w
+        int last_l = l + 1;
+        for (double tolerance : {0.0, 0.01, 0.1, 0.3}) {
+            SvmModelGuard reduced(svm_reduce_model(model.get(), 0, tolerance));
+            ASSERT_TRUE(reduced);
+            ReductionError err = reductionError(model.get(), reduced.get());
+            EXPECT_LE(err.relative, std::max(tolerance, 1e-6)) << "svm_type=" << st << " tolerance=" << tolerance;
+            EXPECT_LE(reduced->l, last_l) << "svm_type=" << st << " tolerance=" << tolerance;
+            last_l = reduced->l;
+        }
+        EXPECT_LT(last_l, l) << "svm_type=" << st;
+    }
+}
+
+TEST_F(TrainPredictTest, Reduce_BudgetKeepsAccuracy) {
+    auto train = createXorData(400, 0.1, 7);
+    auto test = createXorData(400, 0.1, 8);
+    svm_problem* prob = train->build();
+    svm_problem* test_prob = test->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 10;
+    SvmModelGuard model(svm_train(prob, &param));
+    ASSERT_TRUE(model);
+
+    int budget = model->l / 5;
+    SvmModelGuard reduced(svm_reduce_model(model.get(), budget, 0));
+    ASSERT_TRUE(reduced);
+    EXPECT_EQ(reduced->l, budget);
+    EXPECT_EQ(reduced->nSV[0] + reduced->nSV[1], budget);
+
+    int agree = 0;
+    for (int i = 0; i < test_prob->l; ++i)
+        agree += svm_predict(model.get(), test_prob->x[i]) ==
+                 svm_predict(reduced.get(), test_prob->x[i]);
+    EXPECT_GE(agree, test_prob->l * 95 / 100);
+
+    // a tolerance stops earlier, and the reduced model can be saved
+    SvmModelGuard coarse(svm_reduce_model(model.get(), 0, 0.5));
+    ASSERT_TRUE(coarse);
+    EXPECT_LT(coarse->l, model->l);
+    std::string file = getTempFilePath();
+    ASSERT_EQ(svm_save_model(file.c_str(), coarse.get()), 0);
+    SvmModelGuard loaded(svm_load_model(file.c_str()));
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->l, coarse->l);
+    for (int i = 0; i < test_prob->l; ++i)
+        EXPECT_EQ(svm_predict(loaded.get(), test_prob->x[i]),
+                  svm_predict(coarse.get(), test_prob->x[i]));
+    deleteTempFile(file);
+}
+
+TEST_F(TrainPredictTest, Incremental_MatchesRetraining) {
+    auto data = createXorData(100, 0.1, 11);
+    svm_problem* all = data->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 10;
+    param.eps = 1e-5;
+
+    // start from the even instances, add the odd ones, then remove every
+    // other one of the start
+    std::vector<double> y0;
+    std::vector<svm_node*> x0;
+    for (int i = 0; i < all->l; i += 2) {
+        y0.push_back(all->y[i]);
+        x0.push_back(all->x[i]);
+    }
+    svm_problem first = {(int)y0.size(), y0.data(), x0.data()};
+    svm_incremental* inc = svm_incremental_create(&first, &param);
+    ASSERT_NE(inc, nullptr);
+    SvmModelGuard initial(svm_incremental_model(inc));
+    ASSERT_TRUE(initial);
+    EXPECT_EQ(initial->l, SvmModelGuard(svm_train(&first, &param))->l);
+    // ids number the instances of first from 1, then the added ones
+    std::vector<svm_node*> by_id(1);
+    by_id.insert(by_id.end(), x0.begin(), x0.end());
+    for (int i = 1; i < all->l; i += 2) {
+        ASSERT_EQ(svm_incremental_add(inc, all->x[i], all->y[i]), (int)by_id.size());
+        by_id.push_back(all->x[i]);
+    }
+    EXPECT_EQ(svm_incremental_add(inc, all->x[0], 3), -1);
+    EXPECT_EQ(svm_incremental_remove(inc, 0), -1);
+    EXPECT_EQ(svm_incremental_remove(inc, (int)by_id.size()), -1);
+
+    std::vector<double> y;
+    std::vector<svm_node*> x;
+    for (int i = 0; i < first.l; ++i) {
+        if (i % 2 == 0) {
+            ASSERT_EQ(svm_incremental_remove(inc, i + 1), 0);
+        } else {
+            y.push_back(first.y[i]);
+            x.push_back(first.x[i]);
+        }
+    }
+    for (int i = 1; i < all->l; i += 2) {
+        y.push_back(all->y[i]);
+        x.push_back(all->x[i]);
+    }
+    EXPECT_EQ(svm_incremental_remove(inc, 1), -1);
+    SvmModelGuard updated(svm_incremental_model(inc));
+    svm_incremental_destroy(inc);
+    ASSERT_TRUE(updated);
+    // the SVs are found by their ids, in increasing order within a class
+    for (int k = 0; k < updated->l; ++k) {
+        int id = updated->sv_indices[k];
+        ASSERT_GT(id, 0);
+        ASSERT_LT(id, (int)by_id.size());
+        EXPECT_TRUE(id > first.l || id % 2 == 0) << "removed id " << id;
+        for (int n = 0; ; ++n) {
+            EXPECT_EQ(updated->SV[k][n].index, by_id[id][n].index);
+            EXPECT_EQ(updated->SV[k][n].value, by_id[id][n].value);
+            if (by_id[id][n].index == -1)
+                break;
+        }
+        if (k > 0 && k != updated->nSV[0]) {
+            EXPECT_LT(updated->sv_indices[k - 1], id);
+        }
+    }
+
+    svm_problem remaining = {(int)y.size(), y.data(), x.data()};
+    SvmModelGuard retrained(svm_train(&remaining, &param));
+    ASSERT_TRUE(retrained);
+    EXPECT_EQ(updated->label[0], retrained->label[0]);
+    EXPECT_NEAR(updated->rho[0], retrained->rho[0], 1e-2);
+    for (int i = 0; i < all->l; ++i) {
+        double dec_a, dec_b;
+        svm_predict_values(updated.get(), all->x[i], &dec_a);
+        svm_predict_values(retrained.get(), all->x[i], &dec_b);
+        EXPECT_NEAR(dec_a, dec_b, 1e-2) << "i=" << i;
+    }
+
+    // the session only serves two-class C-SVC
+    param.svm_type = NU_SVC;
+    EXPECT_EQ(svm_incremental_create(&first, &param), nullptr);
+}
+
+TEST_F(TrainPredictTest, Incremental_RoundsKeepMatchingRetraining) {
+    auto data = createXorData(75, 0.1, 12);
+    svm_problem* xor_prob = data->build();
+    // the quadrants interleaved, as a stream would bring them
+    std::vector<double> all_y;
+    std::vector<svm_node*> all_x;
+    for (int k = 0; k < xor_prob->l; ++k) {
+        all_y.push_back(xor_prob->y[k * 7 % xor_prob->l]);
+        all_x.push_back(xor_prob->x[k * 7 % xor_prob->l]);
+    }
+    svm_problem stream = {xor_prob->l, all_y.data(), all_x.data()};
+    svm_problem* all = &stream;
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 10;
+    param.eps = 1e-5;
+    for (double cache_size : {100.0, 0.01}) {
+        // the cache persists over the rounds; a small one also evicts
+        param.cache_size = cache_size;
+        svm_problem start = {50, all->y, all->x};
+        svm_incremental* inc = svm_incremental_create(&start, &param);
+        ASSERT_NE(inc, nullptr);
+        std::vector<int> ids;  // ids[k]: id of instance k of all, 0 once removed
+        for (int i = 0; i < start.l; ++i)
+            ids.push_back(i + 1);
+        for (int round = 0; round < 5; ++round) {
+            // add 50, remove 20 of the oldest left
+            for (int i = (int)ids.size(); i < start.l + 50 * (round + 1); ++i)
+                ids.push_back(svm_incremental_add(inc, all->x[i], all->y[i]));
+            int removed = 0;
+            for (size_t k = 0; k < ids.size() && removed < 20; ++k)
+                if (ids[k] > 0 && svm_incremental_remove(inc, ids[k]) == 0) {
+                    ids[k] = 0;
+                    ++removed;
+                }
+            SvmModelGuard updated(svm_incremental_model(inc));
+            ASSERT_TRUE(updated);
+
+            std::vector<double> y;
+            std::vector<svm_node*> x;
+            for (size_t k = 0; k < ids.size(); ++k)
+                if (ids[k] > 0) {
+                    y.push_back(all->y[k]);
+                    x.push_back(all->x[k]);
+                }
+            svm_problem current = {(int)y.size(), y.data(), x.data()};
+            SvmModelGuard retrained(svm_train(&current, &param));
+            ASSERT_TRUE(retrained);
+            for (int i = 0; i < all->l; i += 3) {
+                double dec_a, dec_b;
+                svm_predict_values(updated.get(), all->x[i], &dec_a);
+                svm_predict_values(retrained.get(), all->x[i], &dec_b);
+                EXPECT_NEAR(dec_a, dec_b, 1e-2) << "cache_size=" << cache_size
+                                                << " round=" << round << " i=" << i;
+            }
+        }
+        svm_incremental_destroy(inc);
+    }
+}
+
+TEST_F(TrainPredictTest, Nystrom_ObjectiveRisesToExactWithLandmarks) {
+    for (int st : {C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        param.eps = 1e-6;
+        std::vector<svm_progress> exact;
+        {
+            ProgressRecorder recorder;
+            SvmModelGuard model(svm_train(prob, &param));
+            ASSERT_TRUE(model);
+            exact = finalReports(recorder.log);
+        }
+
+        // the fixed seed draws nested landmark sets, and the approximation
+        // of the kernel only grows with them, so neither can the minimum
+        // of each dual; with every instance a landmark it is the kernel
+        std::vector<svm_progress> last;
+        for (int m : {prob->l / 8, prob->l / 4, prob->l / 2, prob->l}) {
+            param.nr_landmark = m;
+            ASSERT_EQ(svm_check_parameter(prob, &param), nullptr);
+            ProgressRecorder recorder;
+            SvmModelGuard nystrom(svm_train(prob, &param));
+            ASSERT_TRUE(nystrom);
+            EXPECT_EQ(nystrom->param.kernel_type, RBF);
+            std::vector<svm_progress> reports = finalReports(recorder.log);
+            ASSERT_EQ(reports.size(), exact.size()) << "svm_type=" << st;
+            for (size_t p = 0; p < reports.size(); ++p) {
+                double tol = 1e-4 * std::max(1.0, std::fabs(exact[p].obj));
+                EXPECT_LE(reports[p].obj, exact[p].obj + tol) << "svm_type=" << st << " m=" << m;
+                if (!last.empty()) {
+                    EXPECT_GE(reports[p].obj, last[p].obj - tol) << "svm_type=" << st << " m=" << m;
+                }
+                if (m == prob->l) {
+                    EXPECT_NEAR(reports[p].obj, exact[p].obj, tol) << "svm_type=" << st;
+                }
+            }
+            last = reports;
+        }
+    }
+}
+
+TEST_F(TrainPredictTest, Nystrom_FewLandmarksKeepAccuracy) {
+    auto train = createXorData(200, 0.1, 7);
+    auto test = createXorData(200, 0.1, 8);
+    svm_problem* prob = train->build();
+    svm_problem* test_prob = test->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 10;
+    param.nr_landmark = 40;
+
+    for (int solver : {SMO, DCD}) {
+        for (int landmark_iter : {0, 10}) {
+            param.solver = solver;
+            param.landmark_iter = landmark_iter;
+            ASSERT_EQ(svm_check_parameter(prob, &param), nullptr);
+            SvmModelGuard model(svm_train(prob, &param));
+            ASSERT_TRUE(model);
+            EXPECT_LE(model->l, 40);
+            // sampled landmarks are training instances, k-means ones are not
+            ASSERT_NE(model->sv_indices, nullptr);
+            for (int k = 0; k < model->l; ++k) {
+                int index = model->sv_indices[k];
+                if (landmark_iter > 0) {
+                    EXPECT_EQ(index, 0);
+                    continue;
+                }
+                ASSERT_GE(index, 1);
+                ASSERT_LE(index, prob->l);
+                EXPECT_EQ(model->SV[k][0].value, prob->x[index - 1][0].value);
+            }
+
+            // the landmarks are drawn with a fixed seed
+            SvmModelGuard again(svm_train(prob, &param));
+            ASSERT_TRUE(again);
+            ASSERT_EQ(again->l, model->l);
+            for (int k = 0; k < model->l; ++k)
+                EXPECT_EQ(again->sv_coef[0][k], model->sv_coef[0][k]);
+            int correct = 0;
+            for (int i = 0; i < test_prob->l; ++i)
+                correct += svm_predict(model.get(), test_prob->x[i]) == test_prob->y[i];
+            EXPECT_GE(correct, test_prob->l * 9 / 10)
+                << "solver=" << solver << " landmark_iter=" << landmark_iter;
+
+            std::string file = getTempFilePath();
+            ASSERT_EQ(svm_save_model(file.c_str(), model.get()), 0);
+            SvmModelGuard loaded(svm_load_model(file.c_str()));
+            ASSERT_TRUE(loaded);
+            for (int i = 0; i < test_prob->l; ++i)
+                EXPECT_EQ(svm_predict(loaded.get(), test_prob->x[i]),
+                          svm_predict(model.get(), test_prob->x[i]));
+            deleteTempFile(file);
+        }
+    }
+}
+
+TEST_F(TrainPredictTest, Ensemble_SeededMembersAggregate) {
+    for (int st : {C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR}) {
+        auto builder = createDataFor(st);
+        svm_problem* prob = builder->build();
+        svm_parameter param = getDefaultParameter(st, RBF);
+        bool classification = st == C_SVC || st == NU_SVC;
+
+        // a single member is the model of the whole problem
+        svm_ensemble* one = svm_train_ensemble(prob, &param, 1, 0);
+        ASSERT_NE(one, nullptr);
+        ASSERT_EQ(one->nr_model, 1);
+        SvmModelGuard model(svm_train(prob, &param));
+        for (int i = 0; i < prob->l; ++i)
+            EXPECT_DOUBLE_EQ(svm_predict_ensemble(one, prob->x[i]),
+                             svm_predict(model.get(), prob->x[i]));
+        svm_free_and_destroy_ensemble(&one);
+        EXPECT_EQ(one, nullptr);
+
+        for (int bootstrap : {0, 1}) {
+            // the draws do not depend on rand()
+            srand(1);
+            svm_ensemble* ensemble = svm_train_ensemble(prob, &param, 3, bootstrap);
+            srand(99);
+            svm_ensemble* again = svm_train_ensemble(prob, &param, 3, bootstrap);
+            ASSERT_NE(ensemble, nullptr);
+            ASSERT_NE(again, nullptr);
+            ASSERT_EQ(ensemble->nr_model, 3);
+            int nr_class = ensemble->model[0]->nr_class;
+            std::vector<int> owner(prob->l + 1, -1);
+            for (int k = 0; k < 3; ++k) {
+                const svm_model* member = ensemble->model[k];
+                EXPECT_EQ(member->nr_class, nr_class);
+                EXPECT_LT(member->l, prob->l);
+                ASSERT_EQ(again->model[k]->l, member->l) << "svm_type=" << st << " k=" << k;
+                for (int s = 0; s < member->l; ++s) {
+                    int index = member->sv_indices[s];
+                    EXPECT_EQ(again->model[k]->sv_indices[s], index);
+                    EXPECT_EQ(again->model[k]->sv_coef[0][s], member->sv_coef[0][s]);
+                    // without bootstrap the members split prob
+                    if (!bootstrap && !classification) {
+                        EXPECT_TRUE(owner[index] == -1 || owner[index] == k) << "index " << index;
+                        owner[index] = k;
+                    }
+                }
+            }
+            svm_free_and_destroy_ensemble(&again);
+
+            // the decision values are the means of the members'
+            int nr_dec = classification ? nr_class * (nr_class - 1) / 2 : 1;
+            std::vector<double> dec(nr_dec), member_dec(nr_dec);
+            for (int i = 0; i < prob->l; ++i) {
+                double label = svm_predict_ensemble_values(ensemble, prob->x[i], dec.data());
+                std::vector<double> mean(nr_dec, 0);
+                double mean_label = 0;
+                for (int k = 0; k < 3; ++k) {
+                    mean_label += svm_predict_values(ensemble->model[k], prob->x[i], member_dec.data()) / 3;
+                    for (int p = 0; p < nr_dec; ++p)
+                        mean[p] += member_dec[p] / 3;
+                }
+                for (int p = 0; p < nr_dec; ++p)
+                    EXPECT_NEAR(dec[p], mean[p], 1e-12) << "svm_type=" << st << " i=" << i;
+                if (st == EPSILON_SVR || st == NU_SVR) {
+                    EXPECT_NEAR(label, mean_label, 1e-12);
+                } else if (st == ONE_CLASS) {
+                    EXPECT_EQ(label, dec[0] > 0 ? 1 : -1);
+                }
+            }
+
+            std::string file = getTempFilePath();
+            ASSERT_EQ(svm_save_ensemble(file.c_str(), ensemble), 0);
+            EXPECT_EQ(svm_load_model(file.c_str()), nullptr);
+            svm_ensemble* loaded = svm_load_ensemble(file.c_str());
+            ASSERT_NE(loaded, nullptr);
+            ASSERT_EQ(loaded->nr_model, 3);
+            std::vector<double> dec_b(nr_dec);
+            for (int i = 0; i < prob->l; ++i) {
+                // SVs are saved to 8 digits
+                EXPECT_NEAR(svm_predict_ensemble_values(ensemble, prob->x[i], dec.data()),
+                            svm_predict_ensemble_values(loaded, prob->x[i], dec_b.data()), 1e-6);
+                for (int k = 0; k < nr_dec; ++k)
+                    EXPECT_NEAR(dec[k], dec_b[k], 1e-6);
+            }
+            svm_free_and_destroy_ensemble(&loaded);
+            svm_free_and_destroy_ensemble(&ensemble);
+
+            // a model file is no ensemble
+            ASSERT_EQ(svm_save_model(file.c_str(), model.get()), 0);
+            EXPECT_EQ(svm_load_ensemble(file.c_str()), nullptr);
+            deleteTempFile(file);
+        }
+    }
+}
+
+TEST_F(TrainPredictTest, Ensemble_PartitionsKeepAccuracy) {
+    auto train = createXorData(200, 0.1, 7);
+    auto test = createXorData(200, 0.1, 8);
+    svm_problem* prob = train->build();
+    svm_problem* test_prob = test->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.C = 10;
+
+    svm_ensemble* ensemble = svm_train_ensemble(prob, &param, 4, 0);
+    ASSERT_NE(ensemble, nullptr);
+    int total = 0;
+    for (int k = 0; k < ensemble->nr_model; ++k) {
+        const svm_model* member = ensemble->model[k];
+        total += member->l;
+        // sv_indices refer to prob
+        for (int s = 0; s < member->l; ++s) {
+            int i = member->sv_indices[s] - 1;
+            ASSERT_GE(i, 0);
+            ASSERT_LT(i, prob->l);
+            EXPECT_EQ(member->SV[s], prob->x[i]);
+        }
+    }
+    EXPECT_GT(total, 0);
+    int correct = 0;
+    for (int i = 0; i < test_prob->l; ++i)
+        correct += svm_predict_ensemble(ensemble, test_prob->x[i]) == test_prob->y[i];
+    EXPECT_GE(correct, test_prob->l * 9 / 10);
+    svm_free_and_destroy_ensemble(&ensemble);
+}
+
+namespace {
+// the smallest kkt_slack of an instance that is no SV of model: y f(x) - 1
+// against each other class for C_SVC, p - |y - f(x)| for EPSILON_SVR
+double smallestNonSvSlack(const svm_model* model, const svm_problem* prob) {
+    int nr_class = model->nr_class;
+    std::vector<char> is_sv(prob->l, 0);
+    for (int k = 0; k < model->l; ++k) is_sv[model->sv_indices[k] - 1] = 1;
+    std::vector<double> dec(nr_class * (nr_class - 1) / 2 + 1);
+    double smallest = HUGE_VAL;
+    for (int i = 0; i < prob->l; ++i) {
+        if (is_sv[i]) continue;
+        svm_predict_values(model, prob->x[i], dec.data());
+        if (model->param.svm_type == EPSILON_SVR) {
+            smallest = std::min(smallest, model->param.p - std::fabs(prob->y[i] - dec[0]));
+            continue;
+        }
+        int p = 0;
+        for (int a = 0; a < nr_class; ++a)
+            for (int b = a + 1; b < nr_class; ++b, ++p) {
+                if (model->label[a] == prob->y[i]) smallest = std::min(smallest, dec[p] - 1);
+                if (model->label[b] == prob->y[i]) smallest = std::min(smallest, -dec[p] - 1);
+            }
+    }
+    return smallest;
+}
+} // namespace
+
+TEST_F(TrainPredictTest, Screening_GrowsToOptimalityOnAllData) {
+    // over 2000 instances, so that the sample model sees every other one
+    std::pair<std::unique_ptr<SvmProblemBuilder>, int> cases[] = {
+        {createXorData(1100, 0.3, 7), C_SVC},
+        {createMultiClassData(3, 800, 4, 7), C_SVC},
+        {createRegressionData(2200, 0.1, 7), EPSILON_SVR}};
+    for (auto& c : cases) {
+        svm_problem* prob = c.first->build();
+        int st = c.second;
+        svm_parameter param = getDefaultParameter(st, RBF);
+        int nr_class = (int)std::set<double>(prob->y, prob->y + prob->l).size();
+        int nr_pair = st == C_SVC ? nr_class * (nr_class - 1) / 2 : 1;
+        int variables = st == EPSILON_SVR ? 2 * prob->l : prob->l;
+
+        for (int screening : {1, 2}) {
+            SCOPED_TRACE(testing::Message() << "svm_type=" << st << " screening=" << screening);
+            param.screening = screening;
+            ASSERT_EQ(svm_check_parameter(prob, &param), nullptr);
+            ProgressRecorder progress;
+            SvmModelGuard screened(svm_train(prob, &param));
+            ASSERT_TRUE(screened);
+            EXPECT_EQ(screened->param.screening, screening);
+            for (int k = 0; k < screened->l; ++k) {
+                int i = screened->sv_indices[k];
+                ASSERT_GE(i, 1);
+                ASSERT_LE(i, prob->l);
+                EXPECT_EQ(screened->SV[k], prob->x[i - 1]);
+            }
+            // what was left out satisfies the optimality conditions too
+            EXPECT_GE(smallestNonSvSlack(screened.get(), prob), -2 * param.eps);
+
+            // the sample, then a set that grows, within the round cap
+            std::vector<svm_progress> last = finalReports(progress.log);
+            int nr_round = (int)last.size() / nr_pair;
+            ASSERT_EQ((int)last.size(), nr_round * nr_pair);
+            EXPECT_GE(nr_round, 2);
+            EXPECT_LE(nr_round, 2 + 10);
+            for (size_t k = 2 * nr_pair; k < last.size(); ++k)
+                EXPECT_GE(last[k].l, last[k - nr_pair].l) << "optimization " << k;
+            int largest = 0;
+            for (const svm_progress& r : last) largest = std::max(largest, r.l);
+            EXPECT_LE(largest, variables);
+            if (screening == 1) {
+                EXPECT_LT(largest, variables);
+            }
+        }
+    }
+}
+
+TEST_F(TrainPredictTest, Screening_RoundsShareOneBudget) {
+    // the noisy XOR where a model stopped early keeps adding violators
+    auto builder = createXorData(1500, 0.3, 7);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+
+    for (int screening : {1, 2}) {
+        SCOPED_TRACE(screening);
+        param.screening = screening;
+        // one optimization's worth of iterations, and at least one for the
+        // first training on the set screening keeps
+        param.max_iter = 50;
+        ProgressRecorder limited;
+        SvmModelGuard model(svm_train(prob, &param));
+        ASSERT_TRUE(model);
+        EXPECT_LE(totalIterations(limited.log), param.max_iter + 1);
+        param.max_iter = 0;
+
+        // out of time after the first optimization: no rounds follow
+        param.max_time = 1e-9;
+        ProgressRecorder timed;
+        SvmModelGuard timed_model(svm_train(prob, &param));
+        ASSERT_TRUE(timed_model);
+        EXPECT_LE(finalReports(timed.log).size(), 2u);
+        param.max_time = 0;
+
+        // a cancel ends the rounds with the optimization it came from
+        ProgressRecorder cancelled;
+        cancelled.log.cancel_after = 3;
+        SvmModelGuard none(svm_train(prob, &param));
+        EXPECT_FALSE(none);
+        EXPECT_EQ(cancelled.log.reports.size(), 3u);
+    }
+}
+
+TEST_F(TrainPredictTest, Screening_RejectedWhereItCannotRun) {
+    auto builder = createXorData(100, 0.3, 7);
+    svm_problem* prob = builder->build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    SvmModelGuard init(svm_train(prob, &param));
+    ASSERT_TRUE(init);
+
+    param.screening = 1;
+    ASSERT_EQ(svm_check_parameter(prob, &param), nullptr);
+    // without an init model a warm start is plain training
+    SvmModelGuard cold(svm_train_warm(prob, &param, nullptr));
+    EXPECT_TRUE(cold);
+    EXPECT_EQ(svm_train_warm(prob, &param, init.get()), nullptr);
+
+    double values[] = {0.5, 1, 2};
+    svm_model* models[3] = {init.get(), init.get(), init.get()};
+    svm_train_path(prob, &param, 3, values, models);
+    for (svm_model* model : models)
+        EXPECT_EQ(model, nullptr);
+
+    std::string file = getTempFilePath();
+    EXPECT_EQ(svm_train_checkpoint(prob, &param, file.c_str(), 0), nullptr);
+    // and nothing was saved
+    EXPECT_EQ(fopen(file.c_str(), "rb"), nullptr);
+    deleteTempFile(file);
+}
@@ -8,6 +8,8 @@
 #include "test_utils.h"
 #include <cmath>
 #include <vector>
+#include <map>
+#include <random>
 
 using namespace libsvm_test;
 
@@ -392,3 +394,231 @@ TEST_F(KernelTest, VeryLargeGamma) {
     SvmModelGuard model(svm_train(prob, &param));
     ASSERT_TRUE(model);
 }
+
+// ===========================================================================
+// Binary Feature Tests
+// ===========================================================================
+
+namespace {
+
+// Bag-of-words style rows: every stored value is `value`
+std::unique_ptr<SvmProblemBuilder> createBinaryData(int n_samples, int n_features,
+                                                    double value, unsigned int seed) {
+    auto builder = std::make_unique<SvmProblemBuilder>();
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    for (int i = 0; i < n_samples; ++i) {
+        double label = (i % 2 == 0) ? 1.0 : -1.0;
+        std::vector<std::pair<int, double>> features;
+        for (int k = 1; k <= n_features; ++k) {
+            // the first half of the features lean towards the positive class;
+            // about 8 nonzeros per row regardless of the feature range
+            double p_high = std::min(0.4, 12.0 / n_features);
+            double p = (k <= n_features / 2) == (label > 0) ? p_high : p_high / 4;
+            if (coin(gen) < p) features.emplace_back(k, value);
+        }
+        builder->addSample(label, features);
+    }
+    return builder;
+}
+
+double manualKernel(const svm_node* x, const svm_node* y, const svm_parameter& param) {
+    std::map<int, double> xv, yv;
+    for (; x->index != -1; ++x) xv[x->index] = x->value;
+    for (; y->index != -1; ++y) yv[y->index] = y->value;
+    double dot = 0, dist = 0;
+    for (const auto& [k, v] : xv) {
+        auto it = yv.find(k);
+        double w = (it == yv.end()) ? 0 : it->second;
+        dot += v * w;
+        dist += (v - w) * (v - w);
+    }
+    for (const auto& [k, w] : yv)
+        if (xv.find(k) == xv.end()) dist += w * w;
+    switch (param.kernel_type) {
+        case LINEAR: return dot;
+        case POLY: return std::pow(param.gamma * dot + param.coef0, param.degree);
+        case RBF: return std::exp(-param.gamma * dist);
+        default: return std::tanh(param.gamma * dot + param.coef0);
+    }
+}
+
+// Trains on `prob` and on the same problem as a precomputed kernel built
+// with manualKernel, and expects the two solutions to agree
+void expectMatchesPrecomputed(const svm_problem* prob, const svm_parameter& param) {
+    SvmModelGuard model(svm_train(prob, &param));
+    ASSERT_TRUE(model);
+
+    SvmProblemBuilder precomputed;
+    for (int i = 0; i < prob->l; ++i) {
+        std::vector<std::pair<int, double>> row = {{0, i + 1.0}};
+        for (int j = 0; j < prob->l; ++j)
+            row.emplace_back(j + 1, manualKernel(prob->x[i], prob->x[j], param));
+        precomputed.addSample(prob->y[i], row);
+    }
+    svm_parameter param_pre = param;
+    param_pre.kernel_type = PRECOMPUTED;
+    SvmModelGuard model_pre(svm_train(precomputed.build(), &param_pre));
+    ASSERT_TRUE(model_pre);
+
+    EXPECT_EQ(svm_get_nr_sv(model.get()), svm_get_nr_sv(model_pre.get()));
+    EXPECT_NEAR(model->rho[0], model_pre->rho[0], 1e-6) << "kernel_type=" << param.kernel_type;
+}
+
+} // namespace
+
+TEST_F(KernelTest, BinaryFeatures_MatchScaledGenericPath) {
+    // Values of 2 with gamma/4 give the same RBF kernel as values of 1 with
+    // gamma, but only the latter takes the binary-feature path
+    for (int n_features : {40, 2000}) {  // bitmap rows and index-list rows
+        auto binary = createBinaryData(60, n_features, 1.0, 7);
+        auto scaled = createBinaryData(60, n_features, 2.0, 7);
+
+        svm_parameter param = getDefaultParameter(C_SVC, RBF);
+        param.gamma = 0.2;
+        svm_parameter param_scaled = param;
+        param_scaled.gamma = 0.05;
+
+        SvmModelGuard model(svm_train(binary->build(), &param));
+        SvmModelGuard model_scaled(svm_train(scaled->build(), &param_scaled));
+        ASSERT_TRUE(model);
+        ASSERT_TRUE(model_scaled);
+        EXPECT_EQ(svm_get_nr_sv(model.get()), svm_get_nr_sv(model_scaled.get()));
+        EXPECT_NEAR(model->rho[0], model_scaled->rho[0], 1e-6);
+    }
+}
+
+TEST_F(KernelTest, BinaryFeatures_PredictValuesMatchManualKernel) {
+    auto builder = createBinaryData(50, 64, 1.0, 11);
+    svm_problem* prob = builder->build();
+
+    for (int kernel_type : {LINEAR, POLY, RBF, SIGMOID}) {
+        svm_parameter param = getDefaultParameter(C_SVC, kernel_type);
+        param.gamma = 0.05;
+        param.coef0 = 0.5;
+        SvmModelGuard model(svm_train(prob, &param));
+        ASSERT_TRUE(model);
+
+        for (int i = 0; i < prob->l; ++i) {
+            double expected = -model->rho[0];
+            for (int s = 0; s < model->l; ++s)
+                expected += model->sv_coef[0][s] * manualKernel(prob->x[i], model->SV[s], param);
+            double dec = 0;
+            svm_predict_values(model.get(), prob->x[i], &dec);
+            EXPECT_NEAR(dec, expected, 1e-9) << "kernel_type=" << kernel_type;
+        }
+    }
+}
+
+// ===========================================================================
+// Skewed Sparse Row Tests
+// ===========================================================================
+
+TEST_F(KernelTest, SkewedSparseRows_MatchPrecomputedKernel) {
+    // Heavy-tailed row lengths exercise the galloping (short vs long) and
+    // block (long vs long) intersections; a precomputed kernel built by a
+    // straightforward map lookup gives the reference solution
+    auto builder = std::make_unique<SvmProblemBuilder>();
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> index(1, 1000);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    for (int i = 0; i < 40; ++i) {
+        int nnz = (i % 4 == 0) ? 400 : 3 + i % 5;
+        std::map<int, double> row;
+        while (static_cast<int>(row.size()) < nnz) row[index(gen)] = value(gen);
+        double label = (i % 2 == 0) ? 1.0 : -1.0;
+        row[1] = label;  // keep the classes apart
+        builder->addSample(label, std::vector<std::pair<int, double>>(row.begin(), row.end()));
+    }
+    svm_problem* prob = builder->build();
+
+    for (int kernel_type : {LINEAR, RBF}) {
+        svm_parameter param = getDefaultParameter(C_SVC, kernel_type);
+        param.gamma = 0.01;
+        expectMatchesPrecomputed(prob, param);
+    }
+}
+
+TEST_F(KernelTest, RbfPredict_NearbyPointsKeepPrecision) {
+    // Large norms and a tiny distance: |x|^2+|sv|^2-2*dot(x,sv) would lose
+    // the distance to cancellation, the squared differences keep it
+    SvmProblemBuilder builder;
+    for (int i = 0; i < 2; ++i) {
+        std::vector<std::pair<int, double>> row;
+        for (int k = 1; k <= 30; ++k) row.emplace_back(k, 1000.0 + k + 50.0 * i);
+        builder.addSample(i == 0 ? 1.0 : -1.0, row);
+    }
+    svm_problem* prob = builder.build();
+    svm_parameter param = getDefaultParameter(C_SVC, RBF);
+    param.gamma = 1e4;
+    SvmModelGuard model(svm_train(prob, &param));
+    ASSERT_TRUE(model);
+
+    std::vector<svm_node> x(prob->x[0], prob->x[0] + 31);
+    x[7].value += 1e-4;
+    double expected = -model->rho[0];
+    for (int s = 0; s < model->l; ++s)
+        expected += model->sv_coef[0][s] * manualKernel(x.data(), model->SV[s], param);
+    double dec = 0;
+    svm_predict_values(model.get(), x.data(), &dec);
+    EXPECT_NEAR(dec, expected, 1e-9);
+}
+
+// ===========================================================================
+// Dense Head / Sparse Tail Tests
+// ===========================================================================
+
+TEST_F(KernelTest, HybridRows_MatchPrecomputedKernel) {
+    // 24 dense numeric features followed by a few hashed categorical indices
+    auto builder = std::make_unique<SvmProblemBuilder>();
+    std::mt19937 gen(9);
+    std::normal_distribution<double> value(0.0, 1.0);
+    std::uniform_int_distribution<int> hashed(100000, 2000000);
+    for (int i = 0; i < 50; ++i) {
+        double label = (i % 2 == 0) ? 1.0 : -1.0;
+        std::map<int, double> row;
+        for (int k = 1; k <= 24; ++k) row[k] = value(gen) + (k <= 4 ? label : 0.0);
+        for (int t = 0; t < 1 + i % 6; ++t) row[hashed(gen)] = 1.0;
+        builder->addSample(label, std::vector<std::pair<int, double>>(row.begin(), row.end()));
+    }
+    svm_problem* prob = builder->build();
+
+    for (int kernel_type : {LINEAR, POLY, RBF}) {
+        svm_parameter param = getDefaultParameter(C_SVC, kernel_type);
+        param.gamma = 0.02;
+        param.coef0 = 1.0;
+        expectMatchesPrecomputed(prob, param);
+
+        SvmModelGuard model(svm_train(prob, &param));
+        ASSERT_TRUE(model);
+        for (int i = 0; i < prob->l; ++i) {
+            double expected = -model->rho[0];
+            for (int s = 0; s < model->l; ++s)
+                expected += model->sv_coef[0][s] * manualKernel(prob->x[i], model->SV[s], param);
+            double dec = 0;
+            svm_predict_values(model.get(), prob->x[i], &dec);
+            EXPECT_NEAR(dec, expected, 1e-9) << "kernel_type=" << kernel_type;
+        }
+    }
+}
+
+TEST_F(KernelTest, NegativeIndices_MatchPrecomputedKernel) {
+    // A negative index ahead of dense features must take part in the dot
+    // products like any other index, whichever row format is picked
+    auto builder = std::make_unique<SvmProblemBuilder>();
+    std::mt19937 gen(13);
+    std::normal_distribution<double> value(0.0, 1.0);
+    for (int i = 0; i < 40; ++i) {
+        double label = (i % 2 == 0) ? 1.0 : -1.0;
+        std::vector<std::pair<int, double>> row = {{-3, label + value(gen)}};
+        for (int k = 1; k <= 16; ++k) row.emplace_back(k, value(gen));
+        builder->addSample(label, row);
+    }
+    svm_problem* prob = builder->build();
+
+    for (int kernel_type : {LINEAR, RBF}) {
+        svm_parameter param = getDefaultParameter(C_SVC, kernel_type);
+        param.gamma = 0.05;
+        expectMatchesPrecomputed(prob, param);
+    }
+}
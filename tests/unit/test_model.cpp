@@ -222,6 +222,29 @@ TEST_F(SvmModelTest, SVRProbabilityModel) {
     EXPECT_GT(svr_prob, 0);
 }
 
+TEST_F(SvmModelTest, SVRModelIndependentOfCacheSize) {
+    // A cache holding only two columns forces every column through
+    // eviction, refill and the shrinking swaps
+    auto builder = createRegressionData(80, 0.1);
+    svm_problem* prob = builder->build();
+
+    for (int st : {EPSILON_SVR, NU_SVR}) {
+        svm_parameter param = getDefaultParameter(st);
+        param.shrinking = 1;
+        svm_parameter param_small = param;
+        param_small.cache_size = 0.001;
+
+        SvmModelGuard model(svm_train(prob, &param));
+        SvmModelGuard model_small(svm_train(prob, &param_small));
+        ASSERT_TRUE(model);
+        ASSERT_TRUE(model_small);
+        ASSERT_EQ(model->l, model_small->l);
+        EXPECT_EQ(model->rho[0], model_small->rho[0]);
+        for (int i = 0; i < model->l; ++i)
+            EXPECT_EQ(model->sv_coef[0][i], model_small->sv_coef[0][i]);
+    }
+}
+
 // ===========================================================================
 // Model Memory Management Tests
 // ===========================================================================
@@ -36,6 +36,8 @@ TEST_F(SvmParameterTest, DefaultParameters) {
     EXPECT_DOUBLE_EQ(param.p, 0.1);
     EXPECT_EQ(param.shrinking, 1);
     EXPECT_EQ(param.probability, 0);
+    EXPECT_EQ(param.max_iter, 0);
+    EXPECT_DOUBLE_EQ(param.max_time, 0.0);
     EXPECT_EQ(param.nr_weight, 0);
     EXPECT_EQ(param.weight_label, nullptr);
     EXPECT_EQ(param.weight, nullptr);
@@ -302,4 +304,150 @@ TEST_F(SvmParameterTest, ShrinkingHeuristics) {
     param.shrinking = 0;
     error = svm_check_parameter(prob, &param);
     EXPECT_EQ(error, nullptr);
+
+    // Test with shrinking decided during training
+    param.shrinking = 2;
+    error = svm_check_parameter(prob, &param);
+    EXPECT_EQ(error, nullptr);
+
+    param.shrinking = 3;
+    error = svm_check_parameter(prob, &param);
+    EXPECT_NE(error, nullptr);
+}
+
+// Test solver selection
+TEST_F(SvmParameterTest, Solver) {
+    svm_parameter param = getDefaultParameter(C_SVC, LINEAR);
+    auto builder = createLinearlySeperableData(10);
+    svm_problem* prob = builder->build();
+    EXPECT_EQ(param.solver, SMO);
+
+    param.solver = DCD;
+    EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+    param.svm_type = EPSILON_SVR;
+    EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+
+    // only the linear kernel with C_SVC or EPSILON_SVR
+    param.svm_type = NU_SVC;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+    param.svm_type = C_SVC;
+    param.kernel_type = RBF;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+
+    param.kernel_type = LINEAR;
+    param.solver = 2;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+}
+
+// Test working set sizes
+TEST_F(SvmParameterTest, WorkingSetSize) {
+    svm_parameter param = getDefaultParameter();
+    auto builder = createLinearlySeperableData(10);
+    svm_problem* prob = builder->build();
+    EXPECT_EQ(param.working_set_size, 0);
+
+    for (int q : {0, 2, 3, 64, 1024}) {
+        param.working_set_size = q;
+        EXPECT_EQ(svm_check_parameter(prob, &param), nullptr) << q;
+    }
+    for (int q : {-1, 1, 1025}) {
+        param.working_set_size = q;
+        EXPECT_NE(svm_check_parameter(prob, &param), nullptr) << q;
+    }
+}
+
+// Test cache-aware selection
+TEST_F(SvmParameterTest, CacheSlack) {
+    svm_parameter param = getDefaultParameter();
+    auto builder = createLinearlySeperableData(10);
+    svm_problem* prob = builder->build();
+    EXPECT_EQ(param.cache_slack, 0);
+
+    for (double slack : {0.0, 0.2, 0.99}) {
+        param.cache_slack = slack;
+        EXPECT_EQ(svm_check_parameter(prob, &param), nullptr) << slack;
+    }
+    for (double slack : {-0.1, 1.0}) {
+        param.cache_slack = slack;
+        EXPECT_NE(svm_check_parameter(prob, &param), nullptr) << slack;
+    }
+}
+
+// Test training budgets
+TEST_F(SvmParameterTest, TrainingBudgets) {
+    svm_parameter param = getDefaultParameter();
+    auto builder = createLinearlySeperableData(10);
+    svm_problem* prob = builder->build();
+
+    param.max_iter = 100;
+    param.max_time = 2.5;
+    EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+
+    param.max_iter = -1;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+
+    param.max_iter = 0;
+    param.max_time = -1;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+}
+
+// Test out-of-core mode
+TEST_F(SvmParameterTest, OutOfCore) {
+    svm_parameter param = getDefaultParameter();
+    auto builder = createLinearlySeperableData(10);
+    svm_problem* prob = builder->build();
+    EXPECT_EQ(param.out_of_core, 0);
+
+    param.out_of_core = 1;
+    EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+    param.out_of_core = 2;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+}
+
+TEST_F(SvmParameterTest, Nystrom) {
+    svm_parameter param = getDefaultParameter();
+    auto builder = createLinearlySeperableData(10);
+    svm_problem* prob = builder->build();
+    EXPECT_EQ(param.nr_landmark, 0);
+    EXPECT_EQ(param.landmark_iter, 0);
+
+    param.kernel_type = RBF;
+    param.nr_landmark = 5;
+    param.landmark_iter = 3;
+    EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+    param.solver = DCD;
+    EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+    param.solver = SMO;
+    param.landmark_iter = -1;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+    param.landmark_iter = 0;
+    param.nr_landmark = -1;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+    param.nr_landmark = 5;
+    param.kernel_type = LINEAR;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+    param.kernel_type = PRECOMPUTED;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+}
+
+TEST_F(SvmParameterTest, Screening) {
+    svm_parameter param = getDefaultParameter();
+    auto builder = createLinearlySeperableData(10);
+    svm_problem* prob = builder->build();
+    EXPECT_EQ(param.screening, 0);
+
+    for (int screening : {1, 2}) {
+        param.screening = screening;
+        param.svm_type = C_SVC;
+        EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+        param.svm_type = EPSILON_SVR;
+        EXPECT_EQ(svm_check_parameter(prob, &param), nullptr);
+        param.svm_type = NU_SVC;
+        EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+    }
+    param.svm_type = C_SVC;
+    param.screening = 3;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
+    param.screening = -1;
+    EXPECT_NE(svm_check_parameter(prob, &param), nullptr);
 }